@@ -3,6 +3,8 @@
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
 layout (location = 2) in vec3 fragNormalWorld;
+layout (location = 3) flat in uvec4 fragLights;
+layout (location = 4) flat in uint fragLightCount;
 
 layout (location = 0) out vec4 outColor;
 
@@ -10,6 +12,8 @@ struct PointLight
 {
     vec4 Position; // ignore w
     vec4 Color; // w is intensity
+    float Radius;
+    float Range;
 };
 
 layout (set = 0, binding = 0) uniform GlobalUBO
@@ -18,15 +22,61 @@ layout (set = 0, binding = 0) uniform GlobalUBO
     mat4 View;
     mat4 InverseView;
     vec4 AmbientLightColor; // w is indtensity
-    PointLight PointLights[10];
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
     int numLights;
 } ubo;
 
-layout (push_constant) uniform Push
+layout (set = 0, binding = 1) readonly buffer Lights
 {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
+    PointLight lights[];
+};
+
+// lights reaching each cluster, ClusterGrid.w indices per cluster of which the count is used
+layout (set = 0, binding = 2) readonly buffer ClusterCounts
+{
+    uint clusterCounts[];
+};
+
+layout (set = 0, binding = 3) readonly buffer ClusterIndices
+{
+    uint clusterIndices[];
+};
+
+uint GetCluster(vec3 positionWorld)
+{
+    vec4 positionView = ubo.View * vec4(positionWorld, 1.0);
+    vec4 positionClip = ubo.Projection * positionView;
+    vec2 tile = floor((positionClip.xy / positionClip.w * 0.5 + 0.5) * vec2(ubo.ClusterGrid.xy));
+    uvec2 xy = uvec2(clamp(tile, vec2(0.0), vec2(ubo.ClusterGrid.xy - 1u)));
+    float slice = floor(log(max(positionView.z, ubo.ClusterDepth.x)) * ubo.ClusterDepth.z + ubo.ClusterDepth.w);
+    uint z = uint(clamp(slice, 0.0, float(ubo.ClusterGrid.z - 1u)));
+    return xy.x + ubo.ClusterGrid.x * (xy.y + ubo.ClusterGrid.y * z);
+}
+
+void AddLight(PointLight light, vec3 surfaceNormal, vec3 viewDirection, inout vec3 diffuseLight, inout vec3 specularLight)
+{
+    vec3 directionToLight = light.Position.xyz - fragPosWorld;
+    float distanceSquared = dot(directionToLight, directionToLight);
+    // inverse square falloff windowed to reach zero at the range the light was binned with
+    float window = clamp(1.0 - pow(distanceSquared / (light.Range * light.Range), 2.0), 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+
+    directionToLight = normalize(directionToLight);
+
+    float cosAngleIncidence = max(dot(surfaceNormal, directionToLight), 0);
+    vec3 intensity = light.Color.xyz * light.Color.w * attenuation;
+
+    diffuseLight += intensity * cosAngleIncidence;
+
+    // specular lighting
+    vec3 halfAngle = normalize(directionToLight + viewDirection);
+    float blinnTerm = dot(surfaceNormal, halfAngle);
+    blinnTerm = clamp(blinnTerm, 0.1, 1.0);
+    blinnTerm = pow(blinnTerm, 512.0);
+
+    specularLight += intensity * blinnTerm;
+}
 
 void main()
 {
@@ -37,26 +87,22 @@ void main()
     vec3 cameraPosWorld = ubo.InverseView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-    for( int i = 0; i < ubo.numLights; ++i)
+    if (fragLightCount != 0xFFFFFFFFu)
     {
-        PointLight light = ubo.PointLights[i];
-        vec3 directionToLight = light.Position.xyz - fragPosWorld;
-        float attenuation = 1.0f / dot(directionToLight, directionToLight);
-
-        directionToLight = normalize(directionToLight);
-
-        float cosAngleIncidence = max(dot(surfaceNormal, directionToLight), 0);
-        vec3 intensity = light.Color.xyz * light.Color.w * attenuation;
-
-        diffuseLight += intensity * cosAngleIncidence;
-
-        // specular lighting
-        vec3 halfAngle = normalize(directionToLight + viewDirection);
-        float blinnTerm = dot(surfaceNormal, halfAngle);
-        blinnTerm = clamp(blinnTerm, 0.1, 1.0);
-        blinnTerm = pow(blinnTerm, 512.0);
-
-        specularLight += intensity * blinnTerm;
+        // the object's own list, the same for all of its fragments so neighbouring invocations loop alike
+        for (uint i = 0; i < fragLightCount; ++i)
+        {
+            uint packed = fragLights[i >> 1];
+            uint index = (i & 1u) == 0u ? packed & 0xFFFFu : packed >> 16;
+            AddLight(lights[index], surfaceNormal, viewDirection, diffuseLight, specularLight);
+        }
+    }
+    else
+    {
+        uint cluster = GetCluster(fragPosWorld);
+        uint lightCount = clusterCounts[cluster];
+        for (uint i = 0; i < lightCount; ++i)
+            AddLight(lights[clusterIndices[cluster * ubo.ClusterGrid.w + i]], surfaceNormal, viewDirection, diffuseLight, specularLight);
     }
 
     outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
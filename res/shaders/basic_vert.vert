@@ -5,15 +5,18 @@ layout (location = 1) in vec3 color;
 layout (location = 2) in vec3 normal;
 layout (location = 3) in vec2 uv;
 
+// per instance, filled by RenderSystem
+layout (location = 4) in mat4 instanceModelMatrix;
+layout (location = 8) in mat3 instanceNormalMatrix;
+layout (location = 11) in vec4 instanceColor;
+layout (location = 12) in uvec4 instanceLights; // two 16 bit light indices per component
+layout (location = 13) in uint instanceLightCount; // 0xFFFFFFFF leaves the object to the clusters
+
 layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec3 fragPosWorld;
 layout (location = 2) out vec3 fragNormalWorld;
-
-struct PointLight
-{
-    vec4 Position; // ignore w
-    vec4 Color; // w is intensity
-};
+layout (location = 3) flat out uvec4 fragLights;
+layout (location = 4) flat out uint fragLightCount;
 
 layout (set = 0, binding = 0) uniform GlobalUBO
 {
@@ -21,23 +24,20 @@ layout (set = 0, binding = 0) uniform GlobalUBO
     mat4 View;
     mat4 InverseView;
     vec4 AmbientLightColor; // w is indtensity
-    PointLight PointLights[10];
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
     int numLights;
 } ubo;
 
-layout (push_constant) uniform Push
-{
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
-
 void main()
 {
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = instanceModelMatrix * vec4(position, 1.0);
 
     gl_Position = ubo.Projection * ubo.View * positionWorld;
 
-    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    fragNormalWorld = normalize(instanceNormalMatrix * normal);
     fragPosWorld = positionWorld.xyz;
-    fragColor = color;
+    fragColor = color * instanceColor.rgb;
+    fragLights = instanceLights;
+    fragLightCount = instanceLightCount;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 450
+
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0) uniform GlobalUBO
+{
+    mat4 Projection;
+    mat4 View;
+    mat4 InverseView;
+    vec4 AmbientLightColor; // w is indtensity
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
+    int numLights;
+} ubo;
+
+layout (input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput inAlbedo;
+
+void main()
+{
+    vec3 albedo = subpassLoad(inAlbedo).rgb;
+    outColor = vec4(ubo.AmbientLightColor.xyz * ubo.AmbientLightColor.w * albedo, 1.0);
+}
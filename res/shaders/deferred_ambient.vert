@@ -0,0 +1,8 @@
+#version 450
+
+void main()
+{
+    // one triangle covering the screen, on the far plane so the depth test keeps the background
+    vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 1.0, 1.0);
+}
@@ -0,0 +1,69 @@
+#version 450
+
+layout (location = 0) in vec4 fragPositionClip;
+layout (location = 1) flat in uint fragLight;
+
+layout (location = 0) out vec4 outColor;
+
+struct PointLight
+{
+    vec4 Position; // ignore w
+    vec4 Color; // w is intensity
+    float Radius;
+    float Range;
+};
+
+layout (set = 0, binding = 0) uniform GlobalUBO
+{
+    mat4 Projection;
+    mat4 View;
+    mat4 InverseView;
+    vec4 AmbientLightColor; // w is indtensity
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
+    int numLights;
+} ubo;
+
+layout (set = 0, binding = 1) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+// written by the G-buffer subpass at this pixel
+layout (input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput inAlbedo;
+layout (input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput inNormal;
+layout (input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput inDepth;
+
+void main()
+{
+    // view space position of the surface from its depth, the projection has no off-center terms
+    float depth = subpassLoad(inDepth).r;
+    vec2 ndc = fragPositionClip.xy / fragPositionClip.w;
+    float viewZ = ubo.Projection[3][2] / (depth - ubo.Projection[2][2]);
+    vec3 positionView = vec3(ndc.x * viewZ / ubo.Projection[0][0], ndc.y * viewZ / ubo.Projection[1][1], viewZ);
+    vec3 positionWorld = (ubo.InverseView * vec4(positionView, 1.0)).xyz;
+
+    vec3 albedo = subpassLoad(inAlbedo).rgb;
+    vec3 surfaceNormal = normalize(subpassLoad(inNormal).xyz);
+    vec3 cameraPosWorld = ubo.InverseView[3].xyz;
+    vec3 viewDirection = normalize(cameraPosWorld - positionWorld);
+
+    // same model as basic_frag, the window also drops the pixels the volume covers beyond the range
+    PointLight light = lights[fragLight];
+    vec3 directionToLight = light.Position.xyz - positionWorld;
+    float distanceSquared = dot(directionToLight, directionToLight);
+    float window = clamp(1.0 - pow(distanceSquared / (light.Range * light.Range), 2.0), 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+
+    directionToLight = normalize(directionToLight);
+
+    float cosAngleIncidence = max(dot(surfaceNormal, directionToLight), 0);
+    vec3 intensity = light.Color.xyz * light.Color.w * attenuation;
+
+    vec3 halfAngle = normalize(directionToLight + viewDirection);
+    float blinnTerm = dot(surfaceNormal, halfAngle);
+    blinnTerm = clamp(blinnTerm, 0.1, 1.0);
+    blinnTerm = pow(blinnTerm, 512.0);
+
+    outColor = vec4((intensity * cosAngleIncidence + intensity * blinnTerm) * albedo, 0.0);
+}
@@ -0,0 +1,50 @@
+#version 450
+
+// corners of the unit cube, bit 0 is x, bit 1 is y and bit 2 is z, the outside of every face is its front
+const uint INDICES[36] = uint[](
+    0, 2, 6, 0, 6, 4,
+    1, 7, 3, 1, 5, 7,
+    0, 5, 1, 0, 4, 5,
+    2, 3, 7, 2, 7, 6,
+    0, 1, 3, 0, 3, 2,
+    4, 7, 5, 4, 6, 7
+);
+
+layout (location = 0) out vec4 fragPositionClip;
+layout (location = 1) flat out uint fragLight;
+
+struct PointLight
+{
+    vec4 Position; // ignore w
+    vec4 Color; // w is intensity
+    float Radius;
+    float Range;
+};
+
+layout (set = 0, binding = 0) uniform GlobalUBO
+{
+    mat4 Projection;
+    mat4 View;
+    mat4 InverseView;
+    vec4 AmbientLightColor; // w is indtensity
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
+    int numLights;
+} ubo;
+
+// uploaded by LightClusterSystem every frame, one instance per light
+layout (set = 0, binding = 1) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+void main()
+{
+    PointLight light = lights[gl_InstanceIndex];
+    uint corner = INDICES[gl_VertexIndex];
+    vec3 offset = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+
+    gl_Position = ubo.Projection * ubo.View * vec4(light.Position.xyz + offset * light.Range, 1.0);
+    fragPositionClip = gl_Position;
+    fragLight = uint(gl_InstanceIndex);
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragPosWorld;
+layout (location = 2) in vec3 fragNormalWorld;
+
+// read back as input attachments by the lighting subpass, the position comes from the depth
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+
+void main()
+{
+    outAlbedo = vec4(fragColor, 1.0);
+    outNormal = vec4(normalize(fragNormalWorld), 0.0);
+}
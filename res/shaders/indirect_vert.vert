@@ -0,0 +1,56 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in vec3 normal;
+layout (location = 3) in vec2 uv;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragPosWorld;
+layout (location = 2) out vec3 fragNormalWorld;
+layout (location = 3) flat out uvec4 fragLights;
+layout (location = 4) flat out uint fragLightCount;
+
+layout (set = 0, binding = 0) uniform GlobalUBO
+{
+    mat4 Projection;
+    mat4 View;
+    mat4 InverseView;
+    vec4 AmbientLightColor; // w is indtensity
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
+    int numLights;
+} ubo;
+
+struct ObjectData
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 boundingSphere;
+    vec4 color;
+    uint batch;
+    uint slot;
+    uint pad0;
+    uint pad1;
+};
+
+// uploaded by IndirectRenderSystem, the culling pass puts the object index in firstInstance
+layout (set = 1, binding = 0) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+void main()
+{
+    ObjectData object = objects[gl_InstanceIndex];
+    vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+
+    gl_Position = ubo.Projection * ubo.View * positionWorld;
+
+    fragNormalWorld = normalize(mat3(object.normalMatrix) * normal);
+    fragPosWorld = positionWorld.xyz;
+    fragColor = color * object.color.rgb;
+    // objects culled on the GPU carry no light list
+    fragLights = uvec4(0);
+    fragLightCount = 0xFFFFFFFFu;
+}
\ No newline at end of file
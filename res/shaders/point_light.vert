@@ -10,11 +10,14 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) flat out vec4 fragColor;
 
 struct PointLight
 {
     vec4 Position; // ignore w
     vec4 Color; // w is intensity
+    float Radius;
+    float Range;
 };
 
 layout (set = 0, binding = 0) uniform GlobalUBO
@@ -23,23 +26,31 @@ layout (set = 0, binding = 0) uniform GlobalUBO
     mat4 View;
     mat4 InverseView;
     vec4 AmbientLightColor; // w is indtensity
-    PointLight PointLights[10];
+    uvec4 ClusterGrid; // clusters along x, y and depth, w is the light capacity of a cluster
+    vec4 ClusterDepth; // near, far, slice scale and bias, slice = log(depth) * scale + bias
     int numLights;
 } ubo;
 
-layout (push_constant) uniform Push
+// uploaded by LightClusterSystem every frame, one instance per light
+layout (set = 0, binding = 1) readonly buffer Lights
 {
-    vec4 Position;
-    vec4 Color;
-    float radius;
-} push;
+    PointLight lights[];
+};
+
+// light indices back to front, instances are blended in this order
+layout (set = 1, binding = 0) readonly buffer DrawOrder
+{
+    uint order[];
+};
 
 void main()
 {
+    PointLight light = lights[order[gl_InstanceIndex]];
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = light.Color;
 
-    vec4 lightCenterInCameraSpace = ubo.View * push.Position;
-    vec3 positionInCameraSpace = lightCenterInCameraSpace.xyz + push.radius * vec3(fragOffset, 0.0);
+    vec4 lightCenterInCameraSpace = ubo.View * light.Position;
+    vec3 positionInCameraSpace = lightCenterInCameraSpace.xyz + light.Radius * vec3(fragOffset, 0.0);
 
     gl_Position = ubo.Projection * vec4(positionInCameraSpace, 1.0);
 }
\ No newline at end of file
@@ -107,4 +107,26 @@ namespace Divine
         m_InverseViewMatrix[3][1] = position.y;
         m_InverseViewMatrix[3][2] = position.z;
     }
-}
\ No newline at end of file
+
+    std::array<glm::vec4, 6> Camera::GetFrustumPlanes() const
+    {
+        // Gribb-Hartmann on projection * view, rows combine into the clip planes,
+        // depth is 0 to 1 so the near plane is the third row alone
+        const glm::mat4 clip = m_ProjectionMatrix * m_ViewMatrix;
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+
+        std::array<glm::vec4, 6> planes = {
+            rows[3] + rows[0],
+            rows[3] - rows[0],
+            rows[3] + rows[1],
+            rows[3] - rows[1],
+            rows[2],
+            rows[3] - rows[2]};
+
+        for (auto &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+        return planes;
+    }
+}
@@ -5,6 +5,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <array>
+
 namespace Divine
 {
     class Camera
@@ -14,6 +16,9 @@ namespace Divine
         inline const glm::mat4 &GetProjectionMat() const { return m_ProjectionMatrix; }
         inline const glm::mat4 &GetInverseViewMat() const { return m_InverseViewMatrix; }
         inline const glm::vec3 GetPosition() const { return glm::vec3(m_InverseViewMatrix[3]); }
+        // world space (normal, distance) of left, right, top, bottom, near and far,
+        // normals are unit length and point inside so dot(normal, p) + distance is the signed distance
+        std::array<glm::vec4, 6> GetFrustumPlanes() const;
 
         void SetOrthographicProjection(float left, float right, float top, float bottom, float near, float far);
         void SetPerspctiveProjection(float fovy, float aspect, float near, float far);
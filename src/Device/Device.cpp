@@ -1,8 +1,13 @@
 #include "Device.hpp"
+#include "Cpu_Profiler.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <filesystem>
 #include <stdexcept>
-#include <unordered_set>
+#include <string.h>
+#include <assert.h>
+#include <limits>
 
 namespace Divine
 {
@@ -14,6 +19,9 @@ namespace Divine
 #endif
     const std::vector<const char *> Device::s_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> Device::s_DeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    const std::vector<const char *> Device::s_OptionalDeviceExtensions = {VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+                                                                         VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
+    const std::string Device::s_PipelineCachePath = HOME_DIR "build/pipeline_cache.bin";
 
     VKAPI_ATTR VkBool32 VKAPI_CALL Device::DebugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -56,17 +64,23 @@ namespace Divine
         CreateInstance();
         if (Device::s_EnableValidationLayer)
             SetUpDebugMessenger();
-        CreateSurface();
+        if (!IsHeadless())
+            CreateSurface();
         PickPhysicalDevice();
         CreateLogicalDevice();
         CreateCommandPool();
+        CreatePipelineCache();
     }
 
     Device::~Device()
     {
+        DestroySingleTimeCommands();
+        SavePipelineCache();
+        vkDestroyPipelineCache(m_Device, m_PipelineCache, nullptr);
         vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
         vkDestroyDevice(m_Device, nullptr);
-        vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+        if (m_Surface != VK_NULL_HANDLE)
+            vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
         if (Device::s_EnableValidationLayer)
             DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
         vkDestroyInstance(m_Instance, nullptr);
@@ -83,7 +97,7 @@ namespace Divine
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -128,10 +142,14 @@ namespace Divine
 
     std::vector<const char *> Device::GetRequiredExtensions()
     {
-        uint32_t glfwExtensionCount;
-        const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char *> extensions;
+        if (!IsHeadless())
+        {
+            uint32_t glfwExtensionCount;
+            const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
         if (Device::s_EnableValidationLayer)
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
@@ -199,8 +217,9 @@ namespace Divine
 
         bool extensionSupport = CheckDeviceExtensionSupport(device);
 
-        bool SwapChainAdequate = false;
-        if (extensionSupport)
+        // nothing is presented in headless mode, so any surface support is irrelevant
+        bool SwapChainAdequate = IsHeadless();
+        if (extensionSupport && !IsHeadless())
         {
             auto details = QuerySwapChainSupportDetails(device);
             SwapChainAdequate = !details.formats.empty() && !details.presentModes.empty();
@@ -230,7 +249,10 @@ namespace Divine
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = VK_FALSE;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+            if (m_Surface != VK_NULL_HANDLE)
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+            else
+                presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == i; // headless: present aliases graphics
             if (presentSupport)
             {
                 indices.presentFamily = i;
@@ -252,13 +274,22 @@ namespace Divine
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::unordered_set<std::string> requiredExtensions(Device::s_DeviceExtensions.begin(), Device::s_DeviceExtensions.end());
+        auto required = GetRequiredDeviceExtensions();
+        std::unordered_set<std::string> requiredExtensions(required.begin(), required.end());
         for (const auto &extension : availableExtensions)
             requiredExtensions.erase(extension.extensionName);
 
         return requiredExtensions.empty();
     }
 
+    std::vector<const char *> Device::GetRequiredDeviceExtensions() const
+    {
+        if (IsHeadless())
+            return {};
+
+        return Device::s_DeviceExtensions;
+    }
+
     SwapChainSupportDetails Device::QuerySwapChainSupportDetails(const VkPhysicalDevice device) const
     {
         SwapChainSupportDetails details;
@@ -297,8 +328,14 @@ namespace Divine
             queueCreateInfos.push_back(queueInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // GPU driven drawing, one indirect call per model with the object index in firstInstance
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -307,8 +344,57 @@ namespace Divine
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(Device::s_DeviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = Device::s_DeviceExtensions.data();
+        // required extensions are guaranteed by IsDeviceSuitable, optional ones are enabled when present
+        std::vector<const char *> enabledExtensions = GetRequiredDeviceExtensions();
+
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        auto isAvailable = [&availableExtensions](const char *name)
+        {
+            for (const auto &extension : availableExtensions)
+            {
+                if (strcmp(name, extension.extensionName) == 0)
+                    return true;
+            }
+            return false;
+        };
+
+        for (const char *optional : Device::s_OptionalDeviceExtensions)
+        {
+            if (isAvailable(optional))
+                enabledExtensions.push_back(optional);
+        }
+
+        // present wait only matters with a swap chain, and both extensions come with a feature bit
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIDFeatures{};
+        presentIDFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIDFeatures.pNext = &presentWaitFeatures;
+
+        if (!IsHeadless() &&
+            m_DeviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+            isAvailable(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            isAvailable(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+        {
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &presentIDFeatures;
+            vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features2);
+
+            if (presentIDFeatures.presentId && presentWaitFeatures.presentWait)
+            {
+                enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+                createInfo.pNext = &presentIDFeatures;
+            }
+        }
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (Device::s_EnableValidationLayer)
         {
@@ -324,6 +410,9 @@ namespace Divine
         if (vkCreateDevice(m_PhysicalDevice, &createInfo, nullptr, &m_Device) != VK_SUCCESS)
             throw std::runtime_error("Failed to create logical device!");
 
+        m_EnabledExtensions.insert(enabledExtensions.begin(), enabledExtensions.end());
+        m_EnabledFeatures = deviceFeatures;
+
         vkGetDeviceQueue(m_Device, indices.graphicsFamily, 0, &m_GraphicsQueue);
         vkGetDeviceQueue(m_Device, indices.presentFamily, 0, &m_PresentQueue);
     }
@@ -341,6 +430,92 @@ namespace Divine
             throw std::runtime_error("Failed to create command pool!");
     }
 
+    void Device::CreatePipelineCache()
+    {
+        std::vector<char> cacheData;
+
+        std::ifstream ifs(Device::s_PipelineCachePath, std::ios::ate | std::ios::binary);
+        if (ifs.is_open())
+        {
+            cacheData.resize(static_cast<size_t>(ifs.tellg()));
+            ifs.seekg(0);
+            ifs.read(cacheData.data(), cacheData.size());
+            ifs.close();
+
+            if (!IsPipelineCacheCompatible(cacheData))
+            {
+                std::cout << "\tPipeline cache: discarding incompatible cache file" << std::endl;
+                cacheData.clear();
+            }
+            else
+                std::cout << "\tPipeline cache: loaded " << cacheData.size() << " bytes" << std::endl;
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+        if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline cache!");
+    }
+
+    bool Device::IsPipelineCacheCompatible(const std::vector<char> &cacheData) const
+    {
+        // a cache blob produced by another driver or GPU is at best ignored and at worst crashes the driver
+        VkPipelineCacheHeaderVersionOne header{};
+        if (cacheData.size() < sizeof(header))
+            return false;
+
+        memcpy(&header, cacheData.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header) &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == m_DeviceProperties.vendorID &&
+               header.deviceID == m_DeviceProperties.deviceID &&
+               memcmp(header.pipelineCacheUUID, m_DeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void Device::SavePipelineCache()
+    {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+            return;
+
+        std::vector<char> cacheData(dataSize);
+        if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+            return;
+
+        // write next to the target and rename over it so a crash never leaves a truncated cache behind
+        std::filesystem::path cachePath{Device::s_PipelineCachePath};
+        std::filesystem::path tempPath{Device::s_PipelineCachePath + ".tmp"};
+        std::error_code ec;
+        std::filesystem::create_directories(cachePath.parent_path(), ec);
+
+        std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            std::cerr << "Failed to write pipeline cache: " << tempPath.string() << std::endl;
+            return;
+        }
+        ofs.write(cacheData.data(), dataSize);
+        ofs.close();
+
+        if (!ofs.good())
+        {
+            std::filesystem::remove(tempPath, ec);
+            std::cerr << "Failed to write pipeline cache: " << tempPath.string() << std::endl;
+            return;
+        }
+
+        std::filesystem::rename(tempPath, cachePath, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            std::cerr << "Failed to replace pipeline cache: " << cachePath.string() << std::endl;
+        }
+    }
+
     void Device::CreateBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
@@ -373,42 +548,100 @@ namespace Divine
     }
 
     uint32_t Device::FindMemoryTypeIndex(uint32_t typeFliter, VkMemoryPropertyFlags properties)
+    {
+        uint32_t index;
+        if (!TryFindMemoryTypeIndex(typeFliter, properties, index))
+            throw std::runtime_error("Failed to find suitable memory type!");
+
+        return index;
+    }
+
+    bool Device::TryFindMemoryTypeIndex(uint32_t typeFliter, VkMemoryPropertyFlags properties, uint32_t &index) const
     {
         VkPhysicalDeviceMemoryProperties memProperties;
         vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
         for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
         {
             if ((typeFliter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-                return i;
+            {
+                index = i;
+                return true;
+            }
         }
 
-        throw std::runtime_error("Failed to find suitable memory type!");
+        return false;
     }
 
     VkCommandBuffer Device::BeginSingleTimeCommands()
     {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = m_CommandPool;
-        allocInfo.commandBufferCount = 1;
+        // reuse a command buffer whose previous submission has retired, only grow the pool when all are busy
+        uint32_t slotIndex = static_cast<uint32_t>(m_SingleTimeSlots.size());
+        for (uint32_t i = 0; i < m_SingleTimeSlots.size(); ++i)
+        {
+            auto &slot = m_SingleTimeSlots[i];
+            if (slot.recording)
+                continue;
+            if (slot.submitted && vkGetFenceStatus(m_Device, slot.fence) != VK_SUCCESS)
+                continue;
+
+            slotIndex = i;
+            break;
+        }
 
-        VkCommandBuffer commandBuffer;
-        if (vkAllocateCommandBuffers(m_Device, &allocInfo, &commandBuffer) != VK_SUCCESS)
-            throw std::runtime_error("Failed to allocate command buffer!");
+        if (slotIndex == m_SingleTimeSlots.size())
+        {
+            SingleTimeCommandSlot slot{};
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = m_CommandPool;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(m_Device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate command buffer!");
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+            if (vkCreateFence(m_Device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create single time command fence!");
+
+            m_SingleTimeSlots.push_back(slot);
+        }
+
+        auto &slot = m_SingleTimeSlots[slotIndex];
+        if (slot.submitted)
+        {
+            if (vkResetFences(m_Device, 1, &slot.fence) != VK_SUCCESS)
+                throw std::runtime_error("Failed to reset fence!");
+            vkResetCommandBuffer(slot.commandBuffer, 0);
+            slot.submitted = false;
+        }
+        slot.recording = true;
+        ++slot.generation;
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS)
             throw std::runtime_error("Failed to begin single time command buffer!");
 
-        return commandBuffer;
+        return slot.commandBuffer;
     }
 
-    void Device::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
+    SubmitToken Device::SubmitSingleTimeCommands(VkCommandBuffer commandBuffer)
     {
+        DIVINE_PROFILE_FUNCTION();
+        uint32_t slotIndex = 0;
+        while (slotIndex < m_SingleTimeSlots.size() && m_SingleTimeSlots[slotIndex].commandBuffer != commandBuffer)
+            ++slotIndex;
+
+        assert(slotIndex < m_SingleTimeSlots.size() && m_SingleTimeSlots[slotIndex].recording &&
+               "Can't submit a command buffer that was not begun by BeginSingleTimeCommands");
+        auto &slot = m_SingleTimeSlots[slotIndex];
+
         vkEndCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo{};
@@ -416,16 +649,69 @@ namespace Divine
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) /*No Fence*/
+        if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
             throw std::runtime_error("Failed to submit command buffer!");
 
-        vkQueueWaitIdle(m_GraphicsQueue);
+        slot.recording = false;
+        slot.submitted = true;
+
+        return SubmitToken{slotIndex, slot.generation};
+    }
+
+    bool Device::IsSubmissionComplete(const SubmitToken &token)
+    {
+        if (token.slot >= m_SingleTimeSlots.size())
+            return true;
+
+        // a recycled slot means the submission it carried has already retired
+        const auto &slot = m_SingleTimeSlots[token.slot];
+        if (slot.generation != token.generation || !slot.submitted)
+            return true;
+
+        return vkGetFenceStatus(m_Device, slot.fence) == VK_SUCCESS;
+    }
+
+    void Device::WaitForSubmission(const SubmitToken &token)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        if (IsSubmissionComplete(token))
+            return;
+
+        vkWaitForFences(
+            m_Device,
+            1,
+            &m_SingleTimeSlots[token.slot].fence,
+            VK_TRUE,
+            std::numeric_limits<uint64_t>::max());
+    }
+
+    void Device::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
+    {
+        // only waits for this submission instead of draining the whole graphics queue
+        WaitForSubmission(SubmitSingleTimeCommands(commandBuffer));
+    }
+
+    void Device::DestroySingleTimeCommands()
+    {
+        for (auto &slot : m_SingleTimeSlots)
+        {
+            if (slot.submitted)
+                vkWaitForFences(m_Device, 1, &slot.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            vkDestroyFence(m_Device, slot.fence, nullptr);
+            vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &slot.commandBuffer);
+        }
 
-        vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &commandBuffer);
+        m_SingleTimeSlots.clear();
     }
 
     void Device::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
     {
+        WaitForSubmission(CopyBufferAsync(srcBuffer, dstBuffer, size));
+    }
+
+    SubmitToken Device::CopyBufferAsync(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+    {
+        DIVINE_PROFILE_FUNCTION();
         VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
 
         VkBufferCopy copyRegion{};
@@ -435,11 +721,17 @@ namespace Divine
 
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-        EndSingleTimeCommands(commandBuffer);
+        return SubmitSingleTimeCommands(commandBuffer);
     }
 
     void Device::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
     {
+        WaitForSubmission(CopyBufferToImageAsync(buffer, image, width, height, layerCount));
+    }
+
+    SubmitToken Device::CopyBufferToImageAsync(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
+    {
+        DIVINE_PROFILE_FUNCTION();
         VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
 
         VkBufferImageCopy region{};
@@ -457,7 +749,7 @@ namespace Divine
 
         vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-        EndSingleTimeCommands(commandBuffer);
+        return SubmitSingleTimeCommands(commandBuffer);
     }
 
     void Device::CreateImageWithInfo(
@@ -484,6 +776,39 @@ namespace Divine
             throw std::runtime_error("Failed to bind image memory!");
     }
 
+    void Device::CreateTransientImage(
+        const VkImageCreateInfo &imageInfo,
+        VkImage &image,
+        VkDeviceMemory &imageMemory)
+    {
+        assert((imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+               "Transient images need VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT");
+
+        if (vkCreateImage(m_Device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create image!");
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_Device, image, &memRequirements);
+
+        // tilers keep lazily allocated attachments in tile memory, desktop GPUs rarely expose the type
+        uint32_t memoryTypeIndex;
+        if (!TryFindMemoryTypeIndex(memRequirements.memoryTypeBits,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                    memoryTypeIndex))
+            memoryTypeIndex = FindMemoryTypeIndex(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate image memory!");
+
+        if (vkBindImageMemory(m_Device, image, imageMemory, 0) != VK_SUCCESS)
+            throw std::runtime_error("Failed to bind image memory!");
+    }
+
     VkFormat Device::FindSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
     {
         for (VkFormat format : candidates)
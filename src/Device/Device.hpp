@@ -5,6 +5,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_set>
 
 namespace Divine
 {
@@ -25,6 +26,13 @@ namespace Divine
         inline bool IsComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // identifies one single time submission, stays valid after the command buffer is recycled
+    struct SubmitToken
+    {
+        uint32_t slot = UINT32_MAX;
+        uint64_t generation = 0;
+    };
+
     class Device
     {
     public:
@@ -33,12 +41,18 @@ namespace Divine
         Device(const Window &) = delete;
         Device &operator=(const Device &) = delete;
 
+        inline bool IsHeadless() const { return r_Window.IsHeadless(); }
         inline VkInstance GetInstance() const { return m_Instance; }
+        inline VkPhysicalDevice GetPhysicalDevice() const { return m_PhysicalDevice; }
         inline VkSurfaceKHR GetSurface() const { return m_Surface; }
         inline VkDevice GetDevice() const { return m_Device; }
         inline VkQueue GetGraphicsQueue() const { return m_GraphicsQueue; }
         inline VkQueue GetPresentQueue() const { return m_PresentQueue; }
         inline VkCommandPool GetCommandPool() const { return m_CommandPool; }
+        inline VkPipelineCache GetPipelineCache() const { return m_PipelineCache; }
+        inline bool IsExtensionEnabled(const std::string &extensionName) const { return m_EnabledExtensions.count(extensionName) > 0; }
+        // core features beyond the required ones are enabled whenever the device has them
+        inline const VkPhysicalDeviceFeatures &GetEnabledFeatures() const { return m_EnabledFeatures; }
 
         inline QueueFamilyIndices GetQueueFamilyIndices() const { return FindQueueFamilyIndices(m_PhysicalDevice); }
         inline SwapChainSupportDetails GetSwapChainSupportDetails() const { return QuerySwapChainSupportDetails(m_PhysicalDevice); }
@@ -50,16 +64,27 @@ namespace Divine
             VkBuffer &buffer,
             VkDeviceMemory &bufferMemory);
         uint32_t FindMemoryTypeIndex(uint32_t typeFliter, VkMemoryPropertyFlags properties);
+        bool TryFindMemoryTypeIndex(uint32_t typeFliter, VkMemoryPropertyFlags properties, uint32_t &index) const;
 
         VkCommandBuffer BeginSingleTimeCommands();
         void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
+        SubmitToken SubmitSingleTimeCommands(VkCommandBuffer commandBuffer);
+        bool IsSubmissionComplete(const SubmitToken &token);
+        void WaitForSubmission(const SubmitToken &token);
         void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+        SubmitToken CopyBufferAsync(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
         void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+        SubmitToken CopyBufferToImageAsync(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
         void CreateImageWithInfo(
             const VkImageCreateInfo &imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage &image,
             VkDeviceMemory &imageMemory);
+        // for attachments that never leave the render pass, backed by lazily allocated memory when available
+        void CreateTransientImage(
+            const VkImageCreateInfo &imageInfo,
+            VkImage &image,
+            VkDeviceMemory &imageMemory);
 
         VkFormat FindSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -77,27 +102,50 @@ namespace Divine
         bool IsDeviceSuitable(VkPhysicalDevice device);
         QueueFamilyIndices FindQueueFamilyIndices(const VkPhysicalDevice device) const;
         bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+        std::vector<const char *> GetRequiredDeviceExtensions() const;
         SwapChainSupportDetails QuerySwapChainSupportDetails(const VkPhysicalDevice device) const;
 
         void CreateLogicalDevice();
 
         void CreateCommandPool();
 
+        void DestroySingleTimeCommands();
+
+        void CreatePipelineCache();
+        bool IsPipelineCacheCompatible(const std::vector<char> &cacheData) const;
+        void SavePipelineCache();
+
+    private:
+        struct SingleTimeCommandSlot
+        {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            uint64_t generation = 0;
+            bool recording = false;
+            bool submitted = false;
+        };
+
     private:
         Window &r_Window;
         VkInstance m_Instance;
         VkDebugUtilsMessengerEXT m_DebugMessenger;
-        VkSurfaceKHR m_Surface;
+        VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
         VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
         VkDevice m_Device;
         VkQueue m_GraphicsQueue;
         VkQueue m_PresentQueue;
         VkCommandPool m_CommandPool;
+        VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
+        std::vector<SingleTimeCommandSlot> m_SingleTimeSlots;
+        std::unordered_set<std::string> m_EnabledExtensions;
+        VkPhysicalDeviceFeatures m_EnabledFeatures{};
 
     public:
         static const bool s_EnableValidationLayer;
         static const std::vector<const char *> s_ValidationLayers;
         static const std::vector<const char *> s_DeviceExtensions;
+        static const std::vector<const char *> s_OptionalDeviceExtensions;
+        static const std::string s_PipelineCachePath;
         static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
             VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
             VkDebugUtilsMessageTypeFlagsEXT messageType,
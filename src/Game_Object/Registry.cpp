@@ -0,0 +1,48 @@
+#include "Registry.hpp"
+
+#include <stdexcept>
+
+namespace Divine
+{
+    Entity Registry::Create()
+    {
+        uint32_t index;
+        if (!m_FreeIndices.empty())
+        {
+            index = m_FreeIndices.back();
+            m_FreeIndices.pop_back();
+        }
+        else
+        {
+            if (m_Versions.size() > s_EntityIndexMask)
+                throw std::runtime_error("Failed to create entity, out of indices!");
+
+            index = static_cast<uint32_t>(m_Versions.size());
+            m_Versions.push_back(0);
+        }
+
+        return (m_Versions[index] << s_EntityIndexBits) | index;
+    }
+
+    void Registry::Destroy(Entity entity)
+    {
+        if (!IsValid(entity))
+            return;
+
+        for (auto &up_Pool : m_Pools)
+        {
+            if (up_Pool != nullptr)
+                up_Pool->Remove(entity);
+        }
+
+        uint32_t index = GetEntityIndex(entity);
+        m_Versions[index] = (m_Versions[index] + 1) & (UINT32_MAX >> s_EntityIndexBits);
+        m_FreeIndices.push_back(index);
+    }
+
+    bool Registry::IsValid(Entity entity) const
+    {
+        uint32_t index = GetEntityIndex(entity);
+        return entity != NullEntity && index < m_Versions.size() && m_Versions[index] == GetEntityVersion(entity);
+    }
+}
@@ -0,0 +1,186 @@
+#ifndef REGISTRY_HEADER
+#define REGISTRY_HEADER
+
+#include <assert.h>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Divine
+{
+    // low bits index the entity slot, high bits count how often the slot was reused
+    using Entity = uint32_t;
+    static constexpr Entity NullEntity = UINT32_MAX;
+    static constexpr uint32_t s_EntityIndexBits = 24;
+    static constexpr uint32_t s_EntityIndexMask = (1u << s_EntityIndexBits) - 1;
+
+    inline uint32_t GetEntityIndex(Entity entity) { return entity & s_EntityIndexMask; }
+    inline uint32_t GetEntityVersion(Entity entity) { return entity >> s_EntityIndexBits; }
+
+    class ComponentPoolBase
+    {
+    public:
+        virtual ~ComponentPoolBase() = default;
+        virtual bool Contains(Entity entity) const = 0;
+        virtual void Remove(Entity entity) = 0;
+    };
+
+    // Sparse set: components are packed densely in insertion order, the sparse array maps an entity
+    // index to its dense slot. Add and remove are O(1), removal moves the last component into the hole.
+    template <typename T>
+    class ComponentPool : public ComponentPoolBase
+    {
+    public:
+        inline size_t GetSize() const { return m_Components.size(); }
+        inline const std::vector<Entity> &GetEntities() const { return m_Entities; }
+        inline T *GetData() { return m_Components.data(); }
+        // bumped on every add and remove, lets caches built over the pool detect structural changes
+        inline uint64_t GetVersion() const { return m_Version; }
+
+        bool Contains(Entity entity) const override
+        {
+            uint32_t index = GetEntityIndex(entity);
+            return index < m_Sparse.size() && m_Sparse[index] != NullEntity && m_Entities[m_Sparse[index]] == entity;
+        }
+
+        template <typename... Args>
+        T &Add(Entity entity, Args &&...args)
+        {
+            assert(!Contains(entity) && "Entity already has this component");
+
+            uint32_t index = GetEntityIndex(entity);
+            if (index >= m_Sparse.size())
+                m_Sparse.resize(index + 1, NullEntity);
+
+            m_Sparse[index] = static_cast<uint32_t>(m_Components.size());
+            m_Entities.push_back(entity);
+            m_Components.push_back(T{std::forward<Args>(args)...});
+            ++m_Version;
+            return m_Components.back();
+        }
+
+        void Remove(Entity entity) override
+        {
+            if (!Contains(entity))
+                return;
+
+            uint32_t slot = m_Sparse[GetEntityIndex(entity)];
+            uint32_t last = static_cast<uint32_t>(m_Components.size() - 1);
+            if (slot != last)
+            {
+                m_Components[slot] = std::move(m_Components[last]);
+                m_Entities[slot] = m_Entities[last];
+                m_Sparse[GetEntityIndex(m_Entities[slot])] = slot;
+            }
+
+            m_Components.pop_back();
+            m_Entities.pop_back();
+            m_Sparse[GetEntityIndex(entity)] = NullEntity;
+            ++m_Version;
+        }
+
+        inline T &Get(Entity entity)
+        {
+            assert(Contains(entity) && "Entity doesn't have this component");
+            return m_Components[m_Sparse[GetEntityIndex(entity)]];
+        }
+
+    private:
+        std::vector<uint32_t> m_Sparse;
+        std::vector<Entity> m_Entities;
+        std::vector<T> m_Components;
+        uint64_t m_Version = 0;
+    };
+
+    // Iterates the dense array of the first component and looks the others up, so the rarest
+    // component should come first. Components must not be added or removed while iterating.
+    template <typename T, typename... Others>
+    class View
+    {
+    public:
+        View(ComponentPool<T> &pool, ComponentPool<Others> &...others)
+            : r_Pool{pool}, m_Others{others...} {}
+
+        template <typename F>
+        void Each(F &&function)
+        {
+            const std::vector<Entity> &entities = r_Pool.GetEntities();
+            T *components = r_Pool.GetData();
+            for (size_t i = 0; i < entities.size(); ++i)
+            {
+                Entity entity = entities[i];
+                if ((std::get<ComponentPool<Others> &>(m_Others).Contains(entity) && ...))
+                    function(entity, components[i], std::get<ComponentPool<Others> &>(m_Others).Get(entity)...);
+            }
+        }
+
+    private:
+        ComponentPool<T> &r_Pool;
+        std::tuple<ComponentPool<Others> &...> m_Others;
+    };
+
+    class Registry
+    {
+    public:
+        Registry() = default;
+        Registry(const Registry &) = delete;
+        Registry &operator=(const Registry &) = delete;
+
+        inline size_t GetEntityCount() const { return m_Versions.size() - m_FreeIndices.size(); }
+
+        Entity Create();
+        // removes every component, the handle and its copies become invalid
+        void Destroy(Entity entity);
+        bool IsValid(Entity entity) const;
+
+        template <typename T, typename... Args>
+        T &Add(Entity entity, Args &&...args)
+        {
+            assert(IsValid(entity) && "Invalid entity");
+            return GetPool<T>().Add(entity, std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        void Remove(Entity entity) { GetPool<T>().Remove(entity); }
+
+        template <typename T>
+        bool Has(Entity entity) { return GetPool<T>().Contains(entity); }
+
+        template <typename T>
+        T &Get(Entity entity) { return GetPool<T>().Get(entity); }
+
+        template <typename T, typename... Others>
+        View<T, Others...> GetView() { return View<T, Others...>(GetPool<T>(), GetPool<Others>()...); }
+
+        template <typename T>
+        ComponentPool<T> &GetPool()
+        {
+            uint32_t typeID = GetComponentTypeID<T>();
+            if (typeID >= m_Pools.size())
+                m_Pools.resize(typeID + 1);
+            if (m_Pools[typeID] == nullptr)
+                m_Pools[typeID] = std::make_unique<ComponentPool<T>>();
+
+            return *static_cast<ComponentPool<T> *>(m_Pools[typeID].get());
+        }
+
+    private:
+        template <typename T>
+        static uint32_t GetComponentTypeID()
+        {
+            static const uint32_t s_TypeID = s_NextComponentTypeID++;
+            return s_TypeID;
+        }
+
+    private:
+        inline static uint32_t s_NextComponentTypeID = 0;
+
+        std::vector<uint32_t> m_Versions;
+        std::vector<uint32_t> m_FreeIndices;
+        std::vector<std::unique_ptr<ComponentPoolBase>> m_Pools;
+    };
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TRANSFORM_COMPONENT_HEADER
+#define TRANSFORM_COMPONENT_HEADER
+
+#include "Registry.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace Divine
+{
+    struct TransformComponent
+    {
+        glm::vec3 translation{};           // position offset
+        glm::vec3 scale{1.0f, 1.0f, 1.0f}; // scale rate
+        glm::vec3 rotation{};              // rotate radians
+        bool dirty = true;                 // cached world matrices are stale, set by the setters
+
+        inline void SetTranslation(const glm::vec3 &value)
+        {
+            translation = value;
+            dirty = true;
+        }
+        inline void SetScale(const glm::vec3 &value)
+        {
+            scale = value;
+            dirty = true;
+        }
+        inline void SetRotation(const glm::vec3 &value)
+        {
+            rotation = value;
+            dirty = true;
+        }
+
+        // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
+        // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+        // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+        glm::mat4 GetModelMat();
+        glm::mat3 GetNormalMat();
+    };
+
+    // parent links, set through TransformSystem::SetParent
+    struct HierarchyComponent
+    {
+        Entity parent = NullEntity;
+    };
+
+    // world space matrices cached by TransformSystem, parent * local
+    struct WorldTransformComponent
+    {
+        glm::mat4 modelMatrix{1.0f};
+        glm::mat4 normalMatrix{1.0f};
+        bool changed = false; // recomputed during the last update
+    };
+}
+
+#endif
@@ -4,7 +4,7 @@
 
 namespace Divine
 {
-    void KeyboardController::MoveInPlaneXZ(GLFWwindow *window, float dt, DivineGameObject &gameObjects)
+    void KeyboardController::MoveInPlaneXZ(GLFWwindow *window, float dt, TransformComponent &transform)
     {
         glm::vec3 rotate{0.0f};
 
@@ -18,12 +18,12 @@ namespace Divine
             rotate.x -= 1.0f;
 
         if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon())
-            gameObjects.m_ModelMatrix.rotation += m_TurnSpeed * dt * glm::normalize(rotate);
+            transform.rotation += m_TurnSpeed * dt * glm::normalize(rotate);
 
-        gameObjects.m_ModelMatrix.rotation.x = glm::clamp(gameObjects.m_ModelMatrix.rotation.x, -1.5f, 1.5f); // radians
-        gameObjects.m_ModelMatrix.rotation.y = glm::mod(gameObjects.m_ModelMatrix.rotation.y, glm::two_pi<float>());
+        transform.rotation.x = glm::clamp(transform.rotation.x, -1.5f, 1.5f); // radians
+        transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
 
-        float yaw = gameObjects.m_ModelMatrix.rotation.y;
+        float yaw = transform.rotation.y;
         const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
         const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
         const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -44,7 +44,7 @@ namespace Divine
 
         if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon())
         {
-            gameObjects.m_ModelMatrix.translation += m_MoveSpeed * dt * glm::normalize(moveDir);
+            transform.translation += m_MoveSpeed * dt * glm::normalize(moveDir);
         }
     }
 }
\ No newline at end of file
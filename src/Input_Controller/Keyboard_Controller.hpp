@@ -23,7 +23,7 @@ namespace Divine
             int lookDown = GLFW_KEY_DOWN;
         };
 
-        void MoveInPlaneXZ(GLFWwindow *window, float dt, DivineGameObject &gameObjects);
+        void MoveInPlaneXZ(GLFWwindow *window, float dt, TransformComponent &transform);
 
     public:
         KeyMappings m_Keys{};
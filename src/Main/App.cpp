@@ -1,17 +1,23 @@
 #include "App.hpp"
 
 #include <iostream>
+#include <fstream>
 #include <stdexcept>
 #include <array>
 #include <chrono>
 
 namespace Divine
 {
-    App::App()
+    App::App(const AppConfig &config)
+        : m_Config{config}
     {
+        if (m_Config.headless && m_Config.frameCount == 0)
+            m_Config.frameCount = 1000;
+
         up_GlobalPool = DescriptorPool::Builder(m_Device)
-                            .SetMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-                            .AddPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+                            .SetMaxSets(m_Renderer.GetFramesInFlight())
+                            .AddPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_Renderer.GetFramesInFlight())
+                            .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * m_Renderer.GetFramesInFlight())
                             .Build();
         LoadGameObjects();
     }
@@ -20,27 +26,22 @@ namespace Divine
 
     void App::LoadGameObjects()
     {
+        DIVINE_PROFILE_FUNCTION();
         std::shared_ptr<Model> model = Model::CreateModelFromFile(m_Device, HOME_DIR "res/models/smooth_vase.obj");
 
-        auto smooth = DivineGameObject::CreateGameObject();
-        smooth.sp_Model = model;
-        smooth.m_ModelMatrix.translation = {-0.5f, 0.5f, 0.0f};
-        smooth.m_ModelMatrix.scale = {3.0f, 1.5f, 3.0f};
-        m_GameObjects.emplace(smooth.GetID(), std::move(smooth));
+        auto &smooth = m_Registry.Get<TransformComponent>(CreateGameObject(m_Registry, model));
+        smooth.translation = {-0.5f, 0.5f, 0.0f};
+        smooth.scale = {3.0f, 1.5f, 3.0f};
 
         model = Model::CreateModelFromFile(m_Device, HOME_DIR "res/models/flat_vase.obj");
-        auto flat = DivineGameObject::CreateGameObject();
-        flat.sp_Model = model;
-        flat.m_ModelMatrix.translation = {0.5f, 0.5f, 0.0f};
-        flat.m_ModelMatrix.scale = {3.0f, 1.5f, 3.0f};
-        m_GameObjects.emplace(flat.GetID(), std::move(flat));
+        auto &flat = m_Registry.Get<TransformComponent>(CreateGameObject(m_Registry, model));
+        flat.translation = {0.5f, 0.5f, 0.0f};
+        flat.scale = {3.0f, 1.5f, 3.0f};
 
         model = Model::CreateModelFromFile(m_Device, HOME_DIR "res/models/quad.obj");
-        auto floor = DivineGameObject::CreateGameObject();
-        floor.sp_Model = model;
-        floor.m_ModelMatrix.translation = {0.0f, 0.5f, 0.0f};
-        floor.m_ModelMatrix.scale = {3.0f, 1.0f, 3.0f};
-        m_GameObjects.emplace(floor.GetID(), std::move(floor));
+        auto &floor = m_Registry.Get<TransformComponent>(CreateGameObject(m_Registry, model));
+        floor.translation = {0.0f, 0.5f, 0.0f};
+        floor.scale = {3.0f, 1.0f, 3.0f};
 
         std::vector<glm::vec3> lightColors = {
             {1.f, 1.f, .1f},
@@ -52,19 +53,17 @@ namespace Divine
 
         for (int i = 0; i < lightColors.size(); ++i)
         {
-            auto pointLight = DivineGameObject::MakePointLight(1.0f);
-            pointLight.m_Color = lightColors[i];
+            Entity pointLight = CreatePointLight(m_Registry, 1.0f, 0.1f, lightColors[i]);
             auto rotateLight = glm::rotate(glm::mat4(1.0f),
                                            (i * glm::two_pi<float>() / lightColors.size()),
                                            {0.f, -1.f, 0.f});
-            pointLight.m_ModelMatrix.translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
-            m_GameObjects.emplace(pointLight.GetID(), std::move(pointLight));
+            m_Registry.Get<TransformComponent>(pointLight).translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
         }
     }
 
-    void App::run()
+    bool App::run()
     {
-        std::vector<std::unique_ptr<Buffer>> ubos(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        std::vector<std::unique_ptr<Buffer>> ubos(m_Renderer.GetFramesInFlight());
         for (size_t i = 0; i < ubos.size(); ++i)
         {
             ubos[i] = std::make_unique<Buffer>(m_Device,
@@ -75,47 +74,241 @@ namespace Divine
             ubos[i]->Map();
         }
 
+        // owns the light buffers and the cluster light lists the global sets point at
+        LightClusterSystem lightClusterSystem{m_Device, m_Renderer.GetFramesInFlight(), m_Config.cpuLightBinning};
+        std::vector<PointLight> lights;
+
         auto globalSetLayout = DescriptorSetLayout::Builder(m_Device)
                                    .AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+                                   .AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+                                   .AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                                   .AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
                                    .Build();
 
-        std::vector<VkDescriptorSet> globalDescriptorSets(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        std::vector<VkDescriptorSet> globalDescriptorSets(m_Renderer.GetFramesInFlight());
         for (int i = 0; i < globalDescriptorSets.size(); ++i)
         {
             auto bufferInfo = ubos[i]->GetDescriptorBufferInfo();
+            auto lightInfo = lightClusterSystem.GetLightInfo(i);
+            auto countInfo = lightClusterSystem.GetCountInfo(i);
+            auto indexInfo = lightClusterSystem.GetIndexInfo(i);
             DescriptorWriter(*globalSetLayout, *up_GlobalPool)
                 .WriteBuffer(0, &bufferInfo)
+                .WriteBuffer(1, &lightInfo)
+                .WriteBuffer(2, &countInfo)
+                .WriteBuffer(3, &indexInfo)
                 .Build(globalDescriptorSets[i]);
         }
 
+        // both systems submit their pipelines to the compiler, so they are built in parallel
         RenderSystem renderSystem{m_Device,
+                                  m_ThreadPool,
+                                  m_PipelineCompiler,
                                   m_Renderer.GetSwapChainRenderPass(),
-                                  globalSetLayout->GetDescriptorSetLayout()};
+                                  globalSetLayout->GetDescriptorSetLayout(),
+                                  m_Renderer.GetFramesInFlight()};
 
         PointLightSystem pointLightSystem{m_Device,
+                                          m_PipelineCompiler,
                                           m_Renderer.GetSwapChainRenderPass(),
-                                          globalSetLayout->GetDescriptorSetLayout()};
+                                          globalSetLayout->GetDescriptorSetLayout(),
+                                          m_Renderer.GetFramesInFlight()};
+        // objects are culled and drawn by the GPU unless the device lacks indirect multi draw
+        std::unique_ptr<IndirectRenderSystem> up_IndirectRenderSystem;
+        if (!m_Config.cpuCulling && IndirectRenderSystem::IsSupported(m_Device))
+            up_IndirectRenderSystem = std::make_unique<IndirectRenderSystem>(m_Device,
+                                                                             m_PipelineCompiler,
+                                                                             m_Renderer.GetSwapChainRenderPass(),
+                                                                             globalSetLayout->GetDescriptorSetLayout(),
+                                                                             m_Renderer.GetFramesInFlight());
+        else if (!m_Config.cpuCulling)
+            std::cout << "\tGPU culling disabled, the device lacks multi draw indirect" << std::endl;
+        IndirectRenderSystem *pIndirectRenderSystem = up_IndirectRenderSystem.get();
+
+        // its pipelines need the deferred render pass, they are created with the first graph that has it
+        DeferredRenderSystem deferredRenderSystem{m_Device,
+                                                  globalSetLayout->GetDescriptorSetLayout(),
+                                                  m_Renderer.GetFramesInFlight()};
+        bool deferredShading = m_Config.deferred;
+        bool deferredKeyDown = false;
+
+        TransformSystem transformSystem{};
+        SpatialSystem spatialSystem{m_ThreadPool};
+        GpuProfiler gpuProfiler{m_Device, m_Renderer.GetFramesInFlight()};
+        ResolutionScaler resolutionScaler{m_Config.resolutionScaling};
+
+        // the scene is upscaled with a linear blit, which the target format and usage have to allow
+        VkFormatProperties colorFormatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_Device.GetPhysicalDevice(), m_Renderer.GetColorFormat(), &colorFormatProperties);
+        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        bool upscale = resolutionScaler.IsEnabled() &&
+                       (colorFormatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures &&
+                       (m_Renderer.GetColorUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+        if (resolutionScaler.IsEnabled() && !upscale)
+            std::cout << "\tResolution scaling disabled, the render target can't be blitted to" << std::endl;
+        VkExtent2D sceneExtent = m_Renderer.GetRenderExtent();
+
+        // frames are read back asynchronously for captures and golden image checks
+        ReadbackFrame goldenFrame{};
+        bool checkGolden = !m_Config.goldenPath.empty();
+        if (checkGolden && !FrameReadback::ReadPPM(m_Config.goldenPath, goldenFrame))
+            throw std::runtime_error("Failed to read golden image: " + m_Config.goldenPath);
+        std::atomic<uint64_t> goldenChecked{0};
+        std::atomic<uint64_t> goldenFailed{0};
+        std::mutex lastFrameMutex;
+        ReadbackFrame lastFrame{};
+
+        bool readback = (!m_Config.capturePath.empty() || m_Config.captureInterval > 0 || checkGolden) &&
+                        (m_Renderer.GetColorUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        auto onFrameReadback = [&](const ReadbackFrame &frame)
+        {
+            if (m_Config.captureInterval > 0 && frame.frameNumber % m_Config.captureInterval == 0)
+                FrameReadback::WriteImage(frame, m_Config.captureDirectory + "/frame_" + std::to_string(frame.frameNumber) + ".tga");
+
+            if (checkGolden)
+            {
+                ++goldenChecked;
+                if (FrameReadback::CountMismatchedPixels(frame, goldenFrame, m_Config.goldenTolerance) > 0)
+                    ++goldenFailed;
+            }
+
+            if (!m_Config.capturePath.empty())
+            {
+                std::lock_guard<std::mutex> lock(lastFrameMutex);
+                if (lastFrame.pixels.empty() || frame.frameNumber > lastFrame.frameNumber)
+                    lastFrame = frame;
+            }
+        };
+        std::shared_ptr<FrameReadback> sp_FrameReadback;
+
+        uint32_t framesRendered = 0;
+
+        // the frame is described as a render graph, rebuilt whenever the renderer recreates its targets
+        FrameGraphSystems frameGraphSystems{renderSystem,
+                                            pIndirectRenderSystem,
+                                            pointLightSystem,
+                                            deferredRenderSystem,
+                                            lightClusterSystem,
+                                            spatialSystem,
+                                            gpuProfiler,
+                                            lights};
+        std::shared_ptr<FrameGraph> sp_FrameGraph;
+        // a deferred graph whose pipelines still compile, the forward graph draws meanwhile
+        std::shared_ptr<FrameGraph> sp_PendingFrameGraph;
+        auto retireFrameGraph = [&](std::shared_ptr<FrameGraph> &sp_Graph)
+        {
+            if (sp_Graph == nullptr)
+                return;
+
+            // its frame buffers may still be used by frames in flight
+            std::shared_ptr<FrameGraph> oldFrameGraph = std::move(sp_Graph);
+            m_Renderer.EnqueueDeferredDeletion([oldFrameGraph]() mutable
+                                               { oldFrameGraph = nullptr; });
+        };
+        auto buildFrameGraph = [&](bool deferred)
+        {
+            FrameGraphConfig frameGraphConfig{};
+            frameGraphConfig.deferred = deferred;
+            frameGraphConfig.upscale = upscale;
+            frameGraphConfig.pFrameReadback = sp_FrameReadback.get();
+            auto sp_Graph = std::make_shared<FrameGraph>(m_Device, m_Renderer, frameGraphSystems, frameGraphConfig);
+
+            if (deferred && !deferredRenderSystem.HasPipelines())
+                sp_Graph->CreateDeferredPipelines(m_PipelineCompiler);
+            return sp_Graph;
+        };
+        auto updateFrameGraph = [&]()
+        {
+            uint64_t targetGeneration = m_Renderer.GetTargetGeneration();
+
+            // headless runs wait for the pipelines, every frame they capture has to show the chosen path
+            if (sp_PendingFrameGraph != nullptr && (m_Window.IsHeadless() || sp_PendingFrameGraph->IsReady()))
+            {
+                // a stale pending graph was only kept alive for the compilation that uses its render pass
+                if (deferredShading && sp_PendingFrameGraph->GetTargetGeneration() == targetGeneration)
+                    std::swap(sp_FrameGraph, sp_PendingFrameGraph);
+                retireFrameGraph(sp_PendingFrameGraph);
+            }
+
+            bool stale = sp_FrameGraph == nullptr || sp_FrameGraph->GetTargetGeneration() != targetGeneration;
+            if (!stale && sp_FrameGraph->IsDeferred() == deferredShading)
+                return;
+
+            if (stale && readback)
+            {
+                if (sp_FrameReadback != nullptr)
+                {
+                    std::shared_ptr<FrameReadback> oldFrameReadback = std::move(sp_FrameReadback);
+                    // its last frames are still handed to the consumer once they retire
+                    m_Renderer.EnqueueDeferredDeletion([oldFrameReadback]() mutable
+                                                       {
+                                                           oldFrameReadback->Flush();
+                                                           oldFrameReadback = nullptr; });
+                }
+                sp_FrameReadback = std::make_shared<FrameReadback>(m_Device, m_ThreadPool, m_Renderer.GetFramesInFlight(),
+                                                                   m_Renderer.GetRenderExtent(), m_Renderer.GetColorFormat());
+                sp_FrameReadback->SetConsumer(onFrameReadback);
+            }
+
+            if (deferredShading && sp_PendingFrameGraph == nullptr)
+            {
+                std::shared_ptr<FrameGraph> sp_DeferredGraph = buildFrameGraph(true);
+                if (m_Window.IsHeadless() || sp_DeferredGraph->IsReady())
+                {
+                    retireFrameGraph(sp_FrameGraph);
+                    sp_FrameGraph = std::move(sp_DeferredGraph);
+                    return;
+                }
+                sp_PendingFrameGraph = std::move(sp_DeferredGraph);
+            }
+
+            if (stale || sp_FrameGraph->IsDeferred())
+            {
+                retireFrameGraph(sp_FrameGraph);
+                sp_FrameGraph = buildFrameGraph(false);
+            }
+        };
+        updateFrameGraph();
+        const RenderGraph &renderGraph = sp_FrameGraph->GetRenderGraph();
+        std::cout << "\tRender graph: " << renderGraph.GetAlivePassCount() << "/" << renderGraph.GetPassCount() << " passes, "
+                  << renderGraph.GetBarrierBatchCount() << " barrier batches, "
+                  << renderGraph.GetTransientMemorySize() / 1024 << " KiB transient memory" << std::endl;
+
         Camera camera{};
         // camera.SetViewDirection({ 0.0f,0.0f,0.0f }, { 0.5f,00.1f,1.0f });
         // camera.SetViewTarget({-0.5f, -2.0f, -2.0f}, {0.0f, 0.0f, 2.5f});
 
-        auto viewerObject = DivineGameObject::CreateGameObject();
-        viewerObject.m_ModelMatrix.translation.z = -2.5f;
+        TransformComponent viewerTransform{};
+        viewerTransform.translation.z = -2.5f;
         KeyboardController cameraController{};
 
         auto currentTime = std::chrono::high_resolution_clock::now();
+        auto startTime = currentTime;
 
-        while (!m_Window.ShouldClose())
+        while (!m_Window.ShouldClose() && (m_Config.frameCount == 0 || framesRendered < m_Config.frameCount))
         {
-            glfwPollEvents();
-
+            DIVINE_PROFILE_SCOPE("Frame");
             auto newTime = std::chrono::high_resolution_clock::now();
 
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
+            if (m_Window.IsHeadless() || checkGolden)
+                frameTime = s_FixedFrameTime;
 
-            cameraController.MoveInPlaneXZ(m_Window.GetWindowHandle(), frameTime, viewerObject);
-            camera.SetViewYXZ(viewerObject.m_ModelMatrix.translation, viewerObject.m_ModelMatrix.rotation);
+            if (!m_Window.IsHeadless())
+            {
+                DIVINE_PROFILE_SCOPE("PollEvents");
+                glfwPollEvents();
+                m_Renderer.MarkInputSample();
+                cameraController.MoveInPlaneXZ(m_Window.GetWindowHandle(), frameTime, viewerTransform);
+
+                // G switches between forward and deferred shading, the graph is rebuilt below
+                bool keyDown = glfwGetKey(m_Window.GetWindowHandle(), GLFW_KEY_G) == GLFW_PRESS;
+                if (keyDown && !deferredKeyDown)
+                    deferredShading = !deferredShading;
+                deferredKeyDown = keyDown;
+            }
+            camera.SetViewYXZ(viewerTransform.translation, viewerTransform.rotation);
 
             float aspect = m_Renderer.GetAspectRatio();
             // camera.SetOrthographicProjection(-aspect, aspect, -1.0f, 1.0f, 0.0f, 1.0f);
@@ -123,34 +316,97 @@ namespace Divine
 
             if (auto commandBuffer = m_Renderer.BeginFrame()) // it may return a null pointer
             {
+                updateFrameGraph();
+
                 auto frameIndex = m_Renderer.GetFrameIndex();
+                if (sp_FrameReadback != nullptr)
+                    sp_FrameReadback->Collect(frameIndex);
                 FrameInfo frameInfo{frameIndex,
                                     frameTime,
                                     commandBuffer,
                                     camera,
                                     globalDescriptorSets[frameIndex],
-                                    m_GameObjects};
+                                    m_Registry};
 
                 // update
-                GlobalUBO ubo{};
-                ubo.Projection = camera.GetProjectionMat();
-                ubo.View = camera.GetViewMat();
-                ubo.InverseView = camera.GetInverseViewMat();
-                pointLightSystem.Update(frameInfo, ubo);
-                ubos[frameIndex]->WriteToBuffer(reinterpret_cast<const void *>(&ubo));
-                ubos[frameIndex]->Flush();
+                {
+                    DIVINE_PROFILE_SCOPE("Update");
+                    GlobalUBO ubo{};
+                    ubo.Projection = camera.GetProjectionMat();
+                    ubo.View = camera.GetViewMat();
+                    ubo.InverseView = camera.GetInverseViewMat();
+                    pointLightSystem.Update(frameInfo, lights);
+                    lightClusterSystem.Update(frameInfo, ubo, lights);
+                    transformSystem.Update(m_Registry);
+                    // the spatial index only feeds the CPU culling path
+                    if (pIndirectRenderSystem != nullptr)
+                        pIndirectRenderSystem->Update(frameInfo);
+                    else
+                        spatialSystem.Update(m_Registry);
+                    ubos[frameIndex]->WriteToBuffer(reinterpret_cast<const void *>(&ubo));
+                    ubos[frameIndex]->Flush();
+                }
 
                 // render
-                m_Renderer.BeginSwapChainRenderPass(commandBuffer);
+                {
+                    DIVINE_PROFILE_SCOPE("Record");
+                    gpuProfiler.BeginFrame(commandBuffer, frameIndex);
+
+                    // the slot's timestamps were just resolved, they steer the scale of this frame
+                    GpuScopeStats gpuFrameStats{};
+                    if (upscale && gpuProfiler.GetStats("RenderPass", gpuFrameStats))
+                        resolutionScaler.Update(gpuFrameStats.lastMs);
+                    sceneExtent = resolutionScaler.GetScaledExtent(m_Renderer.GetRenderExtent());
 
-                // render order here matters !!!!
-                renderSystem.RenderGameObjects(frameInfo);
-                pointLightSystem.Render(frameInfo);
-                m_Renderer.EndSwapChainRenderPass(commandBuffer);
+                    uint32_t renderPassScope = gpuProfiler.BeginScope(commandBuffer, "RenderPass");
+                    sp_FrameGraph->Record(frameInfo, sceneExtent, framesRendered);
+                    gpuProfiler.EndScope(commandBuffer, renderPassScope);
+                }
+
+                DIVINE_PROFILE_SCOPE("EndFrame");
                 m_Renderer.EndFrame();
+                ++framesRendered;
             }
         }
 
-        vkDeviceWaitIdle(m_Device.GetDevice());
+        // deferred deletions still reference this frame loop
+        m_Renderer.WaitIdle();
+
+        gpuProfiler.Report(std::cout);
+        resolutionScaler.Report(std::cout);
+        if (pIndirectRenderSystem != nullptr)
+            pIndirectRenderSystem->Report(std::cout);
+        else
+            renderSystem.Report(std::cout);
+        lightClusterSystem.Report(std::cout);
+        if (auto latencyMonitor = m_Renderer.GetLatencyMonitor())
+            latencyMonitor->Report(std::cout);
+        DIVINE_PROFILE_EXPORT(HOME_DIR "build/trace.json");
+
+        if (m_Window.IsHeadless() && framesRendered > 0)
+        {
+            float totalTime = std::chrono::duration<float, std::chrono::seconds::period>(
+                                  std::chrono::high_resolution_clock::now() - startTime)
+                                  .count();
+            std::cout << "\tRendered " << framesRendered << " frames in " << totalTime << " s ("
+                      << totalTime * 1000.0f / framesRendered << " ms/frame, "
+                      << framesRendered / totalTime << " fps)" << std::endl;
+        }
+
+        if (sp_FrameReadback != nullptr)
+        {
+            sp_FrameReadback->Flush();
+            if (sp_FrameReadback->GetDroppedFrameCount() > 0)
+                std::cout << "\tReadback dropped " << sp_FrameReadback->GetDroppedFrameCount() << " frames" << std::endl;
+        }
+        if (!m_Config.capturePath.empty() && !lastFrame.pixels.empty())
+        {
+            FrameReadback::WriteImage(lastFrame, m_Config.capturePath);
+            std::cout << "\tCaptured frame: " << m_Config.capturePath << std::endl;
+        }
+        if (checkGolden)
+            std::cout << "\tGolden image: " << goldenFailed << " of " << goldenChecked << " frames differ from " << m_Config.goldenPath << std::endl;
+
+        return goldenFailed == 0;
     }
 }
\ No newline at end of file
@@ -5,39 +5,77 @@
 #include "Device.hpp"
 #include "Game_Object.hpp"
 #include "Renderer.hpp"
+#include "Render_Graph.hpp"
+#include "Frame_Graph.hpp"
+#include "Resolution_Scaler.hpp"
+#include "Frame_Readback.hpp"
 #include "Render_System.hpp"
+#include "Indirect_Render_System.hpp"
 #include "PointLight_System.hpp"
+#include "Deferred_Render_System.hpp"
+#include "Light_Cluster_System.hpp"
+#include "Transform_System.hpp"
+#include "Spatial_System.hpp"
 #include "Camera.hpp"
 #include "Keyboard_Controller.hpp"
 #include "Descriptors.hpp"
+#include "Thread_Pool.hpp"
+#include "Pipeline_Compiler.hpp"
+#include "Gpu_Profiler.hpp"
+#include "Cpu_Profiler.hpp"
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 
 namespace Divine
 {
+    struct AppConfig
+    {
+        bool headless = false;
+        uint32_t frameCount = 0;  // 0 runs until the window is closed, headless defaults to 1000
+        std::string capturePath{};      // writes the last frame, run-length encoded TGA for .tga and PPM otherwise
+        uint32_t captureInterval = 0;   // writes every nth frame to captureDirectory as TGA, 0 disables
+        std::string captureDirectory{};
+        std::string goldenPath{};       // PPM every frame is compared against
+        uint8_t goldenTolerance = 2;    // per channel difference still counted as a match
+        bool cpuCulling = false;        // culls and draws on the CPU even when indirect drawing is supported
+        bool cpuLightBinning = false;   // bins the lights into their clusters on the CPU instead of a compute pass
+        bool deferred = false;          // starts with deferred shading, G toggles it at runtime
+        SwapChainConfig swapChain{};
+        ResolutionScalerConfig resolutionScaling{};
+    };
+
     class App
     {
     public:
-        App();
+        App(const AppConfig &config = AppConfig{});
         ~App();
         App(const App &) = delete;
         App &operator=(const App &) = delete;
 
-        void run();
+        // false when a frame differed from the golden image
+        bool run();
 
     public:
         const int m_Width = 800;
         const int m_Height = 600;
+        // frame time of headless and golden runs, so the animation does not depend on how fast frames render
+        static constexpr float s_FixedFrameTime = 1.0f / 60.0f;
 
     private:
         void LoadGameObjects();
 
     private:
-        Window m_Window{m_Width, m_Height, "Vulkan Warper"};
+        AppConfig m_Config;
+        Window m_Window{m_Width, m_Height, "Vulkan Warper", m_Config.headless};
         Device m_Device{m_Window};
-        Renderer m_Renderer{m_Window, m_Device};
+        Renderer m_Renderer{m_Window, m_Device, m_Config.swapChain};
+        ThreadPool m_ThreadPool{};
+        PipelineCompiler m_PipelineCompiler{m_Device, m_ThreadPool};
         std::unique_ptr<DescriptorPool> up_GlobalPool{};
-        DivineGameObject::Map m_GameObjects;
+        Registry m_Registry;
     };
 }
 
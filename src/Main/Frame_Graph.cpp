@@ -0,0 +1,289 @@
+#include "Frame_Graph.hpp"
+
+#include <thread>
+#include <assert.h>
+
+namespace Divine
+{
+    FrameGraph::FrameGraph(Device &device, Renderer &renderer, const FrameGraphSystems &systems, const FrameGraphConfig &config)
+        : r_Renderer{renderer}, m_Systems{systems}, m_Config{config}, m_RenderGraph{device}
+    {
+        ImportTargets();
+        if (m_Systems.pIndirectRenderSystem != nullptr)
+            AddCullPasses();
+        if (!m_Systems.lightClusterSystem.IsCpuBinning())
+            AddLightBinningPass();
+        if (m_Config.deferred)
+            AddDeferredScenePass();
+        else
+            AddScenePass();
+        if (m_Config.upscale)
+            AddUpscalePass();
+        if (m_Config.pFrameReadback != nullptr)
+            AddReadbackPass();
+        m_RenderGraph.MarkOutput(m_BackBuffer);
+
+        m_RenderGraph.Compile();
+        m_TargetGeneration = r_Renderer.GetTargetGeneration();
+    }
+
+    FrameGraph::~FrameGraph()
+    {
+        while (m_CompilesPipelines && !IsReady())
+            std::this_thread::yield();
+    }
+
+    void FrameGraph::CreateDeferredPipelines(PipelineCompiler &compiler)
+    {
+        assert(m_DeferredPass != nullptr && "Only deferred graphs have the deferred render pass");
+
+        VkRenderPass deferredRenderPass = m_DeferredPass->GetRenderPass();
+        if (m_Systems.pIndirectRenderSystem != nullptr)
+            m_Systems.pIndirectRenderSystem->CreateDeferredPipeline(compiler, deferredRenderPass, 0);
+        else
+            m_Systems.renderSystem.CreateDeferredPipeline(compiler, deferredRenderPass, 0);
+        m_Systems.deferredRenderSystem.CreatePipelines(compiler, deferredRenderPass, 1);
+        m_Systems.pointLightSystem.CreateDeferredPipeline(compiler, deferredRenderPass, 2);
+        m_CompilesPipelines = true;
+    }
+
+    bool FrameGraph::IsReady() const
+    {
+        if (!m_Config.deferred)
+            return true;
+
+        bool gBufferReady = m_Systems.pIndirectRenderSystem != nullptr ? m_Systems.pIndirectRenderSystem->IsDeferredPipelineReady()
+                                                                       : m_Systems.renderSystem.IsDeferredPipelineReady();
+        return gBufferReady && m_Systems.deferredRenderSystem.ArePipelinesReady() && m_Systems.pointLightSystem.IsDeferredPipelineReady();
+    }
+
+    void FrameGraph::Record(FrameInfo &frameInfo, VkExtent2D sceneExtent, uint64_t frameNumber)
+    {
+        m_FrameInfo = &frameInfo;
+        m_SceneExtent = sceneExtent;
+        m_FrameNumber = frameNumber;
+
+        m_RenderGraph.SetImportedImage(m_BackBuffer, r_Renderer.GetCurrentColorImage(), r_Renderer.GetCurrentColorImageView(),
+                                       r_Renderer.GetCurrentImageIndex());
+        if (m_Systems.pIndirectRenderSystem != nullptr)
+        {
+            m_RenderGraph.SetImportedBuffer(m_CullObjects, m_Systems.pIndirectRenderSystem->GetObjectBuffer());
+            m_RenderGraph.SetImportedBuffer(m_CullBatches, m_Systems.pIndirectRenderSystem->GetBatchBuffer());
+            m_RenderGraph.SetImportedBuffer(m_DrawCommands, m_Systems.pIndirectRenderSystem->GetCommandBuffer());
+            m_RenderGraph.SetImportedBuffer(m_DrawCounts, m_Systems.pIndirectRenderSystem->GetCountBuffer());
+        }
+        if (!m_Systems.lightClusterSystem.IsCpuBinning())
+        {
+            m_RenderGraph.SetImportedBuffer(m_ClusterCounts, m_Systems.lightClusterSystem.GetCountBuffer(frameInfo.frameIndex));
+            m_RenderGraph.SetImportedBuffer(m_ClusterIndices, m_Systems.lightClusterSystem.GetIndexBuffer(frameInfo.frameIndex));
+        }
+        // a no op unless another graph's G-buffer was bound last
+        if (m_Config.deferred)
+            m_Systems.deferredRenderSystem.SetGBuffer(m_RenderGraph.GetImageView(m_GBufferAlbedo),
+                                                      m_RenderGraph.GetImageView(m_GBufferNormal),
+                                                      m_RenderGraph.GetImageView(m_GBufferDepth));
+
+        m_RenderGraph.Execute(frameInfo.commandBuffer);
+    }
+
+    void FrameGraph::ImportTargets()
+    {
+        VkExtent2D extent = r_Renderer.GetRenderExtent();
+
+        RenderGraphImportInfo backBufferImport{};
+        backBufferImport.initialStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; /*image acquire wait stage*/
+        backBufferImport.finalLayout = r_Renderer.GetFinalColorLayout();
+        backBufferImport.imageCount = r_Renderer.GetImageCount();
+        m_BackBuffer = m_RenderGraph.ImportImage("BackBuffer", {r_Renderer.GetColorFormat(), extent}, backBufferImport);
+
+        // one depth target shared by every frame, the previous frame's depth writes are the only hazard
+        RenderGraphImportInfo depthImport{};
+        depthImport.initialStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        depthImport.initialAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        m_Depth = m_RenderGraph.ImportImage("Depth", {r_Renderer.GetDepthFormat(), extent}, depthImport);
+        m_RenderGraph.SetImportedImage(m_Depth, r_Renderer.GetDepthImage(), r_Renderer.GetDepthImageView());
+
+        // with scaling the scene goes to a full size transient and only its scaled corner is rendered
+        m_SceneColor = m_BackBuffer;
+        if (m_Config.upscale)
+            m_SceneColor = m_RenderGraph.CreateImage("SceneColor", {r_Renderer.GetColorFormat(), extent});
+    }
+
+    void FrameGraph::AddCullPasses()
+    {
+        // the buffers persist across frames, the previous frame's uploads, culling and draws are the hazards
+        RenderGraphImportInfo objectImport{};
+        objectImport.initialStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+        objectImport.initialAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        m_CullObjects = m_RenderGraph.ImportBuffer("CullObjects", {VK_WHOLE_SIZE}, objectImport);
+
+        RenderGraphImportInfo batchImport{};
+        batchImport.initialStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        batchImport.initialAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        m_CullBatches = m_RenderGraph.ImportBuffer("CullBatches", {VK_WHOLE_SIZE}, batchImport);
+
+        RenderGraphImportInfo commandImport{};
+        commandImport.initialStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        commandImport.initialAccess = VK_ACCESS_SHADER_WRITE_BIT;
+        m_DrawCommands = m_RenderGraph.ImportBuffer("DrawCommands", {VK_WHOLE_SIZE}, commandImport);
+
+        RenderGraphImportInfo countImport{};
+        countImport.initialStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        countImport.initialAccess = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        m_DrawCounts = m_RenderGraph.ImportBuffer("DrawCounts", {VK_WHOLE_SIZE}, countImport);
+
+        m_RenderGraph.AddPass("CullUpload", RenderGraphPassType::Transfer)
+            .Write(m_CullObjects, RenderGraphAccess::TransferWrite)
+            .Write(m_CullBatches, RenderGraphAccess::TransferWrite)
+            .Write(m_DrawCounts, RenderGraphAccess::TransferWrite)
+            .SetExecute([this](VkCommandBuffer)
+                        { m_Systems.pIndirectRenderSystem->RecordUpload(*m_FrameInfo); });
+
+        m_RenderGraph.AddPass("Cull", RenderGraphPassType::Compute)
+            .Read(m_CullObjects, RenderGraphAccess::ComputeStorageRead)
+            .Read(m_CullBatches, RenderGraphAccess::ComputeStorageRead)
+            .Write(m_DrawCommands, RenderGraphAccess::ComputeStorageWrite)
+            .Write(m_DrawCounts, RenderGraphAccess::ComputeStorageWrite)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            uint32_t cullScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "Cull");
+                            m_Systems.pIndirectRenderSystem->RecordCull(*m_FrameInfo);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, cullScope); });
+    }
+
+    void FrameGraph::AddLightBinningPass()
+    {
+        // every frame slot has its own lists, the previous reads of a slot retired with its fence
+        m_ClusterCounts = m_RenderGraph.ImportBuffer("ClusterCounts", {VK_WHOLE_SIZE}, RenderGraphImportInfo{});
+        m_ClusterIndices = m_RenderGraph.ImportBuffer("ClusterIndices", {VK_WHOLE_SIZE}, RenderGraphImportInfo{});
+
+        m_RenderGraph.AddPass("LightBinning", RenderGraphPassType::Compute)
+            .Write(m_ClusterCounts, RenderGraphAccess::ComputeStorageWrite)
+            .Write(m_ClusterIndices, RenderGraphAccess::ComputeStorageWrite)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            uint32_t binningScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "LightBinning");
+                            m_Systems.lightClusterSystem.RecordBinning(*m_FrameInfo);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, binningScope); });
+    }
+
+    void FrameGraph::AddDeferredScenePass()
+    {
+        VkExtent2D extent = r_Renderer.GetRenderExtent();
+
+        // the G-buffer lives and dies inside one render pass, tilers never write it to memory
+        m_GBufferAlbedo = m_RenderGraph.CreateImage("GBufferAlbedo", {VK_FORMAT_R8G8B8A8_UNORM, extent});
+        m_GBufferNormal = m_RenderGraph.CreateImage("GBufferNormal", {VK_FORMAT_R16G16B16A16_SFLOAT, extent});
+        m_GBufferDepth = m_RenderGraph.CreateImage("GBufferDepth", {r_Renderer.GetDepthFormat(), extent});
+
+        RenderGraphPass &deferredPass = m_RenderGraph.AddPass("DeferredScene", RenderGraphPassType::Graphics);
+        if (m_Systems.pIndirectRenderSystem != nullptr)
+            deferredPass.Read(m_CullObjects, RenderGraphAccess::GraphicsStorageRead)
+                .Read(m_DrawCommands, RenderGraphAccess::IndirectRead)
+                .Read(m_DrawCounts, RenderGraphAccess::IndirectRead);
+        deferredPass
+            .SetColorAttachment(m_GBufferAlbedo, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 0.0f}})
+            .SetColorAttachment(m_GBufferNormal, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 0.0f}})
+            .SetDepthAttachment(m_GBufferDepth)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            SetSceneViewport(commandBuffer);
+
+                            uint32_t gBufferScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "GBuffer");
+                            if (m_Systems.pIndirectRenderSystem != nullptr)
+                                m_Systems.pIndirectRenderSystem->Render(*m_FrameInfo, true);
+                            else
+                                m_Systems.renderSystem.RenderGameObjects(*m_FrameInfo, m_Systems.spatialSystem.GetIndex(), m_Systems.lights, true);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, gBufferScope); })
+            .NextSubpass()
+            .SetInputAttachment(m_GBufferAlbedo)
+            .SetInputAttachment(m_GBufferNormal)
+            .SetInputAttachment(m_GBufferDepth)
+            .SetColorAttachment(m_SceneColor, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.1f, 0.1f, 0.1f, 1.0f}})
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            uint32_t lightingScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "DeferredLighting");
+                            m_Systems.deferredRenderSystem.Render(*m_FrameInfo, m_Systems.lightClusterSystem.GetLightCount(m_FrameInfo->frameIndex));
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, lightingScope); })
+            .NextSubpass()
+            .SetColorAttachment(m_SceneColor)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            uint32_t pointLightsScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "PointLights");
+                            m_Systems.pointLightSystem.Render(*m_FrameInfo, true);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, pointLightsScope); });
+        m_DeferredPass = &deferredPass;
+    }
+
+    void FrameGraph::AddScenePass()
+    {
+        RenderGraphPass &scenePass = m_RenderGraph.AddPass("Scene", RenderGraphPassType::Graphics);
+        if (m_Systems.pIndirectRenderSystem != nullptr)
+            scenePass.Read(m_CullObjects, RenderGraphAccess::GraphicsStorageRead)
+                .Read(m_DrawCommands, RenderGraphAccess::IndirectRead)
+                .Read(m_DrawCounts, RenderGraphAccess::IndirectRead);
+        if (!m_Systems.lightClusterSystem.IsCpuBinning())
+            scenePass.Read(m_ClusterCounts, RenderGraphAccess::GraphicsStorageRead)
+                .Read(m_ClusterIndices, RenderGraphAccess::GraphicsStorageRead);
+        scenePass
+            .SetColorAttachment(m_SceneColor, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.1f, 0.1f, 0.1f, 1.0f}})
+            .SetDepthAttachment(m_Depth)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            SetSceneViewport(commandBuffer);
+
+                            // render order here matters !!!!
+                            uint32_t gameObjectsScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "RenderGameObjects");
+                            if (m_Systems.pIndirectRenderSystem != nullptr)
+                                m_Systems.pIndirectRenderSystem->Render(*m_FrameInfo);
+                            else
+                                m_Systems.renderSystem.RenderGameObjects(*m_FrameInfo, m_Systems.spatialSystem.GetIndex(), m_Systems.lights);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, gameObjectsScope);
+
+                            uint32_t pointLightsScope = m_Systems.gpuProfiler.BeginScope(commandBuffer, "PointLights");
+                            m_Systems.pointLightSystem.Render(*m_FrameInfo);
+                            m_Systems.gpuProfiler.EndScope(commandBuffer, pointLightsScope); });
+    }
+
+    void FrameGraph::AddUpscalePass()
+    {
+        m_RenderGraph.AddPass("Upscale", RenderGraphPassType::Transfer)
+            .Read(m_SceneColor, RenderGraphAccess::TransferRead)
+            .Write(m_BackBuffer, RenderGraphAccess::TransferWrite)
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        {
+                            VkExtent2D targetExtent = r_Renderer.GetRenderExtent();
+
+                            VkImageBlit region{};
+                            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                            region.srcOffsets[1] = {static_cast<int32_t>(m_SceneExtent.width), static_cast<int32_t>(m_SceneExtent.height), 1};
+                            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                            region.dstOffsets[1] = {static_cast<int32_t>(targetExtent.width), static_cast<int32_t>(targetExtent.height), 1};
+
+                            vkCmdBlitImage(commandBuffer,
+                                           m_RenderGraph.GetImage(m_SceneColor), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                           m_RenderGraph.GetImage(m_BackBuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                           1, &region, VK_FILTER_LINEAR); });
+    }
+
+    void FrameGraph::AddReadbackPass()
+    {
+        m_RenderGraph.AddPass("Readback", RenderGraphPassType::Transfer)
+            .Read(m_BackBuffer, RenderGraphAccess::TransferRead)
+            .SetSideEffects()
+            .SetExecute([this](VkCommandBuffer commandBuffer)
+                        { m_Config.pFrameReadback->Record(commandBuffer, m_FrameInfo->frameIndex, m_RenderGraph.GetImage(m_BackBuffer), m_FrameNumber); });
+    }
+
+    // the scaled corner of the scene, the dynamic state holds for every later subpass of the pass
+    void FrameGraph::SetSceneViewport(VkCommandBuffer commandBuffer)
+    {
+        if (!m_Config.upscale)
+            return;
+
+        VkViewport viewport{0.0f, 0.0f, static_cast<float>(m_SceneExtent.width), static_cast<float>(m_SceneExtent.height), 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, m_SceneExtent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef FRAME_GRAPH_HEADER
+#define FRAME_GRAPH_HEADER
+
+#include "Device.hpp"
+#include "Renderer.hpp"
+#include "Render_Graph.hpp"
+#include "Frame_Readback.hpp"
+#include "Render_System.hpp"
+#include "Indirect_Render_System.hpp"
+#include "PointLight_System.hpp"
+#include "Deferred_Render_System.hpp"
+#include "Light_Cluster_System.hpp"
+#include "Spatial_System.hpp"
+#include "Pipeline_Compiler.hpp"
+#include "Gpu_Profiler.hpp"
+
+#include <vector>
+
+namespace Divine
+{
+    // the systems a frame records, they outlive every frame graph
+    struct FrameGraphSystems
+    {
+        RenderSystem &renderSystem;
+        IndirectRenderSystem *pIndirectRenderSystem; // null when objects are culled on the CPU
+        PointLightSystem &pointLightSystem;
+        DeferredRenderSystem &deferredRenderSystem;
+        LightClusterSystem &lightClusterSystem;
+        SpatialSystem &spatialSystem;
+        GpuProfiler &gpuProfiler;
+        const std::vector<PointLight> &lights;
+    };
+
+    struct FrameGraphConfig
+    {
+        bool deferred = false;
+        bool upscale = false;                    // renders the scene to a scaled corner that is blitted to the back buffer
+        FrameReadback *pFrameReadback = nullptr; // copies the back buffer out every frame when set
+    };
+
+    // The render graph of one frame configuration, built against the renderer's current targets. It has
+    // to be rebuilt once the target generation changes, frames still in flight may use the old one.
+    class FrameGraph
+    {
+    public:
+        FrameGraph(Device &device, Renderer &renderer, const FrameGraphSystems &systems, const FrameGraphConfig &config);
+        // waits for pipelines still compiling against its render pass, so only drop it early when shutting down
+        ~FrameGraph();
+        FrameGraph(const FrameGraph &) = delete;
+        FrameGraph &operator=(const FrameGraph &) = delete;
+
+        inline bool IsDeferred() const { return m_Config.deferred; }
+        inline uint64_t GetTargetGeneration() const { return m_TargetGeneration; }
+        inline const RenderGraph &GetRenderGraph() const { return m_RenderGraph; }
+
+        // the deferred pipelines only need to be created once, later deferred graphs have compatible render passes.
+        // The compilation uses this graph's render pass, so the graph has to live until IsReady
+        void CreateDeferredPipelines(PipelineCompiler &compiler);
+        // whether the pipelines only this configuration records with are compiled, never blocks
+        bool IsReady() const;
+        // records the frame into frameInfo's command buffer, the scene covers sceneExtent when upscaling
+        void Record(FrameInfo &frameInfo, VkExtent2D sceneExtent, uint64_t frameNumber);
+
+    private:
+        void ImportTargets();
+        void AddCullPasses();
+        void AddLightBinningPass();
+        void AddDeferredScenePass();
+        void AddScenePass();
+        void AddUpscalePass();
+        void AddReadbackPass();
+        void SetSceneViewport(VkCommandBuffer commandBuffer);
+
+    private:
+        Renderer &r_Renderer;
+        FrameGraphSystems m_Systems;
+        FrameGraphConfig m_Config;
+        RenderGraph m_RenderGraph;
+        uint64_t m_TargetGeneration = 0;
+        RenderGraphPass *m_DeferredPass = nullptr;
+        bool m_CompilesPipelines = false;
+
+        RenderGraphResource m_BackBuffer = 0;
+        RenderGraphResource m_Depth = 0;
+        RenderGraphResource m_SceneColor = 0;
+        RenderGraphResource m_CullObjects = 0;
+        RenderGraphResource m_CullBatches = 0;
+        RenderGraphResource m_DrawCommands = 0;
+        RenderGraphResource m_DrawCounts = 0;
+        RenderGraphResource m_ClusterCounts = 0;
+        RenderGraphResource m_ClusterIndices = 0;
+        RenderGraphResource m_GBufferAlbedo = 0;
+        RenderGraphResource m_GBufferNormal = 0;
+        RenderGraphResource m_GBufferDepth = 0;
+
+        // state of the frame being recorded, read by the pass callbacks
+        FrameInfo *m_FrameInfo = nullptr;
+        VkExtent2D m_SceneExtent{};
+        uint64_t m_FrameNumber = 0;
+    };
+}
+
+#endif
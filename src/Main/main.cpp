@@ -1,16 +1,106 @@
 
 #include "App.hpp"
 
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main()
+static bool ParsePresentMode(const std::string &name, VkPresentModeKHR &presentMode)
 {
+    if (name == "fifo")
+        presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    else if (name == "fifo-relaxed")
+        presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    else if (name == "mailbox")
+        presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    else if (name == "immediate")
+        presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    else
+        return false;
+
+    return true;
+}
+
+// the whole argument has to be a number in [minValue, UINT32_MAX]
+static bool ParseCount(const char *text, uint32_t &count, uint32_t minValue = 0)
+{
+    if (*text < '0' || *text > '9')
+        return false;
+
+    char *end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > UINT32_MAX || value < minValue)
+        return false;
+
+    count = static_cast<uint32_t>(value);
+    return true;
+}
+
+static bool ParseMilliseconds(const char *text, float &milliseconds)
+{
+    char *end = nullptr;
+    errno = 0;
+    float value = std::strtof(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(value) || value < 0.0f)
+        return false;
+
+    milliseconds = value;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    DIVINE_PROFILE_THREAD("Main");
+
+    Divine::AppConfig config{};
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+            config.headless = true;
+        else if (arg == "--frames" && i + 1 < argc && ParseCount(argv[i + 1], config.frameCount))
+            ++i;
+        else if (arg == "--capture" && i + 1 < argc)
+            config.capturePath = argv[++i];
+        else if (arg == "--present-mode" && i + 1 < argc && ParsePresentMode(argv[i + 1], config.swapChain.presentMode))
+            ++i;
+        else if (arg == "--frames-in-flight" && i + 1 < argc && ParseCount(argv[i + 1], config.swapChain.framesInFlight, 1))
+            ++i;
+        else if (arg == "--capture-every" && i + 2 < argc && ParseCount(argv[i + 1], config.captureInterval, 1))
+        {
+            config.captureDirectory = argv[i + 2];
+            i += 2;
+        }
+        else if (arg == "--golden" && i + 1 < argc)
+            config.goldenPath = argv[++i];
+        else if (arg == "--target-frame-ms" && i + 1 < argc && ParseMilliseconds(argv[i + 1], config.resolutionScaling.targetFrameMs))
+            ++i;
+        else if (arg == "--cpu-culling")
+            config.cpuCulling = true;
+        else if (arg == "--cpu-light-binning")
+            config.cpuLightBinning = true;
+        else if (arg == "--deferred")
+            config.deferred = true;
+        else
+        {
+            std::cerr << "Usage: App [--headless] [--frames <count>] [--capture <file.ppm|file.tga>]\n"
+                      << "           [--capture-every <n> <directory>] [--golden <file.ppm>]\n"
+                      << "           [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--frames-in-flight <count>]\n"
+                      << "           [--target-frame-ms <ms>] [--cpu-culling] [--cpu-light-binning] [--deferred]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     try
     {
-        Divine::App app{};
-        app.run();
+        Divine::App app{config};
+        if (!app.run())
+            return EXIT_FAILURE;
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,162 @@
+#include "Batch_Transform.hpp"
+#include "Simd_Lanes.hpp"
+
+#include <cmath>
+
+namespace Divine
+{
+    static void WriteMatrices(size_t index,
+                              float sx, float sy, float sz,
+                              float tx, float ty, float tz,
+                              const float r[9],
+                              float *pModelMatrices, float *pNormalMatrices)
+    {
+        // r holds the rotation column-major
+        if (pModelMatrices != nullptr)
+        {
+            float *m = pModelMatrices + index * 16;
+            m[0] = sx * r[0], m[1] = sx * r[1], m[2] = sx * r[2], m[3] = 0.0f;
+            m[4] = sy * r[3], m[5] = sy * r[4], m[6] = sy * r[5], m[7] = 0.0f;
+            m[8] = sz * r[6], m[9] = sz * r[7], m[10] = sz * r[8], m[11] = 0.0f;
+            m[12] = tx, m[13] = ty, m[14] = tz, m[15] = 1.0f;
+        }
+        if (pNormalMatrices != nullptr)
+        {
+            float *n = pNormalMatrices + index * 16;
+            n[0] = r[0] / sx, n[1] = r[1] / sx, n[2] = r[2] / sx, n[3] = 0.0f;
+            n[4] = r[3] / sy, n[5] = r[4] / sy, n[6] = r[5] / sy, n[7] = 0.0f;
+            n[8] = r[6] / sz, n[9] = r[7] / sz, n[10] = r[8] / sz, n[11] = 0.0f;
+            n[12] = 0.0f, n[13] = 0.0f, n[14] = 0.0f, n[15] = 1.0f;
+        }
+    }
+
+    static void ComputeRange(const TransformBatch &batch, size_t first, float *pModelMatrices, float *pNormalMatrices)
+    {
+        for (size_t i = first; i < batch.count; ++i)
+        {
+            const float c3 = std::cos(batch.rotationZ[i]);
+            const float s3 = std::sin(batch.rotationZ[i]);
+            const float c2 = std::cos(batch.rotationX[i]);
+            const float s2 = std::sin(batch.rotationX[i]);
+            const float c1 = std::cos(batch.rotationY[i]);
+            const float s1 = std::sin(batch.rotationY[i]);
+
+            const float r[9] = {
+                c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1,
+                c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3,
+                c2 * s1, -s2, c1 * c2};
+
+            WriteMatrices(i,
+                          batch.scaleX[i], batch.scaleY[i], batch.scaleZ[i],
+                          batch.translationX[i], batch.translationY[i], batch.translationZ[i],
+                          r, pModelMatrices, pNormalMatrices);
+        }
+    }
+
+    void ComputeTransformsScalar(const TransformBatch &batch, float *pModelMatrices, float *pNormalMatrices)
+    {
+        ComputeRange(batch, 0, pModelMatrices, pNormalMatrices);
+    }
+
+#ifdef DIVINE_SIMD
+    // Cephes style sincos: reduce by multiples of pi/2 in three parts, evaluate both minimax
+    // polynomials on [-pi/4, pi/4] and pick and negate them by quadrant. Accurate to a few ulp
+    // for the angle ranges transforms use.
+    static inline void SinCos(SimdLanes::Float x, SimdLanes::Float &sinOut, SimdLanes::Float &cosOut)
+    {
+        using L = SimdLanes;
+        L::Int quadrant = L::Round(L::Mul(x, L::Set(0.63661977236758134f)));
+        L::Float q = L::ToFloat(quadrant);
+
+        x = L::Sub(x, L::Mul(q, L::Set(1.5703125f)));
+        x = L::Sub(x, L::Mul(q, L::Set(4.837512969970703125e-4f)));
+        x = L::Sub(x, L::Mul(q, L::Set(7.54978995489188216e-8f)));
+
+        L::Float z = L::Mul(x, x);
+
+        L::Float sinPoly = L::Set(-1.9515295891e-4f);
+        sinPoly = L::Add(L::Mul(sinPoly, z), L::Set(8.3321608736e-3f));
+        sinPoly = L::Add(L::Mul(sinPoly, z), L::Set(-1.6666654611e-1f));
+        sinPoly = L::Add(L::Mul(L::Mul(sinPoly, z), x), x);
+
+        L::Float cosPoly = L::Set(2.443315711809948e-5f);
+        cosPoly = L::Add(L::Mul(cosPoly, z), L::Set(-1.388731625493765e-3f));
+        cosPoly = L::Add(L::Mul(cosPoly, z), L::Set(4.166664568298827e-2f));
+        cosPoly = L::Add(L::Sub(L::Mul(L::Mul(cosPoly, z), z), L::Mul(L::Set(0.5f), z)), L::Set(1.0f));
+
+        L::Float swap = L::BitSet(quadrant, 1);
+        L::Float s = L::Select(swap, cosPoly, sinPoly);
+        L::Float c = L::Select(swap, sinPoly, cosPoly);
+
+        L::Float zero = L::Set(0.0f);
+        sinOut = L::Select(L::BitSet(quadrant, 2), L::Sub(zero, s), s);
+        cosOut = L::Select(L::BitSet(L::AddInt(quadrant, 1), 2), L::Sub(zero, c), c);
+    }
+
+    void ComputeTransforms(const TransformBatch &batch, float *pModelMatrices, float *pNormalMatrices)
+    {
+        using L = SimdLanes;
+        constexpr size_t W = L::s_Width;
+
+        size_t i = 0;
+        for (; i + W <= batch.count; i += W)
+        {
+            L::Float s1, c1, s2, c2, s3, c3;
+            SinCos(L::Load(batch.rotationY + i), s1, c1);
+            SinCos(L::Load(batch.rotationX + i), s2, c2);
+            SinCos(L::Load(batch.rotationZ + i), s3, c3);
+
+            L::Float s1s2 = L::Mul(s1, s2);
+            L::Float c1s2 = L::Mul(c1, s2);
+
+            // rotation column-major, one register per entry
+            L::Float r[9] = {
+                L::Add(L::Mul(c1, c3), L::Mul(s1s2, s3)),
+                L::Mul(c2, s3),
+                L::Sub(L::Mul(c1s2, s3), L::Mul(c3, s1)),
+                L::Sub(L::Mul(c3, s1s2), L::Mul(c1, s3)),
+                L::Mul(c2, c3),
+                L::Add(L::Mul(c1s2, c3), L::Mul(s1, s3)),
+                L::Mul(c2, s1),
+                L::Sub(L::Set(0.0f), s2),
+                L::Mul(c1, c2)};
+
+            // transpose through the stack, the matrices are written per object
+            alignas(32) float lanes[9][W];
+            for (size_t k = 0; k < 9; ++k)
+                L::Store(lanes[k], r[k]);
+
+            for (size_t lane = 0; lane < W; ++lane)
+            {
+                const float rotation[9] = {
+                    lanes[0][lane], lanes[1][lane], lanes[2][lane],
+                    lanes[3][lane], lanes[4][lane], lanes[5][lane],
+                    lanes[6][lane], lanes[7][lane], lanes[8][lane]};
+                size_t index = i + lane;
+
+                WriteMatrices(index,
+                              batch.scaleX[index], batch.scaleY[index], batch.scaleZ[index],
+                              batch.translationX[index], batch.translationY[index], batch.translationZ[index],
+                              rotation, pModelMatrices, pNormalMatrices);
+            }
+        }
+
+        ComputeRange(batch, i, pModelMatrices, pNormalMatrices);
+    }
+
+    const char *GetTransformKernelName()
+    {
+        return SimdLanes::s_Name;
+    }
+#else
+    void ComputeTransforms(const TransformBatch &batch, float *pModelMatrices, float *pNormalMatrices)
+    {
+        ComputeRange(batch, 0, pModelMatrices, pNormalMatrices);
+    }
+
+    const char *GetTransformKernelName()
+    {
+        return "Scalar";
+    }
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef BATCH_TRANSFORM_HEADER
+#define BATCH_TRANSFORM_HEADER
+
+#include <cstddef>
+
+namespace Divine
+{
+    // Structure of arrays input, rotations are Tait-Bryan radians like TransformComponent
+    struct TransformBatch
+    {
+        const float *translationX;
+        const float *translationY;
+        const float *translationZ;
+        const float *rotationX;
+        const float *rotationY;
+        const float *rotationZ;
+        const float *scaleX;
+        const float *scaleY;
+        const float *scaleZ;
+        size_t count;
+    };
+
+    // Writes count column-major 4x4 model matrices, Translate * Ry * Rx * Rz * Scale, and their normal
+    // matrices padded to 4x4, both contiguous and ready to be copied into a buffer. Either output may be null.
+    // Uses AVX2 (8 lanes), SSE2 or NEON (4 lanes) when compiled in, the tail goes through the scalar path.
+    void ComputeTransforms(const TransformBatch &batch, float *pModelMatrices, float *pNormalMatrices);
+    // reference implementation, same formulas as TransformComponent::GetModelMat and GetNormalMat
+    void ComputeTransformsScalar(const TransformBatch &batch, float *pModelMatrices, float *pNormalMatrices);
+    const char *GetTransformKernelName();
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "Frustum_Cull.hpp"
+#include "Simd_Lanes.hpp"
+
+#include <cmath>
+
+namespace Divine
+{
+    static uint32_t CullRange(const float *pPlanes, const SphereBatch &batch, size_t first, uint32_t visibleCount, uint32_t *pVisibleIndices)
+    {
+        for (size_t i = first; i < batch.count; ++i)
+        {
+            bool visible = true;
+            for (int plane = 0; plane < 6 && visible; ++plane)
+            {
+                const float *p = pPlanes + plane * 4;
+                float distance = p[0] * batch.centerX[i] + p[1] * batch.centerY[i] + p[2] * batch.centerZ[i] + p[3];
+                visible = distance >= -batch.radius[i];
+            }
+            if (visible)
+                pVisibleIndices[visibleCount++] = static_cast<uint32_t>(i);
+        }
+        return visibleCount;
+    }
+
+    uint32_t CullSpheresScalar(const float *pPlanes, const SphereBatch &batch, uint32_t *pVisibleIndices)
+    {
+        return CullRange(pPlanes, batch, 0, 0, pVisibleIndices);
+    }
+
+#ifdef DIVINE_SIMD
+    uint32_t CullSpheres(const float *pPlanes, const SphereBatch &batch, uint32_t *pVisibleIndices)
+    {
+        using L = SimdLanes;
+        constexpr size_t W = L::s_Width;
+
+        L::Float planes[6][4];
+        for (int plane = 0; plane < 6; ++plane)
+            for (int k = 0; k < 4; ++k)
+                planes[plane][k] = L::Set(pPlanes[plane * 4 + k]);
+
+        uint32_t visibleCount = 0;
+        size_t i = 0;
+        for (; i + W <= batch.count; i += W)
+        {
+            L::Float x = L::Load(batch.centerX + i);
+            L::Float y = L::Load(batch.centerY + i);
+            L::Float z = L::Load(batch.centerZ + i);
+            L::Float negativeRadius = L::Sub(L::Set(0.0f), L::Load(batch.radius + i));
+
+            L::Float inside = L::GreaterEqual(x, L::Set(-INFINITY)); // all ones unless the center is NaN
+            for (int plane = 0; plane < 6; ++plane)
+            {
+                // summed in the order of the scalar path, so both keep exactly the same spheres
+                L::Float distance = L::Add(L::Add(L::Add(L::Mul(planes[plane][0], x), L::Mul(planes[plane][1], y)),
+                                                  L::Mul(planes[plane][2], z)),
+                                           planes[plane][3]);
+                inside = L::And(inside, L::GreaterEqual(distance, negativeRadius));
+            }
+
+            // off-screen groups end here with an empty mask
+            uint32_t mask = L::MoveMask(inside);
+            for (size_t lane = 0; mask != 0; ++lane, mask >>= 1)
+                if (mask & 1)
+                    pVisibleIndices[visibleCount++] = static_cast<uint32_t>(i + lane);
+        }
+
+        return CullRange(pPlanes, batch, i, visibleCount, pVisibleIndices);
+    }
+#else
+    uint32_t CullSpheres(const float *pPlanes, const SphereBatch &batch, uint32_t *pVisibleIndices)
+    {
+        return CullRange(pPlanes, batch, 0, 0, pVisibleIndices);
+    }
+#endif
+}
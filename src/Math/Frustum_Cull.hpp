@@ -0,0 +1,27 @@
+#ifndef FRUSTUM_CULL_HEADER
+#define FRUSTUM_CULL_HEADER
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Divine
+{
+    // Structure of arrays world space spheres
+    struct SphereBatch
+    {
+        const float *centerX;
+        const float *centerY;
+        const float *centerZ;
+        const float *radius;
+        size_t count;
+    };
+
+    // pPlanes holds six (normal, distance) planes with normalized normals pointing into the frustum.
+    // A sphere is kept unless it lies completely behind one plane, so a few spheres near the corners
+    // pass although they are outside, which is conservative. Writes the indices of the kept spheres in
+    // ascending order and returns how many there are, pVisibleIndices needs room for batch.count.
+    uint32_t CullSpheres(const float *pPlanes, const SphereBatch &batch, uint32_t *pVisibleIndices);
+    uint32_t CullSpheresScalar(const float *pPlanes, const SphereBatch &batch, uint32_t *pVisibleIndices);
+}
+
+#endif
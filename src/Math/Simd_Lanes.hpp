@@ -0,0 +1,137 @@
+#ifndef SIMD_LANES_HEADER
+#define SIMD_LANES_HEADER
+
+#include <cstddef>
+#include <cstdint>
+
+// Picks the widest float vector the build targets and wraps it in SimdLanes, the batch kernels are
+// written once against these operations. DIVINE_SIMD is left undefined when only the scalar paths exist.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DIVINE_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIVINE_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DIVINE_SIMD_NEON
+#endif
+
+#if defined(DIVINE_SIMD_AVX2) || defined(DIVINE_SIMD_SSE2) || defined(DIVINE_SIMD_NEON)
+#define DIVINE_SIMD
+#endif
+
+namespace Divine
+{
+#if defined(DIVINE_SIMD_AVX2)
+    struct SimdLanes
+    {
+        using Float = __m256;
+        using Int = __m256i;
+        static constexpr size_t s_Width = 8;
+        static constexpr const char *s_Name = "AVX2";
+
+        static inline Float Load(const float *p) { return _mm256_loadu_ps(p); }
+        static inline void Store(float *p, Float v) { _mm256_storeu_ps(p, v); }
+        static inline Float Set(float v) { return _mm256_set1_ps(v); }
+        static inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static inline Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static inline Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static inline Int Round(Float v) { return _mm256_cvtps_epi32(v); }
+        static inline Float ToFloat(Int v) { return _mm256_cvtepi32_ps(v); }
+        static inline Int AddInt(Int a, int b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+        static inline Float BitSet(Int v, int bit) // all ones where the bit is set
+        {
+            Int mask = _mm256_set1_epi32(bit);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(v, mask), mask));
+        }
+        static inline Float GreaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static inline Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+        static inline Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        static inline uint32_t MoveMask(Float mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+    };
+#elif defined(DIVINE_SIMD_SSE2)
+    struct SimdLanes
+    {
+        using Float = __m128;
+        using Int = __m128i;
+        static constexpr size_t s_Width = 4;
+        static constexpr const char *s_Name = "SSE2";
+
+        static inline Float Load(const float *p) { return _mm_loadu_ps(p); }
+        static inline void Store(float *p, Float v) { _mm_storeu_ps(p, v); }
+        static inline Float Set(float v) { return _mm_set1_ps(v); }
+        static inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static inline Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static inline Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static inline Int Round(Float v) { return _mm_cvtps_epi32(v); }
+        static inline Float ToFloat(Int v) { return _mm_cvtepi32_ps(v); }
+        static inline Int AddInt(Int a, int b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+        static inline Float BitSet(Int v, int bit)
+        {
+            Int mask = _mm_set1_epi32(bit);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(v, mask), mask));
+        }
+        static inline Float GreaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static inline Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+        static inline Float Select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static inline uint32_t MoveMask(Float mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+    };
+#elif defined(DIVINE_SIMD_NEON)
+    struct SimdLanes
+    {
+        using Float = float32x4_t;
+        using Int = int32x4_t;
+        static constexpr size_t s_Width = 4;
+        static constexpr const char *s_Name = "NEON";
+
+        static inline Float Load(const float *p) { return vld1q_f32(p); }
+        static inline void Store(float *p, Float v) { vst1q_f32(p, v); }
+        static inline Float Set(float v) { return vdupq_n_f32(v); }
+        static inline Float Add(Float a, Float b) { return vaddq_f32(a, b); }
+        static inline Float Sub(Float a, Float b) { return vsubq_f32(a, b); }
+        static inline Float Mul(Float a, Float b) { return vmulq_f32(a, b); }
+        static inline Float Div(Float a, Float b)
+        {
+            // two Newton steps on the estimate are enough for float precision
+            float32x4_t inverse = vrecpeq_f32(b);
+            inverse = vmulq_f32(vrecpsq_f32(b, inverse), inverse);
+            inverse = vmulq_f32(vrecpsq_f32(b, inverse), inverse);
+            return vmulq_f32(a, inverse);
+        }
+        static inline Float Min(Float a, Float b) { return vminq_f32(a, b); }
+        static inline Float Max(Float a, Float b) { return vmaxq_f32(a, b); }
+        static inline Int Round(Float v)
+        {
+            // round half away from zero, the quadrant only has to be consistent with the reduction
+            float32x4_t half = vbslq_f32(vcltq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+            return vcvtq_s32_f32(vaddq_f32(v, half));
+        }
+        static inline Float ToFloat(Int v) { return vcvtq_f32_s32(v); }
+        static inline Int AddInt(Int a, int b) { return vaddq_s32(a, vdupq_n_s32(b)); }
+        static inline Float BitSet(Int v, int bit)
+        {
+            int32x4_t mask = vdupq_n_s32(bit);
+            return vreinterpretq_f32_u32(vceqq_s32(vandq_s32(v, mask), mask));
+        }
+        static inline Float GreaterEqual(Float a, Float b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+        static inline Float And(Float a, Float b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+        static inline Float Select(Float mask, Float a, Float b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+        static inline uint32_t MoveMask(Float mask)
+        {
+            static const uint32_t s_Bits[4] = {1, 2, 4, 8};
+            uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(s_Bits));
+            uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+            return vget_lane_u32(vpadd_u32(sum, sum), 0);
+        }
+    };
+#endif
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "Sphere_Overlap.hpp"
+#include "Simd_Lanes.hpp"
+
+#include <algorithm>
+
+namespace Divine
+{
+    static uint32_t OverlapRange(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, size_t first, uint32_t count, uint32_t *pIndices, uint32_t maxCount)
+    {
+        for (size_t i = first; i < batch.count && count <= maxCount; ++i)
+        {
+            // distance from the center to the box, zero along the axes the center lies within
+            const float center[3] = {batch.centerX[i], batch.centerY[i], batch.centerZ[i]};
+            float distanceSquared = 0.0f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float distance = std::max(pBoxMin[axis] - center[axis], 0.0f) + std::max(center[axis] - pBoxMax[axis], 0.0f);
+                distanceSquared += distance * distance;
+            }
+
+            if (distanceSquared <= batch.radius[i] * batch.radius[i])
+            {
+                if (count < maxCount)
+                    pIndices[count] = static_cast<uint32_t>(i);
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    uint32_t OverlapSpheresBoxScalar(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, uint32_t *pIndices, uint32_t maxCount)
+    {
+        return OverlapRange(batch, pBoxMin, pBoxMax, 0, 0, pIndices, maxCount);
+    }
+
+#ifdef DIVINE_SIMD
+    uint32_t OverlapSpheresBox(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, uint32_t *pIndices, uint32_t maxCount)
+    {
+        using L = SimdLanes;
+        constexpr size_t W = L::s_Width;
+
+        const L::Float zero = L::Set(0.0f);
+        const L::Float minX = L::Set(pBoxMin[0]), minY = L::Set(pBoxMin[1]), minZ = L::Set(pBoxMin[2]);
+        const L::Float maxX = L::Set(pBoxMax[0]), maxY = L::Set(pBoxMax[1]), maxZ = L::Set(pBoxMax[2]);
+
+        uint32_t count = 0;
+        size_t i = 0;
+        for (; i + W <= batch.count && count <= maxCount; i += W)
+        {
+            L::Float x = L::Load(batch.centerX + i);
+            L::Float y = L::Load(batch.centerY + i);
+            L::Float z = L::Load(batch.centerZ + i);
+            L::Float radius = L::Load(batch.radius + i);
+
+            // x86 max returns its second operand when either is NaN, so a NaN center stays NaN and misses like on the scalar path
+            L::Float dx = L::Add(L::Max(zero, L::Sub(minX, x)), L::Max(zero, L::Sub(x, maxX)));
+            L::Float dy = L::Add(L::Max(zero, L::Sub(minY, y)), L::Max(zero, L::Sub(y, maxY)));
+            L::Float dz = L::Add(L::Max(zero, L::Sub(minZ, z)), L::Max(zero, L::Sub(z, maxZ)));
+            L::Float distanceSquared = L::Add(L::Add(L::Mul(dx, dx), L::Mul(dy, dy)), L::Mul(dz, dz));
+
+            // most groups of a small box end here with an empty mask
+            uint32_t mask = L::MoveMask(L::GreaterEqual(L::Mul(radius, radius), distanceSquared));
+            for (size_t lane = 0; mask != 0; ++lane, mask >>= 1)
+            {
+                if (mask & 1)
+                {
+                    if (count < maxCount)
+                        pIndices[count] = static_cast<uint32_t>(i + lane);
+                    ++count;
+                }
+            }
+        }
+
+        return OverlapRange(batch, pBoxMin, pBoxMax, i, count, pIndices, maxCount);
+    }
+#else
+    uint32_t OverlapSpheresBox(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, uint32_t *pIndices, uint32_t maxCount)
+    {
+        return OverlapRange(batch, pBoxMin, pBoxMax, 0, 0, pIndices, maxCount);
+    }
+#endif
+}
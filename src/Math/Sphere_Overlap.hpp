@@ -0,0 +1,18 @@
+#ifndef SPHERE_OVERLAP_HEADER
+#define SPHERE_OVERLAP_HEADER
+
+#include "Frustum_Cull.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Divine
+{
+    // Writes the indices of the spheres that overlap the axis aligned box [pBoxMin, pBoxMax] in ascending
+    // order, at most maxCount of them, and returns how many were found. The scan stops once more than
+    // maxCount overlap, so a result above maxCount only tells the box overflowed.
+    uint32_t OverlapSpheresBox(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, uint32_t *pIndices, uint32_t maxCount);
+    uint32_t OverlapSpheresBoxScalar(const SphereBatch &batch, const float *pBoxMin, const float *pBoxMax, uint32_t *pIndices, uint32_t maxCount);
+}
+
+#endif
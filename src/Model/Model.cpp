@@ -1,9 +1,11 @@
 #include "Model.hpp"
+#include "Cpu_Profiler.hpp"
 #include "utils.hpp"
 
 #include <assert.h>
 #include <string.h>
 
+#include <atomic>
 #include <iostream>
 #include <unordered_map>
 
@@ -55,6 +57,7 @@ namespace Divine
 
     void Model::Builder::LoadModelFromFile(const std::string &FilePath)
     {
+        DIVINE_PROFILE_FUNCTION();
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
@@ -110,16 +113,51 @@ namespace Divine
                 indices.push_back(uniqueVertices[vertex]);
             }
         }
+
+        ComputeBounds();
     }
 
+    void Model::Builder::ComputeBounds()
+    {
+        if (vertices.empty())
+        {
+            boundingBox = BoundingBox{};
+            boundingSphere = BoundingSphere{};
+            return;
+        }
+
+        boundingBox.min = vertices[0].position;
+        boundingBox.max = vertices[0].position;
+        for (const auto &vertex : vertices)
+        {
+            boundingBox.min = glm::min(boundingBox.min, vertex.position);
+            boundingBox.max = glm::max(boundingBox.max, vertex.position);
+        }
+
+        // the farthest vertex from the box center is tighter than half the diagonal
+        boundingSphere.center = (boundingBox.min + boundingBox.max) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const auto &vertex : vertices)
+        {
+            glm::vec3 offset = vertex.position - boundingSphere.center;
+            radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundingSphere.radius = glm::sqrt(radiusSquared);
+    }
+
+    static std::atomic<uint32_t> s_NextModelId{0};
+
     Model::Model(Device &device, const Builder &builder)
-        : r_Device{device}
+        : r_Device{device}, m_Id{s_NextModelId++}, m_BoundingBox{builder.boundingBox}, m_BoundingSphere{builder.boundingSphere}
     {
         CreateVertexBuffers(builder.vertices);
         CreateIndexBuffers(builder.indices);
     }
 
-    Model::~Model() {}
+    Model::~Model()
+    {
+        FinishUploads();
+    }
 
     void Model::CreateVertexBuffers(const std::vector<Vertex> &vertices)
     {
@@ -130,14 +168,14 @@ namespace Divine
         uint32_t vertexSize = sizeof(Vertex);
         VkDeviceSize bufferSize = vertexSize * m_VertexCount;
 
-        Buffer stagingBuffer(r_Device,
-                             vertexSize,
-                             m_VertexCount,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        auto stagingBuffer = std::make_unique<Buffer>(r_Device,
+                                                      vertexSize,
+                                                      m_VertexCount,
+                                                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        stagingBuffer.Map();
-        stagingBuffer.WriteToBuffer(reinterpret_cast<const void *>(vertices.data()));
+        stagingBuffer->Map();
+        stagingBuffer->WriteToBuffer(reinterpret_cast<const void *>(vertices.data()));
 
         up_VertexBuffer = std::make_unique<Buffer>(r_Device,
                                                    vertexSize,
@@ -145,7 +183,8 @@ namespace Divine
                                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        r_Device.CopyBuffer(stagingBuffer.GetBuffer(), up_VertexBuffer->GetBuffer(), bufferSize);
+        m_PendingUploads.push_back(r_Device.CopyBufferAsync(stagingBuffer->GetBuffer(), up_VertexBuffer->GetBuffer(), bufferSize));
+        m_StagingBuffers.push_back(std::move(stagingBuffer));
     }
 
     void Model::CreateIndexBuffers(const std::vector<uint32_t> &indices)
@@ -160,14 +199,14 @@ namespace Divine
         VkDeviceSize indexSize = sizeof(uint32_t);
         VkDeviceSize bufferSize = indexSize * m_IndexCount;
 
-        Buffer stagingBuffer(r_Device,
-                             indexSize,
-                             m_IndexCount,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        auto stagingBuffer = std::make_unique<Buffer>(r_Device,
+                                                      indexSize,
+                                                      m_IndexCount,
+                                                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        stagingBuffer.Map();
-        stagingBuffer.WriteToBuffer(reinterpret_cast<const void *>(indices.data()));
+        stagingBuffer->Map();
+        stagingBuffer->WriteToBuffer(reinterpret_cast<const void *>(indices.data()));
 
         up_IndexBuffer = std::make_unique<Buffer>(r_Device,
                                                   indexSize,
@@ -175,11 +214,25 @@ namespace Divine
                                                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        r_Device.CopyBuffer(stagingBuffer.GetBuffer(), up_IndexBuffer->GetBuffer(), bufferSize);
+        m_PendingUploads.push_back(r_Device.CopyBufferAsync(stagingBuffer->GetBuffer(), up_IndexBuffer->GetBuffer(), bufferSize));
+        m_StagingBuffers.push_back(std::move(stagingBuffer));
+    }
+
+    void Model::FinishUploads()
+    {
+        for (const auto &token : m_PendingUploads)
+            r_Device.WaitForSubmission(token);
+
+        m_PendingUploads.clear();
+        m_StagingBuffers.clear();
     }
 
     void Model::Bind(VkCommandBuffer commandBuffer)
     {
+        // the copies were submitted at load time and have almost always retired by the first draw
+        if (!m_PendingUploads.empty())
+            FinishUploads();
+
         VkBuffer buffers[] = {up_VertexBuffer->GetBuffer()};
         VkDeviceSize offsets[] = {0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -190,16 +243,38 @@ namespace Divine
         }
     }
 
-    void Model::Draw(VkCommandBuffer commandBuffer)
+    void Model::Bind(CommandRecorder &recorder)
+    {
+        if (!m_PendingUploads.empty())
+            FinishUploads();
+
+        VkBuffer buffers[] = {up_VertexBuffer->GetBuffer()};
+        VkDeviceSize offsets[] = {0};
+        recorder.BindVertexBuffers(0, 1, buffers, offsets);
+
+        if (m_HasIndexBuffer)
+            recorder.BindIndexBuffer(up_IndexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    void Model::Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
+    {
+        if (m_HasIndexBuffer)
+            vkCmdDrawIndexed(commandBuffer, m_IndexCount, instanceCount, 0, 0, firstInstance);
+        else
+            vkCmdDraw(commandBuffer, m_VertexCount, instanceCount, 0, firstInstance);
+    }
+
+    void Model::Draw(CommandRecorder &recorder, uint32_t instanceCount, uint32_t firstInstance)
     {
         if (m_HasIndexBuffer)
-            vkCmdDrawIndexed(commandBuffer, m_IndexCount, 1, 0, 0, 0);
+            recorder.DrawIndexed(m_IndexCount, instanceCount, 0, 0, firstInstance);
         else
-            vkCmdDraw(commandBuffer, m_VertexCount, 1, 0, 0);
+            recorder.Draw(m_VertexCount, instanceCount, 0, firstInstance);
     }
 
     std::unique_ptr<Model> Model::CreateModelFromFile(Device &device, const std::string &FilePath)
     {
+        DIVINE_PROFILE_FUNCTION();
         Builder builder{};
         builder.LoadModelFromFile(FilePath);
         std::cout << "\tVertex count: " << builder.vertices.size() << std::endl;
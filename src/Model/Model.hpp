@@ -3,6 +3,7 @@
 
 #include "Device.hpp"
 #include "Buffer.hpp"
+#include "Command_Recorder.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -35,12 +36,29 @@ namespace Divine
             }
         };
 
+        // object space bounds, the sphere is centered on the box
+        struct BoundingBox
+        {
+            glm::vec3 min{0.0f};
+            glm::vec3 max{0.0f};
+        };
+
+        struct BoundingSphere
+        {
+            glm::vec3 center{0.0f};
+            float radius = 0.0f;
+        };
+
         struct Builder
         {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            BoundingBox boundingBox{};
+            BoundingSphere boundingSphere{};
 
             void LoadModelFromFile(const std::string &FilePath);
+            // called by LoadModelFromFile, builders filled by hand call it once the vertices are in
+            void ComputeBounds();
         };
 
     public:
@@ -50,16 +68,28 @@ namespace Divine
         Model &operator=(const Model &) = delete;
 
         void Bind(VkCommandBuffer commandBuffer);
-        void Draw(VkCommandBuffer commandBuffer);
+        void Bind(CommandRecorder &recorder);
+        // instances come from vertex buffers bound by the caller, firstInstance is their offset there
+        void Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+        void Draw(CommandRecorder &recorder, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+        // unique per model for the process lifetime, used in draw sort keys
+        inline uint32_t GetId() const { return m_Id; }
+        inline bool HasIndexBuffer() const { return m_HasIndexBuffer; }
+        inline uint32_t GetIndexCount() const { return m_IndexCount; }
+        inline const BoundingBox &GetBoundingBox() const { return m_BoundingBox; }
+        inline const BoundingSphere &GetBoundingSphere() const { return m_BoundingSphere; }
 
         static std::unique_ptr<Model> CreateModelFromFile(Device &device, const std::string &FilePath);
 
     private:
         void CreateVertexBuffers(const std::vector<Vertex> &vertices);
         void CreateIndexBuffers(const std::vector<uint32_t> &indices);
+        void FinishUploads();
 
     private:
         Device &r_Device;
+        uint32_t m_Id;
 
         std::unique_ptr<Buffer> up_VertexBuffer{};
         uint32_t m_VertexCount;
@@ -67,6 +97,13 @@ namespace Divine
         bool m_HasIndexBuffer = false;
         std::unique_ptr<Buffer> up_IndexBuffer{};
         uint32_t m_IndexCount;
+
+        BoundingBox m_BoundingBox;
+        BoundingSphere m_BoundingSphere;
+
+        // staging buffers stay alive until their copies retire, checked lazily on first Bind
+        std::vector<SubmitToken> m_PendingUploads{};
+        std::vector<std::unique_ptr<Buffer>> m_StagingBuffers{};
     };
 
 }
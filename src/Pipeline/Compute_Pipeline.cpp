@@ -0,0 +1,63 @@
+#include "Compute_Pipeline.hpp"
+#include "Pipeline.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <stdexcept>
+#include <assert.h>
+
+namespace Divine
+{
+    ComputePipeline::ComputePipeline(
+        Device &device,
+        const std::string &compFilePath,
+        VkPipelineLayout pipelineLayout,
+        const VkSpecializationInfo *pSpecializationInfo)
+        : r_Device{device}
+    {
+        DIVINE_PROFILE_FUNCTION();
+        assert(pipelineLayout != VK_NULL_HANDLE && "Can't create compute pipeline without pipeline layout");
+
+        auto compCode = Pipeline::ReadFile(compFilePath);
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = compCode.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(compCode.data());
+
+        if (vkCreateShaderModule(r_Device.GetDevice(), &moduleInfo, nullptr, &m_CompShaderModule) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create shader module!");
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = m_CompShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = pSpecializationInfo;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(
+                r_Device.GetDevice(),
+                r_Device.GetPipelineCache(),
+                1,
+                &pipelineInfo,
+                nullptr,
+                &m_ComputePipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create compute pipeline!");
+        }
+    }
+
+    ComputePipeline::~ComputePipeline()
+    {
+        vkDestroyPipeline(r_Device.GetDevice(), m_ComputePipeline, nullptr);
+        vkDestroyShaderModule(r_Device.GetDevice(), m_CompShaderModule, nullptr);
+    }
+
+    void ComputePipeline::Bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipeline);
+    }
+}
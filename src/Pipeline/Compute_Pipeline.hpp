@@ -0,0 +1,35 @@
+#ifndef COMPUTE_PIPELINE_HEADER
+#define COMPUTE_PIPELINE_HEADER
+
+#include "Device.hpp"
+
+#include <string>
+
+namespace Divine
+{
+    // Compute counterpart of Pipeline, the layout stays owned by the caller like for graphics pipelines.
+    // Compute shaders are small, so they are compiled synchronously through the device's pipeline cache.
+    class ComputePipeline
+    {
+    public:
+        ComputePipeline(
+            Device &device,
+            const std::string &compFilePath,
+            VkPipelineLayout pipelineLayout,
+            const VkSpecializationInfo *pSpecializationInfo = nullptr);
+        ~ComputePipeline();
+        ComputePipeline(const ComputePipeline &) = delete;
+        ComputePipeline &operator=(const ComputePipeline &) = delete;
+
+        void Bind(VkCommandBuffer commandBuffer);
+        // enough groups of groupSize invocations to cover count items
+        static inline uint32_t GetGroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+
+    private:
+        Device &r_Device;
+        VkShaderModule m_CompShaderModule = VK_NULL_HANDLE;
+        VkPipeline m_ComputePipeline = VK_NULL_HANDLE;
+    };
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include "Pipeline.hpp"
+#include "Cpu_Profiler.hpp"
 #include "Model.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <assert.h>
 
@@ -30,6 +32,7 @@ namespace Divine
         const std::string &fragFilePath,
         const PipelineConfigInfo &configInfo)
     {
+        DIVINE_PROFILE_FUNCTION();
         assert(
             configInfo.pipelineLayout != VK_NULL_HANDLE &&
             "Can't create graphics pipeline: no pipelineLayout provided in configInfo");
@@ -96,9 +99,23 @@ namespace Divine
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+        // ask the driver whether the pipeline cache satisfied this creation
+        VkPipelineCreationFeedbackEXT pipelineFeedback{};
+        std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(pipelineInfo.stageCount);
+        VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+        bool feedbackEnabled = r_Device.IsExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+        if (feedbackEnabled)
+        {
+            feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+            feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+            feedbackInfo.pipelineStageCreationFeedbackCount = pipelineInfo.stageCount;
+            feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+            pipelineInfo.pNext = &feedbackInfo;
+        }
+
         if (vkCreateGraphicsPipelines(
                 r_Device.GetDevice(),
-                VK_NULL_HANDLE,
+                r_Device.GetPipelineCache(),
                 1,
                 &pipelineInfo,
                 nullptr,
@@ -106,6 +123,17 @@ namespace Divine
         {
             throw std::runtime_error("Failed to create graphics pipeline!");
         }
+
+        if (feedbackEnabled && (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+        {
+            bool cacheHit = pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+            // pipelines are created on pool threads, one write keeps the lines whole
+            std::ostringstream report;
+            report << "\tPipeline cache " << (cacheHit ? "hit" : "miss")
+                   << " (" << pipelineFeedback.duration / 1000000.0 << " ms): "
+                   << vertFilePath.substr(vertFilePath.find_last_of("/\\") + 1) << "\n";
+            std::cout << report.str() << std::flush;
+        }
     }
 
     std::vector<char> Pipeline::ReadFile(const std::string &filePath)
@@ -142,6 +170,11 @@ namespace Divine
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
     }
 
+    void Pipeline::Bind(CommandRecorder &recorder)
+    {
+        recorder.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+    }
+
     void Pipeline::DefaultPipelineConfigInfo(PipelineConfigInfo &configInfo)
     {
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -241,4 +274,11 @@ namespace Divine
         configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
 
+    void Pipeline::SetColorAttachmentCount(PipelineConfigInfo &configInfo, uint32_t count)
+    {
+        configInfo.colorBlendAttachments.assign(count, configInfo.colorBlendAttachment);
+        configInfo.colorBlendInfo.attachmentCount = count;
+        configInfo.colorBlendInfo.pAttachments = configInfo.colorBlendAttachments.data();
+    }
+
 }
@@ -2,6 +2,7 @@
 #define PIPELINE_HEADER
 
 #include "Device.hpp"
+#include "Command_Recorder.hpp"
 
 #include <string>
 #include <vector>
@@ -24,6 +25,7 @@ namespace Divine
         VkPipelineRasterizationStateCreateInfo rasterizationInfo;
         VkPipelineMultisampleStateCreateInfo multisampleInfo;
         VkPipelineColorBlendAttachmentState colorBlendAttachment;
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{}; // see SetColorAttachmentCount
         VkPipelineColorBlendStateCreateInfo colorBlendInfo;
         VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
         std::vector<VkDynamicState> dynamicStatesEnables;
@@ -46,9 +48,13 @@ namespace Divine
         Pipeline &operator=(const Pipeline &) = delete;
 
         void Bind(VkCommandBuffer commandBuffer);
+        void Bind(CommandRecorder &recorder);
 
         static void DefaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
         static void EnableAlphaBlending(PipelineConfigInfo &configInfo);
+        // subpasses writing several color attachments, every one blends like colorBlendAttachment
+        static void SetColorAttachmentCount(PipelineConfigInfo &configInfo, uint32_t count);
+        static std::vector<char> ReadFile(const std::string &filePath);
 
     private:
         void CreateGraphicsPipeline(
@@ -58,9 +64,6 @@ namespace Divine
 
         void CreateShaderModule(const std::vector<char> &code, VkShaderModule *pModule);
 
-    private:
-        static std::vector<char> ReadFile(const std::string &filePath);
-
     private:
         Device &r_Device;
         VkShaderModule m_VertShaderModule;
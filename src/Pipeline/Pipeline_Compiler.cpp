@@ -0,0 +1,64 @@
+#include "Pipeline_Compiler.hpp"
+
+#include <chrono>
+#include <utility>
+
+namespace Divine
+{
+    // *************** Async Pipeline *********************
+
+    AsyncPipeline::AsyncPipeline(std::future<std::unique_ptr<Pipeline>> pending)
+        : m_Pending{std::move(pending)}
+    {
+    }
+
+    AsyncPipeline::~AsyncPipeline()
+    {
+        if (m_Pending.valid())
+            m_Pending.wait();
+    }
+
+    bool AsyncPipeline::IsReady() const
+    {
+        return up_Pipeline != nullptr || m_Pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void AsyncPipeline::Bind(VkCommandBuffer commandBuffer)
+    {
+        GetPipeline().Bind(commandBuffer);
+    }
+
+    void AsyncPipeline::Bind(CommandRecorder &recorder)
+    {
+        GetPipeline().Bind(recorder);
+    }
+
+    Pipeline &AsyncPipeline::GetPipeline()
+    {
+        // rethrows whatever the worker threw while compiling
+        if (up_Pipeline == nullptr)
+            up_Pipeline = m_Pending.get();
+
+        return *up_Pipeline;
+    }
+
+    // *************** Pipeline Compiler *********************
+
+    PipelineCompiler::PipelineCompiler(Device &device, ThreadPool &threadPool)
+        : r_Device{device}, r_ThreadPool{threadPool}
+    {
+    }
+
+    std::unique_ptr<AsyncPipeline> PipelineCompiler::CompileAsync(PipelineRequest request)
+    {
+        auto sharedRequest = std::make_shared<PipelineRequest>(std::move(request));
+        Device &device = r_Device;
+
+        return std::make_unique<AsyncPipeline>(r_ThreadPool.Submit([sharedRequest, &device]()
+                                                                   { return std::make_unique<Pipeline>(
+                                                                         device,
+                                                                         sharedRequest->vertFilePath,
+                                                                         sharedRequest->fragFilePath,
+                                                                         *sharedRequest->up_ConfigInfo); }));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef PIPELINE_COMPILER_HEADER
+#define PIPELINE_COMPILER_HEADER
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "Thread_Pool.hpp"
+
+#include <future>
+#include <memory>
+#include <string>
+
+namespace Divine
+{
+    struct PipelineRequest
+    {
+        std::string vertFilePath;
+        std::string fragFilePath;
+        // PipelineConfigInfo is self-referencing and not copyable, the request owns it until compilation ends
+        std::unique_ptr<PipelineConfigInfo> up_ConfigInfo = std::make_unique<PipelineConfigInfo>();
+    };
+
+    // A pipeline compiled on the thread pool. Callers check IsReady and draw something else meanwhile,
+    // a Bind before that waits for the compilation.
+    class AsyncPipeline
+    {
+    public:
+        AsyncPipeline(std::future<std::unique_ptr<Pipeline>> pending);
+        // waits for a compilation still running, owners reset it before destroying the pipeline layout
+        ~AsyncPipeline();
+        AsyncPipeline(const AsyncPipeline &) = delete;
+        AsyncPipeline &operator=(const AsyncPipeline &) = delete;
+
+        // never blocks
+        bool IsReady() const;
+        void Bind(VkCommandBuffer commandBuffer);
+        void Bind(CommandRecorder &recorder);
+
+    private:
+        Pipeline &GetPipeline();
+
+    private:
+        std::future<std::unique_ptr<Pipeline>> m_Pending;
+        std::unique_ptr<Pipeline> up_Pipeline;
+    };
+
+    class PipelineCompiler
+    {
+    public:
+        PipelineCompiler(Device &device, ThreadPool &threadPool);
+        PipelineCompiler(const PipelineCompiler &) = delete;
+        PipelineCompiler &operator=(const PipelineCompiler &) = delete;
+
+        // starts compiling on the thread pool, requests submitted back to back are built in parallel
+        std::unique_ptr<AsyncPipeline> CompileAsync(PipelineRequest request);
+
+    private:
+        Device &r_Device;
+        ThreadPool &r_ThreadPool;
+    };
+}
+
+#endif
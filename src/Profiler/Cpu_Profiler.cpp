@@ -0,0 +1,97 @@
+#include "Cpu_Profiler.hpp"
+
+#ifdef DIVINE_ENABLE_PROFILING
+
+#include <fstream>
+#include <iostream>
+
+namespace Divine
+{
+    const std::chrono::steady_clock::time_point CpuProfiler::s_Epoch = std::chrono::steady_clock::now();
+    std::mutex CpuProfiler::s_RegistryMutex;
+    std::vector<std::shared_ptr<CpuProfiler::ThreadRing>> CpuProfiler::s_Rings;
+
+    CpuProfiler::ThreadRing &CpuProfiler::GetThreadRing()
+    {
+        // the registry keeps the ring alive after its thread exits so the events can still be exported
+        thread_local ThreadRing *tp_Ring = nullptr;
+        if (tp_Ring == nullptr)
+        {
+            auto ring = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(s_RegistryMutex);
+            ring->threadID = static_cast<uint32_t>(s_Rings.size());
+            ring->threadName = "Thread " + std::to_string(ring->threadID); // DIVINE_PROFILE_THREAD renames it
+            s_Rings.push_back(ring);
+            tp_Ring = ring.get();
+        }
+
+        return *tp_Ring;
+    }
+
+    void CpuProfiler::SetThreadName(const std::string &name)
+    {
+        ThreadRing &ring = GetThreadRing();
+        std::lock_guard<std::mutex> lock(s_RegistryMutex);
+        ring.threadName = name;
+    }
+
+    static void WriteJsonString(std::ofstream &ofs, const std::string &str)
+    {
+        ofs << '"';
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+                ofs << '\\';
+            ofs << c;
+        }
+        ofs << '"';
+    }
+
+    bool CpuProfiler::WriteChromeTrace(const std::string &filePath)
+    {
+        std::ofstream ofs(filePath);
+        if (!ofs.is_open())
+        {
+            std::cerr << "Failed to open file: " << filePath << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(s_RegistryMutex);
+
+        ofs << "{\"traceEvents\":[";
+        bool first = true;
+        size_t eventCount = 0;
+        for (const auto &ring : s_Rings)
+        {
+            ofs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->threadID
+                << ",\"args\":{\"name\":";
+            WriteJsonString(ofs, ring->threadName);
+            ofs << "}}";
+            first = false;
+
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t begin = head > s_RingCapacity ? head - s_RingCapacity : 0;
+            for (uint64_t i = begin; i < head; ++i)
+            {
+                CpuZoneEvent event = ring->events[i % s_RingCapacity];
+
+                // the owner may have lapped the reader while exporting, skip slots it is overwriting
+                if (ring->head.load(std::memory_order_acquire) - i >= s_RingCapacity)
+                    continue;
+
+                ofs << ",\n{\"name\":";
+                WriteJsonString(ofs, event.name);
+                ofs << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->threadID
+                    << ",\"ts\":" << event.startNs / 1000.0
+                    << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+                ++eventCount;
+            }
+        }
+        ofs << "\n]}\n";
+
+        std::cout << "\tCPU trace: " << eventCount << " zones written to " << filePath << std::endl;
+        return ofs.good();
+    }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef CPU_PROFILER_HEADER
+#define CPU_PROFILER_HEADER
+
+// Everything below compiles to nothing unless the build defines DIVINE_ENABLE_PROFILING
+// (cmake -DDIVINE_ENABLE_PROFILING=ON).
+#ifdef DIVINE_ENABLE_PROFILING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Divine
+{
+    struct CpuZoneEvent
+    {
+        const char *name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    class CpuProfiler
+    {
+    public:
+        static constexpr size_t s_RingCapacity = 1 << 16;
+
+        // single producer (the owning thread), the exporter only reads
+        struct ThreadRing
+        {
+            std::array<CpuZoneEvent, s_RingCapacity> events;
+            std::atomic<uint64_t> head{0};
+            uint32_t threadID = 0;
+            std::string threadName{};
+        };
+
+        static inline uint64_t Now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now() - s_Epoch)
+                                             .count());
+        }
+
+        static inline void Record(const char *name, uint64_t startNs, uint64_t endNs)
+        {
+            ThreadRing &ring = GetThreadRing();
+            uint64_t index = ring.head.load(std::memory_order_relaxed);
+            ring.events[index % s_RingCapacity] = CpuZoneEvent{name, startNs, endNs};
+            ring.head.store(index + 1, std::memory_order_release);
+        }
+
+        static void SetThreadName(const std::string &name);
+        // writes every event still held by the rings as Chrome trace_event JSON
+        static bool WriteChromeTrace(const std::string &filePath);
+
+    private:
+        static ThreadRing &GetThreadRing();
+
+    private:
+        static const std::chrono::steady_clock::time_point s_Epoch;
+        static std::mutex s_RegistryMutex;
+        static std::vector<std::shared_ptr<ThreadRing>> s_Rings;
+    };
+
+    class CpuProfileScope
+    {
+    public:
+        CpuProfileScope(const char *name)
+            : m_Name{name}, m_Start{CpuProfiler::Now()} {}
+        ~CpuProfileScope() { CpuProfiler::Record(m_Name, m_Start, CpuProfiler::Now()); }
+        CpuProfileScope(const CpuProfileScope &) = delete;
+        CpuProfileScope &operator=(const CpuProfileScope &) = delete;
+
+    private:
+        const char *m_Name;
+        uint64_t m_Start;
+    };
+}
+
+#define DIVINE_PROFILE_CONCAT_INNER(a, b) a##b
+#define DIVINE_PROFILE_CONCAT(a, b) DIVINE_PROFILE_CONCAT_INNER(a, b)
+#define DIVINE_PROFILE_SCOPE(name) ::Divine::CpuProfileScope DIVINE_PROFILE_CONCAT(profileScope, __LINE__){name}
+#define DIVINE_PROFILE_FUNCTION() DIVINE_PROFILE_SCOPE(__func__)
+#define DIVINE_PROFILE_THREAD(name) ::Divine::CpuProfiler::SetThreadName(name)
+#define DIVINE_PROFILE_EXPORT(filePath) ::Divine::CpuProfiler::WriteChromeTrace(filePath)
+
+#else
+
+#define DIVINE_PROFILE_SCOPE(name)
+#define DIVINE_PROFILE_FUNCTION()
+#define DIVINE_PROFILE_THREAD(name)
+#define DIVINE_PROFILE_EXPORT(filePath)
+
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+#include "Gpu_Profiler.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <assert.h>
+
+namespace Divine
+{
+    GpuProfiler::GpuProfiler(Device &device, uint32_t framesInFlight, uint32_t maxScopes, uint32_t historySize)
+        : r_Device{device}, m_MaxScopes{maxScopes}, m_HistorySize{historySize}
+    {
+        m_TimestampPeriod = r_Device.m_DeviceProperties.limits.timestampPeriod;
+
+        uint32_t queueCount;
+        vkGetPhysicalDeviceQueueFamilyProperties(r_Device.GetPhysicalDevice(), &queueCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(r_Device.GetPhysicalDevice(), &queueCount, queueFamilies.data());
+        m_TimestampValidBits = queueFamilies[r_Device.GetQueueFamilyIndices().graphicsFamily].timestampValidBits;
+
+        if (!IsSupported())
+        {
+            std::cerr << "\tGPU profiler: graphics queue has no timestamp support" << std::endl;
+            return;
+        }
+
+        m_QueryPools.resize(framesInFlight);
+        m_FrameScopes.resize(framesInFlight);
+        m_QueryResults.resize(m_MaxScopes * 2);
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = m_MaxScopes * 2;
+
+        for (auto &pool : m_QueryPools)
+        {
+            if (vkCreateQueryPool(r_Device.GetDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create timestamp query pool!");
+        }
+    }
+
+    GpuProfiler::~GpuProfiler()
+    {
+        for (auto pool : m_QueryPools)
+            vkDestroyQueryPool(r_Device.GetDevice(), pool, nullptr);
+    }
+
+    void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+    {
+        if (!IsSupported())
+            return;
+
+        m_CurrentFrame = frameIndex;
+        CollectResults(frameIndex);
+
+        vkCmdResetQueryPool(commandBuffer, m_QueryPools[frameIndex], 0, m_MaxScopes * 2);
+    }
+
+    uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char *name)
+    {
+        if (!IsSupported())
+            return UINT32_MAX;
+
+        auto &scopes = m_FrameScopes[m_CurrentFrame];
+        if (scopes.size() >= m_MaxScopes)
+            return UINT32_MAX;
+
+        uint32_t scope = static_cast<uint32_t>(scopes.size());
+        scopes.push_back({name, scope * 2});
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPools[m_CurrentFrame], scope * 2);
+
+        return scope;
+    }
+
+    void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+    {
+        if (scope == UINT32_MAX)
+            return;
+
+        assert(scope < m_FrameScopes[m_CurrentFrame].size() && "Ending a scope that was never begun");
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPools[m_CurrentFrame], scope * 2 + 1);
+    }
+
+    void GpuProfiler::CollectResults(uint32_t frameIndex)
+    {
+        auto &scopes = m_FrameScopes[frameIndex];
+        if (scopes.empty())
+            return;
+
+        uint32_t queryCount = static_cast<uint32_t>(scopes.size()) * 2;
+
+        // no WAIT flag: the frame's fence has signaled, anything still unavailable is dropped
+        VkResult result = vkGetQueryPoolResults(
+            r_Device.GetDevice(),
+            m_QueryPools[frameIndex],
+            0,
+            queryCount,
+            queryCount * sizeof(uint64_t),
+            m_QueryResults.data(),
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS)
+        {
+            const uint64_t mask = m_TimestampValidBits >= 64 ? ~0ull : ((1ull << m_TimestampValidBits) - 1);
+            for (const auto &scope : scopes)
+            {
+                uint64_t begin = m_QueryResults[scope.firstQuery] & mask;
+                uint64_t end = m_QueryResults[scope.firstQuery + 1] & mask;
+                float ms = static_cast<float>(((end - begin) & mask) * m_TimestampPeriod / 1000000.0);
+
+                auto it = m_History.find(scope.name);
+                if (it == m_History.end())
+                {
+                    it = m_History.emplace(scope.name, SampleHistory{m_HistorySize}).first;
+                    m_ScopeOrder.push_back(scope.name);
+                }
+                it->second.Add(ms);
+            }
+        }
+
+        scopes.clear();
+    }
+
+    bool GpuProfiler::GetStats(const std::string &name, GpuScopeStats &stats) const
+    {
+        auto it = m_History.find(name);
+        return it != m_History.end() && it->second.GetStats(stats);
+    }
+
+    void GpuProfiler::Report(std::ostream &os) const
+    {
+        os << "\tGPU timings (min / avg / p99 ms):" << std::endl;
+        for (const auto &name : m_ScopeOrder)
+        {
+            GpuScopeStats stats{};
+            if (!GetStats(name, stats))
+                continue;
+
+            os << "\t  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(3)
+               << stats.minMs << " / " << stats.avgMs << " / " << stats.p99Ms
+               << "  (" << stats.sampleCount << " samples)" << std::endl;
+        }
+        os.unsetf(std::ios::fixed);
+    }
+}
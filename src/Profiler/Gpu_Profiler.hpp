@@ -0,0 +1,61 @@
+#ifndef GPU_PROFILER_HEADER
+#define GPU_PROFILER_HEADER
+
+#include "Device.hpp"
+#include "Sample_History.hpp"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Divine
+{
+    using GpuScopeStats = TimingStats;
+
+    // Timestamp queries per frame in flight. Results of a frame slot are read back in BeginFrame,
+    // after the renderer has already waited on that slot's fence, so reading never stalls.
+    class GpuProfiler
+    {
+    public:
+        GpuProfiler(Device &device, uint32_t framesInFlight, uint32_t maxScopes = 32, uint32_t historySize = 256);
+        ~GpuProfiler();
+        GpuProfiler(const GpuProfiler &) = delete;
+        GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+        inline bool IsSupported() const { return m_TimestampValidBits > 0; }
+
+        // must be recorded outside of a render pass, before any scope of the frame
+        void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        // scope names must outlive the profiler, string literals are expected
+        uint32_t BeginScope(VkCommandBuffer commandBuffer, const char *name);
+        void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+        bool GetStats(const std::string &name, GpuScopeStats &stats) const;
+        void Report(std::ostream &os) const;
+
+    private:
+        struct FrameScope
+        {
+            const char *name;
+            uint32_t firstQuery;
+        };
+
+        void CollectResults(uint32_t frameIndex);
+
+    private:
+        Device &r_Device;
+        uint32_t m_MaxScopes;
+        uint32_t m_HistorySize;
+        uint32_t m_TimestampValidBits = 0;
+        float m_TimestampPeriod;
+        uint32_t m_CurrentFrame = 0;
+        std::vector<VkQueryPool> m_QueryPools;
+        std::vector<std::vector<FrameScope>> m_FrameScopes;
+        std::vector<uint64_t> m_QueryResults;
+        std::unordered_map<std::string, SampleHistory> m_History;
+        std::vector<std::string> m_ScopeOrder;
+    };
+}
+
+#endif
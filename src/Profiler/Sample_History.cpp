@@ -0,0 +1,48 @@
+#include "Sample_History.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+namespace Divine
+{
+    SampleHistory::SampleHistory(uint32_t capacity)
+        : m_Capacity{capacity}
+    {
+        assert(capacity > 0 && "Sample history needs room for at least one sample!");
+        m_Samples.reserve(capacity);
+    }
+
+    void SampleHistory::Add(float ms)
+    {
+        if (m_Samples.size() < m_Capacity)
+            m_Samples.push_back(ms);
+        else
+            m_Samples[m_Next] = ms;
+        m_Next = (m_Next + 1) % m_Capacity;
+        m_Last = ms;
+    }
+
+    bool SampleHistory::GetStats(TimingStats &stats) const
+    {
+        if (m_Samples.empty())
+            return false;
+
+        std::vector<float> sorted = m_Samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        float sum = 0.0f;
+        for (float sample : sorted)
+            sum += sample;
+
+        size_t p99Index = static_cast<size_t>(std::ceil(0.99 * sorted.size())) - 1;
+
+        stats.minMs = sorted.front();
+        stats.avgMs = sum / sorted.size();
+        stats.p99Ms = sorted[std::min(p99Index, sorted.size() - 1)];
+        stats.lastMs = m_Last;
+        stats.sampleCount = static_cast<uint32_t>(sorted.size());
+
+        return true;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef SAMPLE_HISTORY_HEADER
+#define SAMPLE_HISTORY_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Divine
+{
+    struct TimingStats
+    {
+        float minMs = 0.0f;
+        float avgMs = 0.0f;
+        float p99Ms = 0.0f;
+        float lastMs = 0.0f;
+        uint32_t sampleCount = 0;
+    };
+
+    // rolling window of the last capacity samples, in milliseconds
+    class SampleHistory
+    {
+    public:
+        SampleHistory(uint32_t capacity = 256);
+
+        void Add(float ms);
+        // false while there are no samples
+        bool GetStats(TimingStats &stats) const;
+
+    private:
+        uint32_t m_Capacity;
+        std::vector<float> m_Samples;
+        size_t m_Next = 0;
+        float m_Last = 0.0f;
+    };
+}
+
+#endif
@@ -0,0 +1,1095 @@
+#include "Render_Graph.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <map>
+#include <assert.h>
+
+namespace Divine
+{
+    struct AccessInfo
+    {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        bool write;
+        bool attachment;
+        VkImageUsageFlags imageUsage;
+        VkBufferUsageFlags bufferUsage;
+    };
+
+    static const VkAccessFlags s_WriteAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                   VK_ACCESS_SHADER_WRITE_BIT |
+                                                   VK_ACCESS_TRANSFER_WRITE_BIT |
+                                                   VK_ACCESS_HOST_WRITE_BIT |
+                                                   VK_ACCESS_MEMORY_WRITE_BIT;
+
+    static AccessInfo GetAccessInfo(RenderGraphAccess access)
+    {
+        switch (access)
+        {
+        case RenderGraphAccess::ColorAttachment:
+            return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0};
+        case RenderGraphAccess::DepthAttachment:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0};
+        case RenderGraphAccess::DepthAttachmentRead:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, true,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0};
+        case RenderGraphAccess::FragmentSampled:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false,
+                    VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT};
+        case RenderGraphAccess::GraphicsStorageRead:
+            return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, false, false,
+                    VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+        case RenderGraphAccess::ComputeSampled:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false,
+                    VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT};
+        case RenderGraphAccess::ComputeStorageRead:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, false, false,
+                    VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+        case RenderGraphAccess::ComputeStorageWrite:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, true, false,
+                    VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+        case RenderGraphAccess::IndirectRead:
+            return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, false, false,
+                    0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT};
+        case RenderGraphAccess::VertexRead:
+            return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, false, false,
+                    0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT};
+        case RenderGraphAccess::TransferRead:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+        case RenderGraphAccess::TransferWrite:
+        default:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT};
+        }
+    }
+
+    static bool IsDepthFormat(VkFormat format)
+    {
+        return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 ||
+               format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D16_UNORM_S8_UINT ||
+               format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+
+    static VkImageAspectFlags GetBarrierAspectMask(VkFormat format)
+    {
+        if (!IsDepthFormat(format))
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+
+        bool hasStencil = format == VK_FORMAT_D16_UNORM_S8_UINT ||
+                          format == VK_FORMAT_D24_UNORM_S8_UINT ||
+                          format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+        return VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+    }
+
+    static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    RenderGraphPass &RenderGraphPass::Read(RenderGraphResource resource, RenderGraphAccess access)
+    {
+        assert(!GetAccessInfo(access).write &&
+               "Read was given a writing access");
+
+        m_Uses.push_back(Use{resource, access});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::Write(RenderGraphResource resource, RenderGraphAccess access)
+    {
+        assert(GetAccessInfo(access).write &&
+               "Write was given a read only access");
+
+        m_Uses.push_back(Use{resource, access});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::SetColorAttachment(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clearValue)
+    {
+        assert(m_Type == RenderGraphPassType::Graphics &&
+               "Attachments are only available to graphics passes");
+
+        m_Subpasses.back().colorAttachments.push_back(resource);
+        for (const auto &attachment : m_ColorAttachments)
+        {
+            if (attachment.resource == resource)
+                return *this; // an earlier subpass already declared it
+        }
+
+        Attachment attachment{};
+        attachment.resource = resource;
+        attachment.loadOp = loadOp;
+        attachment.clearValue.color = clearValue;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_ColorAttachments.push_back(attachment);
+
+        m_Uses.push_back(Use{resource, RenderGraphAccess::ColorAttachment});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::SetDepthAttachment(RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clearValue, bool readOnly)
+    {
+        assert(m_Type == RenderGraphPassType::Graphics &&
+               "Attachments are only available to graphics passes");
+        assert(!m_HasDepthAttachment &&
+               "A pass has at most one depth attachment");
+
+        m_DepthAttachment.resource = resource;
+        m_DepthAttachment.loadOp = loadOp;
+        m_DepthAttachment.clearValue.depthStencil = clearValue;
+        m_DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_HasDepthAttachment = true;
+
+        m_Uses.push_back(Use{resource, readOnly ? RenderGraphAccess::DepthAttachmentRead : RenderGraphAccess::DepthAttachment});
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::NextSubpass()
+    {
+        assert(m_Type == RenderGraphPassType::Graphics &&
+               "Subpasses are only available to graphics passes");
+
+        m_Subpasses.emplace_back();
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::SetInputAttachment(RenderGraphResource resource)
+    {
+        assert(m_Type == RenderGraphPassType::Graphics && m_Subpasses.size() > 1 &&
+               "Input attachments are written by an earlier subpass of the same pass");
+
+        // the subpass dependency orders it after the write, the graph only sees the attachment use
+        m_Subpasses.back().inputAttachments.push_back(resource);
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::SetSideEffects()
+    {
+        m_SideEffects = true;
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::SetExecute(ExecuteFunction execute)
+    {
+        m_Subpasses.back().execute = std::move(execute);
+        return *this;
+    }
+
+    RenderGraph::RenderGraph(Device &device)
+        : r_Device{device}
+    {
+    }
+
+    RenderGraph::~RenderGraph()
+    {
+        Destroy();
+    }
+
+    RenderGraphResource RenderGraph::ImportImage(const std::string &name, const RenderGraphImageInfo &info, const RenderGraphImportInfo &importInfo)
+    {
+        assert(!m_Compiled && "Can't add resources to a compiled render graph");
+
+        Resource resource{};
+        resource.name = name;
+        resource.isImage = true;
+        resource.imported = true;
+        resource.imageInfo = info;
+        resource.importInfo = importInfo;
+        m_Resources.push_back(resource);
+
+        return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+    }
+
+    RenderGraphResource RenderGraph::ImportBuffer(const std::string &name, const RenderGraphBufferInfo &info, const RenderGraphImportInfo &importInfo)
+    {
+        assert(!m_Compiled && "Can't add resources to a compiled render graph");
+
+        Resource resource{};
+        resource.name = name;
+        resource.isImage = false;
+        resource.imported = true;
+        resource.size = info.size;
+        resource.importInfo = importInfo;
+        m_Resources.push_back(resource);
+
+        return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+    }
+
+    RenderGraphResource RenderGraph::CreateImage(const std::string &name, const RenderGraphImageInfo &info)
+    {
+        assert(!m_Compiled && "Can't add resources to a compiled render graph");
+
+        Resource resource{};
+        resource.name = name;
+        resource.isImage = true;
+        resource.imported = false;
+        resource.imageInfo = info;
+        m_Resources.push_back(resource);
+
+        return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+    }
+
+    RenderGraphResource RenderGraph::CreateBuffer(const std::string &name, const RenderGraphBufferInfo &info)
+    {
+        assert(!m_Compiled && "Can't add resources to a compiled render graph");
+
+        Resource resource{};
+        resource.name = name;
+        resource.isImage = false;
+        resource.imported = false;
+        resource.size = info.size;
+        m_Resources.push_back(resource);
+
+        return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+    }
+
+    RenderGraphPass &RenderGraph::AddPass(const std::string &name, RenderGraphPassType type)
+    {
+        assert(!m_Compiled && "Can't add passes to a compiled render graph");
+
+        m_Passes.push_back(std::make_unique<RenderGraphPass>(name, type));
+        return *m_Passes.back();
+    }
+
+    void RenderGraph::MarkOutput(RenderGraphResource resource)
+    {
+        m_Resources[resource].output = true;
+    }
+
+    void RenderGraph::Compile()
+    {
+        assert(!m_Compiled && "Render graph is already compiled");
+
+        CullPasses();
+        ComputeLifetimes();
+        CreateTransientResources();
+        ComputeBarriers();
+        CreateRenderPasses();
+        m_Compiled = true;
+
+        m_BarrierBatchCount = m_FinalBarriers.srcStages != 0 ? 1 : 0;
+        for (const auto &pass : m_Passes)
+        {
+            if (pass->m_Culled)
+                continue;
+            ++m_AlivePassCount;
+            if (pass->m_Barriers.srcStages != 0)
+                ++m_BarrierBatchCount;
+        }
+    }
+
+    void RenderGraph::CullPasses()
+    {
+        std::vector<bool> needed(m_Resources.size(), false);
+        for (size_t i = 0; i < m_Resources.size(); ++i)
+            needed[i] = m_Resources[i].output;
+
+        // walk backwards from the outputs, a pass survives when something later consumes one of its writes
+        for (size_t i = m_Passes.size(); i-- > 0;)
+        {
+            RenderGraphPass &pass = *m_Passes[i];
+
+            bool alive = pass.m_SideEffects;
+            for (const auto &use : pass.m_Uses)
+                alive = alive || (GetAccessInfo(use.access).write && needed[use.resource]);
+
+            pass.m_Culled = !alive;
+            if (!alive)
+                continue;
+
+            // cleared attachments are fully overwritten, earlier writers no longer matter for them
+            for (const auto &attachment : pass.m_ColorAttachments)
+            {
+                if (attachment.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD)
+                    needed[attachment.resource] = false;
+            }
+            if (pass.m_HasDepthAttachment && pass.m_DepthAttachment.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD)
+                needed[pass.m_DepthAttachment.resource] = false;
+
+            for (const auto &use : pass.m_Uses)
+            {
+                if (!GetAccessInfo(use.access).write)
+                    needed[use.resource] = true;
+            }
+            for (const auto &attachment : pass.m_ColorAttachments)
+            {
+                if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+                    needed[attachment.resource] = true;
+            }
+            if (pass.m_HasDepthAttachment && pass.m_DepthAttachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+                needed[pass.m_DepthAttachment.resource] = true;
+        }
+    }
+
+    void RenderGraph::ComputeLifetimes()
+    {
+        for (uint32_t i = 0; i < m_Passes.size(); ++i)
+        {
+            if (m_Passes[i]->m_Culled)
+                continue;
+
+            for (const auto &use : m_Passes[i]->m_Uses)
+            {
+                Resource &resource = m_Resources[use.resource];
+                AccessInfo info = GetAccessInfo(use.access);
+
+                resource.firstPass = std::min(resource.firstPass, i);
+                resource.lastPass = std::max(resource.lastPass, i);
+                resource.imageUsage |= info.imageUsage;
+                resource.bufferUsage |= info.bufferUsage;
+                resource.attachmentOnly = resource.attachmentOnly && info.attachment;
+            }
+            for (const auto &subpass : m_Passes[i]->m_Subpasses)
+            {
+                for (RenderGraphResource input : subpass.inputAttachments)
+                    m_Resources[input].imageUsage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+            }
+        }
+    }
+
+    void RenderGraph::CreateTransientResources()
+    {
+        std::vector<MemoryPlacement> placements;
+
+        for (uint32_t i = 0; i < m_Resources.size(); ++i)
+        {
+            Resource &resource = m_Resources[i];
+            if (resource.imported || resource.firstPass == UINT32_MAX)
+                continue;
+
+            MemoryPlacement placement{};
+            placement.resource = i;
+
+            if (resource.isImage)
+            {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.extent.width = resource.imageInfo.extent.width;
+                imageInfo.extent.height = resource.imageInfo.extent.height;
+                imageInfo.extent.depth = 1;
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.format = resource.imageInfo.format;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage = resource.imageUsage | (resource.attachmentOnly ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+                if (vkCreateImage(r_Device.GetDevice(), &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to create image!");
+                vkGetImageMemoryRequirements(r_Device.GetDevice(), resource.image, &placement.requirements);
+
+                // attachments that never leave tile memory get lazily allocated memory of their own where it exists
+                uint32_t lazyMemoryType;
+                if (resource.attachmentOnly &&
+                    r_Device.TryFindMemoryTypeIndex(placement.requirements.memoryTypeBits,
+                                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                                    lazyMemoryType))
+                {
+                    VkMemoryAllocateInfo allocInfo{};
+                    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                    allocInfo.allocationSize = placement.requirements.size;
+                    allocInfo.memoryTypeIndex = lazyMemoryType;
+
+                    if (vkAllocateMemory(r_Device.GetDevice(), &allocInfo, nullptr, &resource.dedicatedMemory) != VK_SUCCESS)
+                        throw std::runtime_error("Failed to allocate image memory!");
+                    if (vkBindImageMemory(r_Device.GetDevice(), resource.image, resource.dedicatedMemory, 0) != VK_SUCCESS)
+                        throw std::runtime_error("Failed to bind image memory!");
+                    continue;
+                }
+            }
+            else
+            {
+                VkBufferCreateInfo bufferInfo{};
+                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferInfo.size = resource.size;
+                bufferInfo.usage = resource.bufferUsage;
+                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+                if (vkCreateBuffer(r_Device.GetDevice(), &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to create buffer!");
+                vkGetBufferMemoryRequirements(r_Device.GetDevice(), resource.buffer, &placement.requirements);
+            }
+
+            placement.memoryTypeIndex = r_Device.FindMemoryTypeIndex(placement.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            placements.push_back(placement);
+        }
+
+        AllocateTransientMemory(placements);
+
+        for (auto &resource : m_Resources)
+        {
+            if (resource.imported || !resource.isImage || resource.image == VK_NULL_HANDLE)
+                continue;
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.imageInfo.format;
+            viewInfo.subresourceRange.aspectMask = IsDepthFormat(resource.imageInfo.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(r_Device.GetDevice(), &viewInfo, nullptr, &resource.imageView) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create iamge view!");
+        }
+    }
+
+    void RenderGraph::AllocateTransientMemory(std::vector<MemoryPlacement> &placements)
+    {
+        auto lifetimesOverlap = [this](const MemoryPlacement &a, const MemoryPlacement &b)
+        {
+            const Resource &ra = m_Resources[a.resource];
+            const Resource &rb = m_Resources[b.resource];
+            return !(ra.lastPass < rb.firstPass || rb.lastPass < ra.firstPass);
+        };
+        auto rangesOverlap = [](const MemoryPlacement &a, const MemoryPlacement &b)
+        {
+            return a.offset < b.offset + b.requirements.size && b.offset < a.offset + a.requirements.size;
+        };
+
+        // largest first, every resource takes the lowest offset not used by a resource alive at the same time
+        std::sort(placements.begin(), placements.end(), [](const MemoryPlacement &a, const MemoryPlacement &b)
+                  { return a.requirements.size > b.requirements.size; });
+
+        VkDeviceSize granularity = r_Device.m_DeviceProperties.limits.bufferImageGranularity;
+        std::map<uint32_t, VkDeviceSize> heapSizes;
+        for (size_t i = 0; i < placements.size(); ++i)
+        {
+            MemoryPlacement &placement = placements[i];
+            VkDeviceSize alignment = std::max(placement.requirements.alignment, granularity);
+            placement.offset = 0;
+
+            bool moved = true;
+            while (moved)
+            {
+                moved = false;
+                for (size_t j = 0; j < i; ++j)
+                {
+                    const MemoryPlacement &other = placements[j];
+                    if (other.memoryTypeIndex == placement.memoryTypeIndex &&
+                        lifetimesOverlap(placement, other) &&
+                        rangesOverlap(placement, other))
+                    {
+                        placement.offset = AlignUp(other.offset + other.requirements.size, alignment);
+                        moved = true;
+                    }
+                }
+            }
+
+            heapSizes[placement.memoryTypeIndex] = std::max(heapSizes[placement.memoryTypeIndex],
+                                                            placement.offset + placement.requirements.size);
+        }
+
+        std::map<uint32_t, VkDeviceMemory> heaps;
+        for (const auto &heapSize : heapSizes)
+        {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = heapSize.second;
+            allocInfo.memoryTypeIndex = heapSize.first;
+
+            VkDeviceMemory memory;
+            if (vkAllocateMemory(r_Device.GetDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate transient memory!");
+
+            heaps[heapSize.first] = memory;
+            m_TransientMemories.push_back(memory);
+            m_TransientMemorySize += heapSize.second;
+        }
+
+        for (size_t i = 0; i < placements.size(); ++i)
+        {
+            const MemoryPlacement &placement = placements[i];
+            Resource &resource = m_Resources[placement.resource];
+            VkDeviceMemory memory = heaps[placement.memoryTypeIndex];
+
+            if (resource.isImage)
+            {
+                if (vkBindImageMemory(r_Device.GetDevice(), resource.image, memory, placement.offset) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to bind image memory!");
+            }
+            else if (vkBindBufferMemory(r_Device.GetDevice(), resource.buffer, memory, placement.offset) != VK_SUCCESS)
+                throw std::runtime_error("Failed to bind buffer memory!");
+
+            for (size_t j = 0; j < placements.size(); ++j)
+            {
+                if (j != i &&
+                    placements[j].memoryTypeIndex == placement.memoryTypeIndex &&
+                    rangesOverlap(placement, placements[j]))
+                    resource.aliases.push_back(placements[j].resource);
+            }
+        }
+    }
+
+    void RenderGraph::SimulateUse(RenderGraphPass &pass, RenderGraphResource resource, RenderGraphAccess access, std::vector<SyncState> &states, bool record)
+    {
+        const Resource &r = m_Resources[resource];
+        SyncState &state = states[resource];
+        AccessInfo info = GetAccessInfo(access);
+
+        bool layoutChange = r.isImage && info.layout != state.layout;
+        bool needBarrier;
+        VkPipelineStageFlags srcStages;
+
+        if (info.write || layoutChange)
+        {
+            // writes and layout transitions wait on every earlier access, reads only need an execution dependency
+            srcStages = state.writeStages | state.readStages;
+            needBarrier = layoutChange || srcStages != 0;
+        }
+        else
+        {
+            srcStages = state.writeStages;
+            bool visible = (info.stages & ~state.visibleStages) == 0 &&
+                           (state.writeAccess == 0 || (info.access & ~state.visibleAccess) == 0);
+            needBarrier = state.writeStages != 0 && !visible;
+        }
+
+        if (needBarrier && record)
+        {
+            RenderGraphPass::Barriers &barriers = pass.m_Barriers;
+            barriers.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            barriers.dstStages |= info.stages;
+
+            if (r.isImage)
+            {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.dstAccessMask = info.access;
+                barrier.oldLayout = state.layout;
+                barrier.newLayout = info.layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange.aspectMask = GetBarrierAspectMask(r.imageInfo.format);
+                barrier.subresourceRange.baseMipLevel = 0;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+
+                barriers.imageResources.push_back(resource);
+                barriers.images.push_back(barrier);
+            }
+            else
+            {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.dstAccessMask = info.access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+
+                barriers.bufferResources.push_back(resource);
+                barriers.buffers.push_back(barrier);
+            }
+        }
+
+        if (info.write || layoutChange)
+        {
+            // a layout transition counts as a write done by the barrier itself
+            state.layout = r.isImage ? info.layout : state.layout;
+            state.writeStages = info.stages;
+            state.writeAccess = info.access & s_WriteAccessMask;
+            state.readStages = info.write ? 0 : info.stages;
+            state.visibleStages = info.write ? 0 : info.stages;
+            state.visibleAccess = info.write ? 0 : info.access;
+        }
+        else
+        {
+            state.readStages |= info.stages;
+            if (needBarrier)
+            {
+                state.visibleStages |= info.stages;
+                state.visibleAccess |= info.access;
+            }
+        }
+    }
+
+    void RenderGraph::ComputeBarriers()
+    {
+        auto initialStates = [this]()
+        {
+            std::vector<SyncState> states(m_Resources.size());
+            for (size_t i = 0; i < m_Resources.size(); ++i)
+            {
+                if (!m_Resources[i].imported)
+                    continue;
+                states[i].layout = m_Resources[i].importInfo.initialLayout;
+                states[i].writeStages = m_Resources[i].importInfo.initialStage;
+                states[i].writeAccess = m_Resources[i].importInfo.initialAccess;
+            }
+            return states;
+        };
+        auto simulate = [this](std::vector<SyncState> &states, bool record)
+        {
+            for (auto &pass : m_Passes)
+            {
+                if (pass->m_Culled)
+                    continue;
+                for (const auto &use : pass->m_Uses)
+                    SimulateUse(*pass, use.resource, use.access, states, record);
+            }
+        };
+
+        // the first run finds where every resource ends up, transients of the next frame (and anything aliasing
+        // their memory) start from there since they are reused on the same queue without a fence in between
+        std::vector<SyncState> endStates = initialStates();
+        simulate(endStates, false);
+
+        std::vector<SyncState> states = initialStates();
+        for (size_t i = 0; i < m_Resources.size(); ++i)
+        {
+            const Resource &resource = m_Resources[i];
+            if (resource.imported)
+                continue;
+
+            states[i].writeStages = endStates[i].writeStages | endStates[i].readStages;
+            states[i].writeAccess = endStates[i].writeAccess;
+            for (RenderGraphResource alias : resource.aliases)
+            {
+                states[i].writeStages |= endStates[alias].writeStages | endStates[alias].readStages;
+                states[i].writeAccess |= endStates[alias].writeAccess;
+            }
+        }
+        simulate(states, true);
+
+        // imported images leave in their final layout, folded into the render pass when an attachment is the last use
+        for (RenderGraphResource i = 0; i < m_Resources.size(); ++i)
+        {
+            const Resource &resource = m_Resources[i];
+            VkImageLayout finalLayout = resource.importInfo.finalLayout;
+            if (!resource.imported || !resource.isImage || finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || finalLayout == states[i].layout)
+                continue;
+
+            if (resource.firstPass != UINT32_MAX)
+            {
+                RenderGraphPass &lastPass = *m_Passes[resource.lastPass];
+                bool folded = false;
+                for (auto &attachment : lastPass.m_ColorAttachments)
+                {
+                    if (attachment.resource == i)
+                    {
+                        attachment.finalLayout = finalLayout;
+                        folded = true;
+                    }
+                }
+                if (lastPass.m_HasDepthAttachment && lastPass.m_DepthAttachment.resource == i)
+                {
+                    lastPass.m_DepthAttachment.finalLayout = finalLayout;
+                    folded = true;
+                }
+                if (folded)
+                    continue;
+            }
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = states[i].writeAccess;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = states[i].layout;
+            barrier.newLayout = finalLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = GetBarrierAspectMask(resource.imageInfo.format);
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+
+            VkPipelineStageFlags srcStages = states[i].writeStages | states[i].readStages;
+            m_FinalBarriers.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            m_FinalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            m_FinalBarriers.imageResources.push_back(i);
+            m_FinalBarriers.images.push_back(barrier);
+        }
+    }
+
+    void RenderGraph::CreateRenderPasses()
+    {
+        for (uint32_t passIndex = 0; passIndex < m_Passes.size(); ++passIndex)
+        {
+            RenderGraphPass &pass = *m_Passes[passIndex];
+            if (pass.m_Culled || pass.m_Type != RenderGraphPassType::Graphics)
+                continue;
+
+            // contents are kept only when someone looks at them after this pass
+            auto storeOp = [this, passIndex](RenderGraphResource resource)
+            {
+                const Resource &r = m_Resources[resource];
+                bool keep = r.output || r.lastPass > passIndex || r.importInfo.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+                return keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            };
+
+            std::vector<VkAttachmentDescription> attachments;
+            for (const auto &attachment : pass.m_ColorAttachments)
+            {
+                const Resource &resource = m_Resources[attachment.resource];
+
+                VkAttachmentDescription description{};
+                description.format = resource.imageInfo.format;
+                description.samples = VK_SAMPLE_COUNT_1_BIT;
+                description.loadOp = attachment.loadOp;
+                description.storeOp = storeOp(attachment.resource);
+                description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; /*transitioned by the graph*/
+                description.finalLayout = attachment.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED ? attachment.finalLayout : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                attachments.push_back(description);
+                pass.m_Extent = resource.imageInfo.extent;
+            }
+
+            const uint32_t depthIndex = static_cast<uint32_t>(attachments.size());
+            VkImageLayout depthLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (pass.m_HasDepthAttachment)
+            {
+                const Resource &resource = m_Resources[pass.m_DepthAttachment.resource];
+                bool readOnly = false;
+                for (const auto &use : pass.m_Uses)
+                    readOnly = readOnly || (use.resource == pass.m_DepthAttachment.resource && use.access == RenderGraphAccess::DepthAttachmentRead);
+                depthLayout = readOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription description{};
+                description.format = resource.imageInfo.format;
+                description.samples = VK_SAMPLE_COUNT_1_BIT;
+                description.loadOp = pass.m_DepthAttachment.loadOp;
+                description.storeOp = storeOp(pass.m_DepthAttachment.resource);
+                description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                description.initialLayout = depthLayout;
+                description.finalLayout = pass.m_DepthAttachment.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED ? pass.m_DepthAttachment.finalLayout : depthLayout;
+
+                attachments.push_back(description);
+                pass.m_Extent = resource.imageInfo.extent;
+            }
+
+            // attachments keep their place in every subpass, colors first and depth last like the frame buffer
+            auto attachmentIndex = [&pass, depthIndex](RenderGraphResource resource)
+            {
+                for (uint32_t i = 0; i < pass.m_ColorAttachments.size(); ++i)
+                {
+                    if (pass.m_ColorAttachments[i].resource == resource)
+                        return i;
+                }
+                assert(pass.m_HasDepthAttachment && pass.m_DepthAttachment.resource == resource &&
+                       "Input attachments must be attachments of the same pass");
+                return depthIndex;
+            };
+
+            const size_t subpassCount = pass.m_Subpasses.size();
+            std::vector<std::vector<VkAttachmentReference>> colorRefs(subpassCount);
+            std::vector<std::vector<VkAttachmentReference>> inputRefs(subpassCount);
+            std::vector<std::vector<uint32_t>> preserveRefs(subpassCount);
+            std::vector<VkAttachmentReference> depthRefs(subpassCount);
+            std::vector<std::vector<bool>> used(subpassCount, std::vector<bool>(attachments.size(), false));
+            for (size_t i = 0; i < subpassCount; ++i)
+            {
+                const RenderGraphPass::Subpass &subpass = pass.m_Subpasses[i];
+                for (RenderGraphResource resource : subpass.colorAttachments)
+                {
+                    uint32_t index = attachmentIndex(resource);
+                    colorRefs[i].push_back({index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+                    used[i][index] = true;
+                }
+
+                bool depthInput = false;
+                for (RenderGraphResource resource : subpass.inputAttachments)
+                {
+                    uint32_t index = attachmentIndex(resource);
+                    depthInput = depthInput || index == depthIndex;
+                    inputRefs[i].push_back({index, index == depthIndex ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+                    used[i][index] = true;
+                }
+
+                if (pass.m_HasDepthAttachment)
+                {
+                    depthRefs[i] = {depthIndex, depthInput ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : depthLayout};
+                    used[i][depthIndex] = true;
+                }
+            }
+
+            // attachments a subpass skips between two that use them have to survive it
+            for (size_t i = 1; i + 1 < subpassCount; ++i)
+            {
+                for (uint32_t index = 0; index < attachments.size(); ++index)
+                {
+                    bool usedBefore = false;
+                    bool usedAfter = false;
+                    for (size_t j = 0; j < i; ++j)
+                        usedBefore = usedBefore || used[j][index];
+                    for (size_t j = i + 1; j < subpassCount; ++j)
+                        usedAfter = usedAfter || used[j][index];
+                    if (!used[i][index] && usedBefore && usedAfter)
+                        preserveRefs[i].push_back(index);
+                }
+            }
+
+            std::vector<VkSubpassDescription> subpasses(subpassCount);
+            std::vector<VkSubpassDependency> dependencies;
+            for (size_t i = 0; i < subpassCount; ++i)
+            {
+                VkSubpassDescription &subpass = subpasses[i];
+                subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs[i].size());
+                subpass.pColorAttachments = colorRefs[i].data();
+                subpass.inputAttachmentCount = static_cast<uint32_t>(inputRefs[i].size());
+                subpass.pInputAttachments = inputRefs[i].data();
+                subpass.preserveAttachmentCount = static_cast<uint32_t>(preserveRefs[i].size());
+                subpass.pPreserveAttachments = preserveRefs[i].data();
+                subpass.pDepthStencilAttachment = pass.m_HasDepthAttachment ? &depthRefs[i] : nullptr;
+
+                if (i == 0)
+                    continue;
+
+                // every subpass waits for the attachment writes of the previous one, per pixel region
+                VkSubpassDependency dependency{};
+                dependency.srcSubpass = static_cast<uint32_t>(i - 1);
+                dependency.dstSubpass = static_cast<uint32_t>(i);
+                dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                dependencies.push_back(dependency);
+            }
+
+            // no external dependencies, the graph records the barriers around the pass itself
+            VkRenderPassCreateInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            renderPassInfo.pAttachments = attachments.data();
+            renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+            renderPassInfo.pSubpasses = subpasses.data();
+            renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+            renderPassInfo.pDependencies = dependencies.data();
+
+            if (vkCreateRenderPass(r_Device.GetDevice(), &renderPassInfo, nullptr, &pass.m_RenderPass) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create render pass!");
+
+            size_t frameBufferCount = 1;
+            for (const auto &attachment : pass.m_ColorAttachments)
+            {
+                pass.m_ClearValues.push_back(attachment.clearValue);
+                if (m_Resources[attachment.resource].imported)
+                    frameBufferCount *= m_Resources[attachment.resource].importInfo.imageCount;
+            }
+            if (pass.m_HasDepthAttachment)
+            {
+                pass.m_ClearValues.push_back(pass.m_DepthAttachment.clearValue);
+                if (m_Resources[pass.m_DepthAttachment.resource].imported)
+                    frameBufferCount *= m_Resources[pass.m_DepthAttachment.resource].importInfo.imageCount;
+            }
+            pass.m_FrameBuffers.resize(frameBufferCount, VK_NULL_HANDLE);
+        }
+    }
+
+    void RenderGraph::SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView, uint32_t imageIndex)
+    {
+        assert(m_Resources[resource].imported && m_Resources[resource].isImage &&
+               "Only imported images can be replaced");
+        assert(imageIndex < m_Resources[resource].importInfo.imageCount && "Image index exceeds the import's image count");
+
+        m_Resources[resource].image = image;
+        m_Resources[resource].imageView = imageView;
+        m_Resources[resource].imageIndex = imageIndex;
+    }
+
+    void RenderGraph::SetImportedBuffer(RenderGraphResource resource, VkBuffer buffer)
+    {
+        assert(m_Resources[resource].imported && !m_Resources[resource].isImage &&
+               "Only imported buffers can be replaced");
+
+        m_Resources[resource].buffer = buffer;
+    }
+
+    VkFramebuffer RenderGraph::GetFrameBuffer(RenderGraphPass &pass)
+    {
+        // imported views rotate with the swap chain images, the image indices pick the pass's frame buffer
+        size_t slot = 0;
+        for (const auto &attachment : pass.m_ColorAttachments)
+        {
+            const Resource &resource = m_Resources[attachment.resource];
+            if (resource.imported)
+                slot = slot * resource.importInfo.imageCount + resource.imageIndex;
+        }
+        if (pass.m_HasDepthAttachment)
+        {
+            const Resource &resource = m_Resources[pass.m_DepthAttachment.resource];
+            if (resource.imported)
+                slot = slot * resource.importInfo.imageCount + resource.imageIndex;
+        }
+
+        VkFramebuffer &frameBuffer = pass.m_FrameBuffers[slot];
+        if (frameBuffer != VK_NULL_HANDLE)
+            return frameBuffer;
+
+        std::vector<VkImageView> views;
+        for (const auto &attachment : pass.m_ColorAttachments)
+            views.push_back(m_Resources[attachment.resource].imageView);
+        if (pass.m_HasDepthAttachment)
+            views.push_back(m_Resources[pass.m_DepthAttachment.resource].imageView);
+
+        VkFramebufferCreateInfo frameBufferInfo{};
+        frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameBufferInfo.renderPass = pass.m_RenderPass;
+        frameBufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        frameBufferInfo.pAttachments = views.data();
+        frameBufferInfo.width = pass.m_Extent.width;
+        frameBufferInfo.height = pass.m_Extent.height;
+        frameBufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(r_Device.GetDevice(), &frameBufferInfo, nullptr, &frameBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create frame buffer!");
+
+        return frameBuffer;
+    }
+
+    void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, RenderGraphPass::Barriers &barriers)
+    {
+        if (barriers.srcStages == 0)
+            return;
+
+        for (size_t i = 0; i < barriers.images.size(); ++i)
+            barriers.images[i].image = m_Resources[barriers.imageResources[i]].image;
+        for (size_t i = 0; i < barriers.buffers.size(); ++i)
+            barriers.buffers[i].buffer = m_Resources[barriers.bufferResources[i]].buffer;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            barriers.srcStages,
+            barriers.dstStages,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(barriers.buffers.size()), barriers.buffers.data(),
+            static_cast<uint32_t>(barriers.images.size()), barriers.images.data());
+    }
+
+    void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+    {
+        assert(m_Compiled && "Render graph must be compiled before execution");
+
+        for (auto &up_Pass : m_Passes)
+        {
+            RenderGraphPass &pass = *up_Pass;
+            if (pass.m_Culled)
+                continue;
+
+            RecordBarriers(commandBuffer, pass.m_Barriers);
+
+            if (pass.m_Type != RenderGraphPassType::Graphics)
+            {
+                if (pass.m_Subpasses[0].execute)
+                    pass.m_Subpasses[0].execute(commandBuffer);
+                continue;
+            }
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = pass.m_RenderPass;
+            renderPassInfo.framebuffer = GetFrameBuffer(pass);
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = pass.m_Extent;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.m_ClearValues.size());
+            renderPassInfo.pClearValues = pass.m_ClearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = static_cast<float>(pass.m_Extent.width);
+            viewport.height = static_cast<float>(pass.m_Extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor{};
+            scissor.offset = {0, 0};
+            scissor.extent = pass.m_Extent;
+
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            for (size_t i = 0; i < pass.m_Subpasses.size(); ++i)
+            {
+                if (i > 0)
+                    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+                if (pass.m_Subpasses[i].execute)
+                    pass.m_Subpasses[i].execute(commandBuffer);
+            }
+
+            vkCmdEndRenderPass(commandBuffer);
+        }
+
+        RecordBarriers(commandBuffer, m_FinalBarriers);
+    }
+
+    void RenderGraph::Destroy()
+    {
+        for (auto &pass : m_Passes)
+        {
+            for (VkFramebuffer frameBuffer : pass->m_FrameBuffers)
+                vkDestroyFramebuffer(r_Device.GetDevice(), frameBuffer, nullptr);
+            pass->m_FrameBuffers.clear();
+            vkDestroyRenderPass(r_Device.GetDevice(), pass->m_RenderPass, nullptr);
+            pass->m_RenderPass = VK_NULL_HANDLE;
+        }
+
+        for (auto &resource : m_Resources)
+        {
+            if (resource.imported)
+                continue;
+
+            vkDestroyImageView(r_Device.GetDevice(), resource.imageView, nullptr);
+            vkDestroyImage(r_Device.GetDevice(), resource.image, nullptr);
+            vkDestroyBuffer(r_Device.GetDevice(), resource.buffer, nullptr);
+            vkFreeMemory(r_Device.GetDevice(), resource.dedicatedMemory, nullptr);
+        }
+
+        for (auto memory : m_TransientMemories)
+            vkFreeMemory(r_Device.GetDevice(), memory, nullptr);
+        m_TransientMemories.clear();
+        m_Compiled = false;
+    }
+}
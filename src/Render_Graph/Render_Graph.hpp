@@ -0,0 +1,253 @@
+#ifndef RENDER_GRAPH_HEADER
+#define RENDER_GRAPH_HEADER
+
+#include "Device.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Divine
+{
+    using RenderGraphResource = uint32_t;
+
+    enum class RenderGraphPassType
+    {
+        Graphics,
+        Compute,
+        Transfer
+    };
+
+    // every access implies the stages, access mask and image layout the graph synchronizes against
+    enum class RenderGraphAccess
+    {
+        ColorAttachment,
+        DepthAttachment,
+        DepthAttachmentRead,
+        FragmentSampled,
+        GraphicsStorageRead,
+        ComputeSampled,
+        ComputeStorageRead,
+        ComputeStorageWrite,
+        IndirectRead,
+        VertexRead,
+        TransferRead,
+        TransferWrite
+    };
+
+    struct RenderGraphImageInfo
+    {
+        VkFormat format;
+        VkExtent2D extent;
+    };
+
+    struct RenderGraphBufferInfo
+    {
+        VkDeviceSize size;
+    };
+
+    // state of an imported resource when the graph starts and where it has to leave it
+    struct RenderGraphImportInfo
+    {
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags initialAccess = 0;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED; // undefined leaves the last layout and discards the contents unless marked as output
+        uint32_t imageCount = 1;                               // images SetImportedImage rotates through, e.g. the swap chain images
+    };
+
+    class RenderGraphPass
+    {
+    public:
+        using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+
+        RenderGraphPass(const std::string &name, RenderGraphPassType type)
+            : m_Name{name}, m_Type{type} {}
+
+        RenderGraphPass &Read(RenderGraphResource resource, RenderGraphAccess access);
+        RenderGraphPass &Write(RenderGraphResource resource, RenderGraphAccess access);
+        // graphics passes only, LOAD also counts as a read of the previous contents. Setting an attachment
+        // again in a later subpass keeps its first load op, the depth attachment is shared by every subpass
+        RenderGraphPass &SetColorAttachment(RenderGraphResource resource,
+                                            VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                            VkClearColorValue clearValue = {{0.0f, 0.0f, 0.0f, 1.0f}});
+        RenderGraphPass &SetDepthAttachment(RenderGraphResource resource,
+                                            VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                            VkClearDepthStencilValue clearValue = {1.0f, 0},
+                                            bool readOnly = false);
+        // graphics passes only, the following color and input attachments and execute function belong to
+        // a new subpass of the same render pass
+        RenderGraphPass &NextSubpass();
+        // reads an attachment an earlier subpass wrote at the same pixel, so tilers keep it on chip.
+        // Reading the depth attachment makes it read only for the subpass
+        RenderGraphPass &SetInputAttachment(RenderGraphResource resource);
+        // passes with side effects outside the graph are never culled
+        RenderGraphPass &SetSideEffects();
+        RenderGraphPass &SetExecute(ExecuteFunction execute);
+
+        inline const std::string &GetName() const { return m_Name; }
+        inline bool IsCulled() const { return m_Culled; }
+        // valid after RenderGraph::Compile, compatible with any render pass of the same attachment formats
+        // and subpasses, so pipelines outlive a rebuilt graph
+        inline VkRenderPass GetRenderPass() const { return m_RenderPass; }
+        inline uint32_t GetSubpassCount() const { return static_cast<uint32_t>(m_Subpasses.size()); }
+
+    private:
+        friend class RenderGraph;
+
+        struct Use
+        {
+            RenderGraphResource resource;
+            RenderGraphAccess access;
+        };
+
+        struct Attachment
+        {
+            RenderGraphResource resource;
+            VkAttachmentLoadOp loadOp;
+            VkClearValue clearValue;
+            VkImageLayout finalLayout;
+        };
+
+        struct Subpass
+        {
+            std::vector<RenderGraphResource> colorAttachments;
+            std::vector<RenderGraphResource> inputAttachments;
+            ExecuteFunction execute;
+        };
+
+        struct Barriers
+        {
+            std::vector<RenderGraphResource> imageResources;
+            std::vector<VkImageMemoryBarrier> images;
+            std::vector<RenderGraphResource> bufferResources;
+            std::vector<VkBufferMemoryBarrier> buffers;
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+        };
+
+    private:
+        std::string m_Name;
+        RenderGraphPassType m_Type;
+        std::vector<Use> m_Uses;
+        std::vector<Attachment> m_ColorAttachments;
+        Attachment m_DepthAttachment{};
+        bool m_HasDepthAttachment = false;
+        bool m_SideEffects = false;
+        std::vector<Subpass> m_Subpasses{1}; // non graphics passes only use the execute function of the first
+
+        bool m_Culled = false;
+        Barriers m_Barriers;
+        VkRenderPass m_RenderPass = VK_NULL_HANDLE;
+        VkExtent2D m_Extent{};
+        std::vector<VkClearValue> m_ClearValues;
+        std::vector<VkFramebuffer> m_FrameBuffers; // one per combination of the imported attachments' image indices
+    };
+
+    // Passes are declared in execution order with the resources they touch. Compile culls passes whose
+    // writes nothing consumes, derives the barriers, builds render passes and places transient resources
+    // with disjoint lifetimes in shared memory. Execute records the whole frame into one command buffer.
+    // The graph is meant to be compiled once per configuration and rebuilt when the targets change.
+    class RenderGraph
+    {
+    public:
+        RenderGraph(Device &device);
+        ~RenderGraph();
+        RenderGraph(const RenderGraph &) = delete;
+        RenderGraph &operator=(const RenderGraph &) = delete;
+
+        RenderGraphResource ImportImage(const std::string &name, const RenderGraphImageInfo &info, const RenderGraphImportInfo &importInfo);
+        RenderGraphResource ImportBuffer(const std::string &name, const RenderGraphBufferInfo &info, const RenderGraphImportInfo &importInfo);
+        RenderGraphResource CreateImage(const std::string &name, const RenderGraphImageInfo &info);
+        RenderGraphResource CreateBuffer(const std::string &name, const RenderGraphBufferInfo &info);
+        RenderGraphPass &AddPass(const std::string &name, RenderGraphPassType type);
+        void MarkOutput(RenderGraphResource resource);
+
+        void Compile();
+        inline bool IsCompiled() const { return m_Compiled; }
+
+        // imported handles may change every frame, e.g. the acquired swap chain image. imageIndex tells which of
+        // the import's imageCount images it is, frame buffers are created once per image
+        void SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView, uint32_t imageIndex = 0);
+        void SetImportedBuffer(RenderGraphResource resource, VkBuffer buffer);
+        void Execute(VkCommandBuffer commandBuffer);
+
+        inline VkImage GetImage(RenderGraphResource resource) const { return m_Resources[resource].image; }
+        inline VkImageView GetImageView(RenderGraphResource resource) const { return m_Resources[resource].imageView; }
+        inline VkBuffer GetBuffer(RenderGraphResource resource) const { return m_Resources[resource].buffer; }
+        // compile results, for logging
+        inline uint32_t GetPassCount() const { return static_cast<uint32_t>(m_Passes.size()); }
+        inline uint32_t GetAlivePassCount() const { return m_AlivePassCount; }
+        inline uint32_t GetBarrierBatchCount() const { return m_BarrierBatchCount; }
+        inline VkDeviceSize GetTransientMemorySize() const { return m_TransientMemorySize; }
+
+    private:
+        struct Resource
+        {
+            std::string name;
+            bool isImage;
+            bool imported;
+            bool output = false;
+            RenderGraphImageInfo imageInfo{};
+            VkDeviceSize size = 0;
+            RenderGraphImportInfo importInfo{};
+            VkImageUsageFlags imageUsage = 0;
+            VkBufferUsageFlags bufferUsage = 0;
+            bool attachmentOnly = true;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView imageView = VK_NULL_HANDLE;
+            uint32_t imageIndex = 0;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory dedicatedMemory = VK_NULL_HANDLE;
+
+            uint32_t firstPass = UINT32_MAX;
+            uint32_t lastPass = 0;
+            // resources sharing memory with this one, their last use must finish before its first use
+            std::vector<RenderGraphResource> aliases;
+        };
+
+        struct SyncState
+        {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags writeStages = 0;
+            VkAccessFlags writeAccess = 0;
+            VkPipelineStageFlags readStages = 0;
+            VkPipelineStageFlags visibleStages = 0;
+            VkAccessFlags visibleAccess = 0;
+        };
+
+        struct MemoryPlacement
+        {
+            RenderGraphResource resource;
+            VkMemoryRequirements requirements;
+            uint32_t memoryTypeIndex;
+            VkDeviceSize offset = 0;
+        };
+
+        void CullPasses();
+        void ComputeLifetimes();
+        void CreateTransientResources();
+        void AllocateTransientMemory(std::vector<MemoryPlacement> &placements);
+        void ComputeBarriers();
+        void CreateRenderPasses();
+        void SimulateUse(RenderGraphPass &pass, RenderGraphResource resource, RenderGraphAccess access, std::vector<SyncState> &states, bool record);
+        VkFramebuffer GetFrameBuffer(RenderGraphPass &pass);
+        void RecordBarriers(VkCommandBuffer commandBuffer, RenderGraphPass::Barriers &barriers);
+        void Destroy();
+
+    private:
+        Device &r_Device;
+        std::vector<Resource> m_Resources;
+        std::vector<std::unique_ptr<RenderGraphPass>> m_Passes;
+        RenderGraphPass::Barriers m_FinalBarriers;
+        std::vector<VkDeviceMemory> m_TransientMemories;
+        VkDeviceSize m_TransientMemorySize = 0;
+        uint32_t m_AlivePassCount = 0;
+        uint32_t m_BarrierBatchCount = 0;
+        bool m_Compiled = false;
+    };
+}
+
+#endif
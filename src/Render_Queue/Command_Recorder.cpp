@@ -0,0 +1,126 @@
+#include "Command_Recorder.hpp"
+
+#include <assert.h>
+
+namespace Divine
+{
+    CommandRecorder::CommandRecorder(VkCommandBuffer commandBuffer)
+        : m_CommandBuffer{commandBuffer}
+    {
+    }
+
+    CommandRecorder::BindPointState &CommandRecorder::GetState(VkPipelineBindPoint bindPoint)
+    {
+        assert((bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS || bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) &&
+               "Only graphics and compute bind points are tracked");
+        return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? m_Compute : m_Graphics;
+    }
+
+    void CommandRecorder::BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+    {
+        BindPointState &state = GetState(bindPoint);
+        if (state.pipeline == pipeline)
+        {
+            ++m_SkippedCount;
+            return;
+        }
+
+        vkCmdBindPipeline(m_CommandBuffer, bindPoint, pipeline);
+        state.pipeline = pipeline;
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::BindDescriptorSets(
+        VkPipelineBindPoint bindPoint,
+        VkPipelineLayout layout,
+        uint32_t firstSet,
+        uint32_t setCount,
+        const VkDescriptorSet *pSets)
+    {
+        assert(firstSet + setCount <= s_MaxSets && "Descriptor set index is beyond the tracked ones");
+        BindPointState &state = GetState(bindPoint);
+        if (state.layout != layout)
+        {
+            state.layout = layout;
+            state.sets.fill(VK_NULL_HANDLE);
+        }
+
+        // only the changed range is rebound
+        uint32_t begin = 0;
+        while (begin < setCount && state.sets[firstSet + begin] == pSets[begin])
+            ++begin;
+        uint32_t end = setCount;
+        while (end > begin && state.sets[firstSet + end - 1] == pSets[end - 1])
+            --end;
+
+        if (begin == end)
+        {
+            ++m_SkippedCount;
+            return;
+        }
+
+        vkCmdBindDescriptorSets(m_CommandBuffer, bindPoint, layout, firstSet + begin, end - begin, pSets + begin, 0, nullptr);
+        for (uint32_t i = begin; i < end; ++i)
+            state.sets[firstSet + i] = pSets[i];
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *pBuffers, const VkDeviceSize *pOffsets)
+    {
+        assert(firstBinding + bindingCount <= s_MaxVertexBindings && "Vertex binding is beyond the tracked ones");
+        uint32_t begin = 0;
+        while (begin < bindingCount && m_VertexBindings[firstBinding + begin].buffer == pBuffers[begin] &&
+               m_VertexBindings[firstBinding + begin].offset == pOffsets[begin])
+            ++begin;
+        uint32_t end = bindingCount;
+        while (end > begin && m_VertexBindings[firstBinding + end - 1].buffer == pBuffers[end - 1] &&
+               m_VertexBindings[firstBinding + end - 1].offset == pOffsets[end - 1])
+            --end;
+
+        if (begin == end)
+        {
+            ++m_SkippedCount;
+            return;
+        }
+
+        vkCmdBindVertexBuffers(m_CommandBuffer, firstBinding + begin, end - begin, pBuffers + begin, pOffsets + begin);
+        for (uint32_t i = begin; i < end; ++i)
+            m_VertexBindings[firstBinding + i] = {pBuffers[i], pOffsets[i]};
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+    {
+        if (m_IndexBuffer == buffer && m_IndexOffset == offset && m_IndexType == indexType)
+        {
+            ++m_SkippedCount;
+            return;
+        }
+
+        vkCmdBindIndexBuffer(m_CommandBuffer, buffer, offset, indexType);
+        m_IndexBuffer = buffer;
+        m_IndexOffset = offset;
+        m_IndexType = indexType;
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+    {
+        vkCmdDraw(m_CommandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+    {
+        vkCmdDrawIndexed(m_CommandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+        ++m_IssuedCount;
+    }
+
+    void CommandRecorder::Invalidate()
+    {
+        m_Graphics = BindPointState{};
+        m_Compute = BindPointState{};
+        m_VertexBindings.fill(VertexBinding{});
+        m_IndexBuffer = VK_NULL_HANDLE;
+    }
+}
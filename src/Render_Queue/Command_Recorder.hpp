@@ -0,0 +1,74 @@
+#ifndef COMMAND_RECORDER_HEADER
+#define COMMAND_RECORDER_HEADER
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+
+namespace Divine
+{
+    // Thin layer over a command buffer that remembers the bound state and drops binds that would not
+    // change it. Only what goes through the recorder is tracked, call Invalidate after binding behind
+    // its back. Descriptor sets are remembered per pipeline layout, a new layout rebinds everything.
+    class CommandRecorder
+    {
+    public:
+        CommandRecorder(VkCommandBuffer commandBuffer);
+        CommandRecorder(const CommandRecorder &) = delete;
+        CommandRecorder &operator=(const CommandRecorder &) = delete;
+
+        void BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+        void BindDescriptorSets(
+            VkPipelineBindPoint bindPoint,
+            VkPipelineLayout layout,
+            uint32_t firstSet,
+            uint32_t setCount,
+            const VkDescriptorSet *pSets);
+        void BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *pBuffers, const VkDeviceSize *pOffsets);
+        void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+
+        void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+        void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+        void Invalidate();
+
+        inline VkCommandBuffer GetCommandBuffer() const { return m_CommandBuffer; }
+        // binds and draws that reached the command buffer, and binds that were dropped
+        inline uint32_t GetIssuedCount() const { return m_IssuedCount; }
+        inline uint32_t GetSkippedCount() const { return m_SkippedCount; }
+
+    private:
+        static constexpr uint32_t s_MaxSets = 4;
+        static constexpr uint32_t s_MaxVertexBindings = 4;
+
+        struct BindPointState
+        {
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+            std::array<VkDescriptorSet, s_MaxSets> sets{};
+        };
+
+        struct VertexBinding
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+        };
+
+        BindPointState &GetState(VkPipelineBindPoint bindPoint);
+
+    private:
+        VkCommandBuffer m_CommandBuffer;
+        BindPointState m_Graphics{};
+        BindPointState m_Compute{};
+        std::array<VertexBinding, s_MaxVertexBindings> m_VertexBindings{};
+        VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize m_IndexOffset = 0;
+        VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+
+        uint32_t m_IssuedCount = 0;
+        uint32_t m_SkippedCount = 0;
+    };
+}
+
+#endif
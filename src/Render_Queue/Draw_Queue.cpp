@@ -0,0 +1,27 @@
+#include "Draw_Queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Divine
+{
+    uint64_t DrawKey::Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t depth)
+    {
+        uint64_t key = pass & ((1u << s_PassBits) - 1);
+        key = (key << s_PipelineBits) | (pipeline & ((1u << s_PipelineBits) - 1));
+        key = (key << s_MaterialBits) | (material & ((1u << s_MaterialBits) - 1));
+        key = (key << s_ModelBits) | (model & ((1u << s_ModelBits) - 1));
+        key = (key << s_DepthBits) | (depth & ((1u << s_DepthBits) - 1));
+        return key;
+    }
+
+    uint32_t DrawKey::QuantizeDepth(float depth, bool backToFront)
+    {
+        // non-negative floats order like their bits, the top 24 of the 31 used ones keep that order
+        uint32_t bits;
+        float clamped = std::max(depth, 0.0f);
+        std::memcpy(&bits, &clamped, sizeof(bits));
+        uint32_t quantized = bits >> (31 - s_DepthBits);
+        return backToFront ? ((1u << s_DepthBits) - 1) - quantized : quantized;
+    }
+}
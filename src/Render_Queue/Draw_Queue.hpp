@@ -0,0 +1,49 @@
+#ifndef DRAW_QUEUE_HEADER
+#define DRAW_QUEUE_HEADER
+
+#include "Radix_Sort.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Divine
+{
+    // 64 bit sort key, most significant first: pass 4 | pipeline 8 | material 12 | model 16 | depth 24.
+    // Sorting groups the packets by state so every bind happens once per run, and orders each run by depth.
+    struct DrawKey
+    {
+        static constexpr uint32_t s_DepthBits = 24;
+        static constexpr uint32_t s_ModelBits = 16;
+        static constexpr uint32_t s_MaterialBits = 12;
+        static constexpr uint32_t s_PipelineBits = 8;
+        static constexpr uint32_t s_PassBits = 4;
+
+        // ids wrap at their width, so equal state bits only group packets, callers still compare the objects
+        static uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t depth);
+        // depth is a non-negative view distance, nearer is smaller unless inverted for back to front
+        static uint32_t QuantizeDepth(float depth, bool backToFront = false);
+
+        // everything but the depth, packets with equal state and objects can share a draw
+        static inline uint64_t GetState(uint64_t key) { return key >> s_DepthBits; }
+    };
+
+    // Draw packets of a frame, the value of a packet is an index into the caller's own data
+    class DrawQueue
+    {
+    public:
+        inline void Clear() { m_Items.clear(); }
+        inline void Reserve(size_t count) { m_Items.reserve(count); }
+        inline void Push(uint64_t key, uint32_t value) { m_Items.push_back({key, value}); }
+        inline void Sort() { RadixSort(m_Items, m_Scratch); }
+
+        inline size_t GetSize() const { return m_Items.size(); }
+        inline const SortItem &operator[](size_t index) const { return m_Items[index]; }
+
+    private:
+        std::vector<SortItem> m_Items;
+        std::vector<SortItem> m_Scratch;
+    };
+}
+
+#endif
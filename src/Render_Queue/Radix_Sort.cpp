@@ -0,0 +1,72 @@
+#include "Radix_Sort.hpp"
+
+#include <array>
+#include <utility>
+
+namespace Divine
+{
+    // below this the histograms cost more than comparing
+    static constexpr size_t s_InsertionSortThreshold = 64;
+
+    static void InsertionSort(std::vector<SortItem> &items)
+    {
+        for (size_t i = 1; i < items.size(); ++i)
+        {
+            SortItem item = items[i];
+            size_t j = i;
+            for (; j > 0 && items[j - 1].key > item.key; --j)
+                items[j] = items[j - 1];
+            items[j] = item;
+        }
+    }
+
+    void RadixSort(std::vector<SortItem> &items, std::vector<SortItem> &scratch)
+    {
+        const size_t count = items.size();
+        if (count < s_InsertionSortThreshold)
+        {
+            InsertionSort(items);
+            return;
+        }
+
+        // bytes every key agrees on are left alone, they would only copy the items around
+        uint64_t varying = 0;
+        for (const SortItem &item : items)
+            varying |= item.key ^ items[0].key;
+
+        uint32_t passes[8];
+        uint32_t passCount = 0;
+        for (uint32_t pass = 0; pass < 8; ++pass)
+        {
+            if (((varying >> (pass * 8)) & 0xFF) != 0)
+                passes[passCount++] = pass;
+        }
+
+        std::array<std::array<uint32_t, 256>, 8> histograms{};
+        for (const SortItem &item : items)
+        {
+            for (uint32_t i = 0; i < passCount; ++i)
+                ++histograms[i][(item.key >> (passes[i] * 8)) & 0xFF];
+        }
+
+        scratch.resize(count);
+        for (uint32_t i = 0; i < passCount; ++i)
+        {
+            std::array<uint32_t, 256> &histogram = histograms[i];
+            uint32_t shift = passes[i] * 8;
+
+            uint32_t offset = 0;
+            for (uint32_t &bucket : histogram)
+            {
+                uint32_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+
+            for (const SortItem &item : items)
+                scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+            // the vectors trade buffers, the result ends up in items whatever the pass count
+            items.swap(scratch);
+        }
+    }
+}
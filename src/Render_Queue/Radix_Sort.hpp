@@ -0,0 +1,23 @@
+#ifndef RADIX_SORT_HEADER
+#define RADIX_SORT_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Divine
+{
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    // Stable LSD radix sort on the key, one byte per pass. The histograms of all bytes are built in a
+    // single read, bytes every key agrees on are skipped, so keys using only their upper bits cost as
+    // many passes as they have distinct bytes. Short inputs fall back to an insertion sort. scratch is
+    // resized to the item count and may be kept between calls to avoid allocations.
+    void RadixSort(std::vector<SortItem> &items, std::vector<SortItem> &scratch);
+}
+
+#endif
@@ -0,0 +1,10 @@
+#include "Transparency_Queue.hpp"
+
+namespace Divine
+{
+    TransparencyQueue::TransparencyQueue(size_t capacity)
+    {
+        m_Items.reserve(capacity);
+        m_Scratch.reserve(capacity);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef TRANSPARENCY_QUEUE_HEADER
+#define TRANSPARENCY_QUEUE_HEADER
+
+#include "Radix_Sort.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Divine
+{
+    // Back to front order for blended geometry, any system drawing transparent things can keep one.
+    // Distances become order preserving integer keys and are radix sorted, ties keep their push order.
+    // The buffers only grow, so once they reached the scene's size a frame allocates nothing.
+    class TransparencyQueue
+    {
+    public:
+        TransparencyQueue(size_t capacity = 256);
+
+        inline void Clear() { m_Items.clear(); }
+        // distance is anything that grows away from the camera, squared distances work as well
+        inline void Push(float distance, uint32_t value) { m_Items.push_back({ToBackToFrontKey(distance), value}); }
+        // farthest first
+        inline void Sort() { RadixSort(m_Items, m_Scratch); }
+
+        inline size_t GetSize() const { return m_Items.size(); }
+        inline uint32_t operator[](size_t index) const { return m_Items[index].value; }
+
+        // flips the float bits so unsigned order matches float order, then inverts for descending
+        static inline uint32_t ToBackToFrontKey(float distance)
+        {
+            uint32_t bits;
+            float canonical = distance + 0.0f; // -0 becomes +0, they have to tie
+            static_assert(sizeof(bits) == sizeof(canonical), "float is expected to be 32 bits");
+            std::memcpy(&bits, &canonical, sizeof(bits));
+            uint32_t ascending = bits ^ ((bits >> 31) != 0 ? 0xFFFFFFFFu : 0x80000000u);
+            return ~ascending;
+        }
+
+    private:
+        std::vector<SortItem> m_Items;
+        std::vector<SortItem> m_Scratch;
+    };
+}
+
+#endif
@@ -0,0 +1,300 @@
+#include "Frame_Readback.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string.h>
+
+namespace Divine
+{
+    static constexpr uint32_t s_PixelSize = 4;
+
+    static bool IsBGRA(VkFormat format)
+    {
+        return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+    }
+
+    FrameReadback::FrameReadback(Device &device, ThreadPool &threadPool, uint32_t framesInFlight, VkExtent2D extent, VkFormat format, uint32_t maxPendingTasks)
+        : r_Device{device}, r_ThreadPool{threadPool}, m_Extent{extent}, m_Format{format}, m_MaxPendingTasks{maxPendingTasks}
+    {
+        m_Slots.resize(framesInFlight);
+        for (auto &slot : m_Slots)
+        {
+            slot.up_Buffer = std::make_unique<Buffer>(r_Device,
+                                                      s_PixelSize,
+                                                      m_Extent.width * m_Extent.height,
+                                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            slot.up_Buffer->Map();
+        }
+    }
+
+    FrameReadback::~FrameReadback()
+    {
+        // consumers may still read the frames they were handed, but never the mapped buffers
+        for (auto &task : m_PendingTasks)
+            task.wait();
+    }
+
+    void FrameReadback::SetConsumer(Consumer consumer)
+    {
+        m_Consumer = std::move(consumer);
+    }
+
+    void FrameReadback::Collect(uint32_t frameIndex)
+    {
+        Slot &slot = m_Slots[frameIndex];
+        if (!slot.pending)
+            return;
+        slot.pending = false;
+
+        DIVINE_PROFILE_FUNCTION();
+        auto sp_Frame = std::make_shared<ReadbackFrame>();
+        sp_Frame->frameNumber = slot.frameNumber;
+        sp_Frame->extent = m_Extent;
+        sp_Frame->format = m_Format;
+        sp_Frame->pixels.resize(static_cast<size_t>(slot.up_Buffer->GetBufferSize()));
+        memcpy(sp_Frame->pixels.data(), slot.up_Buffer->GetMappedMemory(), sp_Frame->pixels.size());
+
+        Dispatch(std::move(sp_Frame));
+    }
+
+    void FrameReadback::Dispatch(std::shared_ptr<ReadbackFrame> sp_Frame)
+    {
+        if (!m_Consumer)
+            return;
+
+        while (!m_PendingTasks.empty() &&
+               m_PendingTasks.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            m_PendingTasks.pop_front();
+
+        if (m_PendingTasks.size() >= m_MaxPendingTasks)
+        {
+            ++m_DroppedFrames;
+            return;
+        }
+
+        Consumer consumer = m_Consumer;
+        m_PendingTasks.push_back(r_ThreadPool.Submit([consumer, sp_Frame]()
+                                                     { consumer(*sp_Frame); }));
+    }
+
+    void FrameReadback::Record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, uint64_t frameNumber)
+    {
+        Slot &slot = m_Slots[frameIndex];
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {m_Extent.width, m_Extent.height, 1};
+
+        vkCmdCopyImageToBuffer(
+            commandBuffer,
+            image,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            slot.up_Buffer->GetBuffer(),
+            1,
+            &region);
+
+        // the fence alone does not make transfer writes visible to the host
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = slot.up_Buffer->GetBuffer();
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+
+        slot.pending = true;
+        slot.frameNumber = frameNumber;
+    }
+
+    void FrameReadback::Flush()
+    {
+        // oldest frame first, so consumers see them in order
+        std::vector<uint32_t> order(m_Slots.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+                  { return m_Slots[a].frameNumber < m_Slots[b].frameNumber; });
+
+        // nothing is dropped here, the consumers are waited for instead
+        for (uint32_t frameIndex : order)
+        {
+            for (auto &task : m_PendingTasks)
+                task.wait();
+            m_PendingTasks.clear();
+            Collect(frameIndex);
+        }
+
+        for (auto &task : m_PendingTasks)
+            task.wait();
+        m_PendingTasks.clear();
+    }
+
+    void FrameReadback::WriteImage(const ReadbackFrame &frame, const std::string &path)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs.is_open())
+            throw std::runtime_error("Failed to open file: " + path);
+
+        const uint32_t pixelCount = frame.extent.width * frame.extent.height;
+        const bool bgra = IsBGRA(frame.format);
+
+        bool tga = path.size() >= 4 && path.compare(path.size() - 4, 4, ".tga") == 0;
+        if (!tga)
+        {
+            // binary PPM
+            ofs << "P6\n"
+                << frame.extent.width << " " << frame.extent.height << "\n255\n";
+            std::vector<char> rgb(static_cast<size_t>(pixelCount) * 3);
+            for (uint32_t i = 0; i < pixelCount; ++i)
+            {
+                const uint8_t *pixel = &frame.pixels[i * s_PixelSize];
+                rgb[i * 3 + 0] = static_cast<char>(bgra ? pixel[2] : pixel[0]);
+                rgb[i * 3 + 1] = static_cast<char>(pixel[1]);
+                rgb[i * 3 + 2] = static_cast<char>(bgra ? pixel[0] : pixel[2]);
+            }
+            ofs.write(rgb.data(), rgb.size());
+            return;
+        }
+
+        // run-length encoded true color TGA, top-left origin, stores BGR
+        uint8_t header[18] = {};
+        header[2] = 10;
+        header[12] = static_cast<uint8_t>(frame.extent.width & 0xFF);
+        header[13] = static_cast<uint8_t>(frame.extent.width >> 8);
+        header[14] = static_cast<uint8_t>(frame.extent.height & 0xFF);
+        header[15] = static_cast<uint8_t>(frame.extent.height >> 8);
+        header[16] = 24;
+        header[17] = 0x20;
+        ofs.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+        auto appendBGR = [&](std::vector<char> &out, uint32_t index)
+        {
+            const uint8_t *pixel = &frame.pixels[index * s_PixelSize];
+            out.push_back(static_cast<char>(bgra ? pixel[0] : pixel[2]));
+            out.push_back(static_cast<char>(pixel[1]));
+            out.push_back(static_cast<char>(bgra ? pixel[2] : pixel[0]));
+        };
+        auto samePixel = [&](uint32_t a, uint32_t b)
+        {
+            return memcmp(&frame.pixels[a * s_PixelSize], &frame.pixels[b * s_PixelSize], 3) == 0;
+        };
+
+        std::vector<char> encoded;
+        encoded.reserve(static_cast<size_t>(pixelCount) * 3 / 2);
+        const uint32_t width = frame.extent.width;
+        for (uint32_t row = 0; row < frame.extent.height; ++row)
+        {
+            // packets hold at most 128 pixels and must not cross scanlines
+            uint32_t first = row * width;
+            uint32_t end = first + width;
+            uint32_t x = first;
+            while (x < end)
+            {
+                uint32_t count = 1;
+                if (x + 1 < end && samePixel(x, x + 1))
+                {
+                    while (x + count < end && count < 128 && samePixel(x, x + count))
+                        ++count;
+
+                    encoded.push_back(static_cast<char>(0x80 | (count - 1)));
+                    appendBGR(encoded, x);
+                }
+                else
+                {
+                    // raw packet up to the start of the next run
+                    while (x + count < end && count < 128 && !(x + count + 1 < end && samePixel(x + count, x + count + 1)))
+                        ++count;
+
+                    encoded.push_back(static_cast<char>(count - 1));
+                    for (uint32_t i = 0; i < count; ++i)
+                        appendBGR(encoded, x + i);
+                }
+                x += count;
+            }
+        }
+        ofs.write(encoded.data(), encoded.size());
+    }
+
+    bool FrameReadback::ReadPPM(const std::string &path, ReadbackFrame &frame)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open())
+            return false;
+
+        std::string magic;
+        uint32_t width, height, maxValue;
+        ifs >> magic >> width >> height >> maxValue;
+        ifs.get();
+        if (magic != "P6" || maxValue != 255 || !ifs)
+            return false;
+
+        std::vector<char> rgb(static_cast<size_t>(width) * height * 3);
+        ifs.read(rgb.data(), rgb.size());
+        if (!ifs)
+            return false;
+
+        frame.extent = {width, height};
+        frame.format = VK_FORMAT_R8G8B8A8_UNORM;
+        frame.pixels.resize(static_cast<size_t>(width) * height * s_PixelSize);
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i)
+        {
+            frame.pixels[i * s_PixelSize + 0] = static_cast<uint8_t>(rgb[i * 3 + 0]);
+            frame.pixels[i * s_PixelSize + 1] = static_cast<uint8_t>(rgb[i * 3 + 1]);
+            frame.pixels[i * s_PixelSize + 2] = static_cast<uint8_t>(rgb[i * 3 + 2]);
+            frame.pixels[i * s_PixelSize + 3] = 255;
+        }
+
+        return true;
+    }
+
+    uint64_t FrameReadback::CountMismatchedPixels(const ReadbackFrame &frame, const ReadbackFrame &reference, uint8_t tolerance)
+    {
+        if (frame.extent.width != reference.extent.width || frame.extent.height != reference.extent.height)
+            return static_cast<uint64_t>(frame.extent.width) * frame.extent.height;
+
+        // channels are compared as RGB whatever order either side is stored in
+        const bool frameBGRA = IsBGRA(frame.format);
+        const bool referenceBGRA = IsBGRA(reference.format);
+
+        uint64_t mismatched = 0;
+        const size_t pixelCount = static_cast<size_t>(frame.extent.width) * frame.extent.height;
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            const uint8_t *a = &frame.pixels[i * s_PixelSize];
+            const uint8_t *b = &reference.pixels[i * s_PixelSize];
+            int diff[3] = {
+                std::abs((frameBGRA ? a[2] : a[0]) - (referenceBGRA ? b[2] : b[0])),
+                std::abs(a[1] - b[1]),
+                std::abs((frameBGRA ? a[0] : a[2]) - (referenceBGRA ? b[0] : b[2]))};
+
+            if (diff[0] > tolerance || diff[1] > tolerance || diff[2] > tolerance)
+                ++mismatched;
+        }
+
+        return mismatched;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef FRAME_READBACK_HEADER
+#define FRAME_READBACK_HEADER
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Thread_Pool.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Divine
+{
+    // tightly packed 4 byte pixels in the order of the source format
+    struct ReadbackFrame
+    {
+        uint64_t frameNumber = 0;
+        VkExtent2D extent{};
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<uint8_t> pixels;
+    };
+
+    // One host visible buffer per frame in flight. The copy is recorded into the frame's own command
+    // buffer and the buffer is only read after the renderer has waited on that frame's fence, so taking
+    // a readback every frame never stalls. Consumers run on the thread pool; when they fall behind
+    // frames are dropped instead of blocking the render loop.
+    class FrameReadback
+    {
+    public:
+        using Consumer = std::function<void(const ReadbackFrame &)>;
+
+        FrameReadback(Device &device, ThreadPool &threadPool, uint32_t framesInFlight, VkExtent2D extent, VkFormat format, uint32_t maxPendingTasks = 4);
+        ~FrameReadback();
+        FrameReadback(const FrameReadback &) = delete;
+        FrameReadback &operator=(const FrameReadback &) = delete;
+
+        inline uint64_t GetDroppedFrameCount() const { return m_DroppedFrames; }
+
+        // called on a pool worker for every frame read back
+        void SetConsumer(Consumer consumer);
+        // collects the slot's previous copy, call once its fence has been waited, i.e. after Renderer::BeginFrame
+        void Collect(uint32_t frameIndex);
+        // records the copy of an image in TRANSFER_SRC_OPTIMAL, outside of a render pass
+        void Record(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, uint64_t frameNumber);
+        // collects every slot and waits for the consumers, the device must be idle
+        void Flush();
+
+        // .tga is written run-length encoded, anything else as binary PPM
+        static void WriteImage(const ReadbackFrame &frame, const std::string &path);
+        static bool ReadPPM(const std::string &path, ReadbackFrame &frame);
+        // counts pixels whose channels differ by more than tolerance, ignoring alpha
+        static uint64_t CountMismatchedPixels(const ReadbackFrame &frame, const ReadbackFrame &reference, uint8_t tolerance);
+
+    private:
+        struct Slot
+        {
+            std::unique_ptr<Buffer> up_Buffer;
+            bool pending = false;
+            uint64_t frameNumber = 0;
+        };
+
+        void Dispatch(std::shared_ptr<ReadbackFrame> sp_Frame);
+
+    private:
+        Device &r_Device;
+        ThreadPool &r_ThreadPool;
+        VkExtent2D m_Extent;
+        VkFormat m_Format;
+        uint32_t m_MaxPendingTasks;
+        std::vector<Slot> m_Slots;
+        Consumer m_Consumer;
+        std::deque<std::future<void>> m_PendingTasks;
+        std::atomic<uint64_t> m_DroppedFrames{0};
+    };
+}
+
+#endif
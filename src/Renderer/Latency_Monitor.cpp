@@ -0,0 +1,140 @@
+#include "Latency_Monitor.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Divine
+{
+    // short enough that DrainSwapChain never blocks for long
+    static constexpr uint64_t s_PresentWaitTimeoutNs = 10'000'000;
+
+    LatencyMonitor::LatencyMonitor(Device &device, uint32_t historySize)
+        : r_Device{device}, m_History{historySize}
+    {
+        if (r_Device.IsExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+            m_WaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(r_Device.GetDevice(), "vkWaitForPresentKHR"));
+
+        if (IsUsingPresentWait())
+            m_Waiter = std::thread(&LatencyMonitor::WaiterLoop, this);
+    }
+
+    LatencyMonitor::~LatencyMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Condition.notify_all();
+
+        if (m_Waiter.joinable())
+            m_Waiter.join();
+    }
+
+    void LatencyMonitor::MarkInputSample()
+    {
+        m_InputTime = Clock::now();
+        m_HasInputSample = true;
+    }
+
+    uint64_t LatencyMonitor::NextPresentID()
+    {
+        return IsUsingPresentWait() ? m_NextPresentID++ : 0;
+    }
+
+    void LatencyMonitor::OnPresented(VkSwapchainKHR swapChain, uint64_t presentID)
+    {
+        if (!m_HasInputSample)
+            return;
+        m_HasInputSample = false;
+
+        if (presentID == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            AddSample(m_InputTime, Clock::now());
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Pending.push_back(PendingPresent{swapChain, presentID, m_InputTime});
+        }
+        m_Condition.notify_all();
+    }
+
+    void LatencyMonitor::DrainSwapChain(VkSwapchainKHR swapChain)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Pending.erase(std::remove_if(m_Pending.begin(), m_Pending.end(),
+                                       [swapChain](const PendingPresent &pending)
+                                       { return pending.swapChain == swapChain; }),
+                        m_Pending.end());
+        m_Condition.wait(lock, [this, swapChain]()
+                         { return m_WaitingSwapChain != swapChain; });
+    }
+
+    void LatencyMonitor::WaiterLoop()
+    {
+        while (true)
+        {
+            PendingPresent pending;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]()
+                                 { return m_Stop || !m_Pending.empty(); });
+                if (m_Stop)
+                    return;
+
+                pending = m_Pending.front();
+                m_WaitingSwapChain = pending.swapChain;
+            }
+
+            VkResult result = m_WaitForPresent(r_Device.GetDevice(), pending.swapChain, pending.presentID, s_PresentWaitTimeoutNs);
+            auto presentTime = Clock::now();
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_WaitingSwapChain = VK_NULL_HANDLE;
+
+                // on timeout the entry stays queued, unless DrainSwapChain removed it meanwhile
+                bool stillQueued = !m_Pending.empty() &&
+                                   m_Pending.front().swapChain == pending.swapChain &&
+                                   m_Pending.front().presentID == pending.presentID;
+                if (result != VK_TIMEOUT && stillQueued)
+                {
+                    m_Pending.pop_front();
+                    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+                        AddSample(pending.inputTime, presentTime);
+                }
+            }
+            m_Condition.notify_all();
+        }
+    }
+
+    void LatencyMonitor::AddSample(Clock::time_point inputTime, Clock::time_point presentTime)
+    {
+        m_History.Add(std::chrono::duration<float, std::milli>(presentTime - inputTime).count());
+    }
+
+    bool LatencyMonitor::GetStats(LatencyStats &stats) const
+    {
+        // sorting the copy does not need to hold up the waiter thread
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        SampleHistory history = m_History;
+        lock.unlock();
+
+        return history.GetStats(stats);
+    }
+
+    void LatencyMonitor::Report(std::ostream &os) const
+    {
+        LatencyStats stats{};
+        if (!GetStats(stats))
+            return;
+
+        os << "\tInput to " << (IsUsingPresentWait() ? "present" : "present call") << " latency (min / avg / p99 ms): "
+           << std::fixed << std::setprecision(3)
+           << stats.minMs << " / " << stats.avgMs << " / " << stats.p99Ms
+           << "  (" << stats.sampleCount << " samples)" << std::endl;
+        os.unsetf(std::ios::fixed);
+    }
+}
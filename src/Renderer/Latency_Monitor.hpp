@@ -0,0 +1,73 @@
+#ifndef LATENCY_MONITOR_HEADER
+#define LATENCY_MONITOR_HEADER
+
+#include "Device.hpp"
+#include "Sample_History.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace Divine
+{
+    using LatencyStats = TimingStats;
+
+    // Input-to-present latency. With VK_KHR_present_wait a waiter thread timestamps the moment each
+    // tagged present is shown; without it the sample ends when vkQueuePresentKHR returns, which only
+    // covers the CPU side of the frame.
+    class LatencyMonitor
+    {
+    public:
+        LatencyMonitor(Device &device, uint32_t historySize = 256);
+        ~LatencyMonitor();
+        LatencyMonitor(const LatencyMonitor &) = delete;
+        LatencyMonitor &operator=(const LatencyMonitor &) = delete;
+
+        inline bool IsUsingPresentWait() const { return m_WaitForPresent != nullptr; }
+
+        // call right after the input of the next frame has been polled
+        void MarkInputSample();
+        // returns the id to tag the next present with, 0 when presents are not tagged
+        uint64_t NextPresentID();
+        void OnPresented(VkSwapchainKHR swapChain, uint64_t presentID);
+        // drops pending presents of a swap chain that is about to be destroyed
+        void DrainSwapChain(VkSwapchainKHR swapChain);
+
+        bool GetStats(LatencyStats &stats) const;
+        void Report(std::ostream &os) const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct PendingPresent
+        {
+            VkSwapchainKHR swapChain;
+            uint64_t presentID;
+            Clock::time_point inputTime;
+        };
+
+        void WaiterLoop();
+        void AddSample(Clock::time_point inputTime, Clock::time_point presentTime);
+
+    private:
+        Device &r_Device;
+        PFN_vkWaitForPresentKHR m_WaitForPresent = nullptr;
+        uint64_t m_NextPresentID = 1;
+        Clock::time_point m_InputTime;
+        bool m_HasInputSample = false;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque<PendingPresent> m_Pending;
+        VkSwapchainKHR m_WaitingSwapChain = VK_NULL_HANDLE;
+        bool m_Stop = false;
+        std::thread m_Waiter;
+
+        SampleHistory m_History;
+    };
+}
+
+#endif
@@ -2,19 +2,28 @@
 
 #include <iostream>
 #include <stdexcept>
-#include <array>
 
 namespace Divine
 {
-    Renderer::Renderer(Window &window, Device &device)
-        : r_Window{window}, r_Device{device}
+    Renderer::Renderer(Window &window, Device &device, const SwapChainConfig &config)
+        : r_Window{window}, r_Device{device}, m_Config{config}
     {
-        RecreateSwapChain();
+        if (r_Window.IsHeadless())
+            up_OffscreenTarget = std::make_unique<OffscreenTarget>(r_Device, r_Window.GetExtent(), m_Config.framesInFlight);
+        else
+        {
+            up_LatencyMonitor = std::make_unique<LatencyMonitor>(r_Device);
+            RecreateSwapChain();
+        }
         CreateCommandBuffers();
     }
 
     Renderer::~Renderer()
     {
+        WaitIdle();
+
+        if (up_SwapChain != nullptr)
+            up_LatencyMonitor->DrainSwapChain(up_SwapChain->GetSwapChain());
         FreeCommandBuffers();
     }
 
@@ -28,23 +37,50 @@ namespace Divine
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(r_Device.GetDevice());
-
         if (up_SwapChain == nullptr)
-            up_SwapChain = std::make_unique<SwapChain>(r_Device, extent);
+            up_SwapChain = std::make_unique<SwapChain>(r_Device, extent, m_Config);
         else
         {
             std::shared_ptr<SwapChain> oldSwapChain = std::move(up_SwapChain);
-            up_SwapChain = std::make_unique<SwapChain>(r_Device, extent, oldSwapChain);
+            up_SwapChain = std::make_unique<SwapChain>(r_Device, extent, m_Config, oldSwapChain);
 
             if (!oldSwapChain->CompareSwapFormats(*up_SwapChain.get()))
                 throw std::runtime_error("SwapChain image or depth format has changed!");
+
+            // frames in flight may still render to the old images, they are released once those frames retire
+            EnqueueDeferredDeletion([this, oldSwapChain]() mutable
+                                    {
+                                        up_LatencyMonitor->DrainSwapChain(oldSwapChain->GetSwapChain());
+                                        oldSwapChain = nullptr; });
+        }
+
+        ++m_TargetGeneration;
+    }
+
+    void Renderer::EnqueueDeferredDeletion(std::function<void()> deletion)
+    {
+        // frame m_FrameNumber - 1 is the last one submitted, its fence is waited framesInFlight - 1 frames later
+        m_DeferredDeletions.push_back(DeferredDeletion{m_FrameNumber + m_Config.framesInFlight - 1, std::move(deletion)});
+    }
+
+    void Renderer::WaitIdle()
+    {
+        vkDeviceWaitIdle(r_Device.GetDevice());
+        FlushDeferredDeletions(true);
+    }
+
+    void Renderer::FlushDeferredDeletions(bool all)
+    {
+        while (!m_DeferredDeletions.empty() && (all || m_DeferredDeletions.front().retireFrame <= m_FrameNumber))
+        {
+            m_DeferredDeletions.front().deletion();
+            m_DeferredDeletions.pop_front();
         }
     }
 
     void Renderer::CreateCommandBuffers()
     {
-        m_CommandBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        m_CommandBuffers.resize(m_Config.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -72,7 +108,8 @@ namespace Divine
         assert(!m_IsFrameStart &&
                "Can't call BeginFrame while already in progress");
 
-        auto result = up_SwapChain->AcquireNextImage(&m_CurrentImageIndex);
+        auto result = IsHeadless() ? up_OffscreenTarget->AcquireNextImage(&m_CurrentImageIndex)
+                                   : up_SwapChain->AcquireNextImage(&m_CurrentImageIndex);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
@@ -83,6 +120,10 @@ namespace Divine
         if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
             throw std::runtime_error("Failed to acquire swap chain image!");
 
+        // the acquire waited on the fence of frame m_FrameNumber - framesInFlight
+        FlushDeferredDeletions(false);
+        ++m_FrameNumber;
+
         m_IsFrameStart = true;
 
         auto commandBuffer = GetCurrentCommandBuffer();
@@ -107,7 +148,17 @@ namespace Divine
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
             throw std::runtime_error("Failed to end command buffer!");
 
-        auto result = up_SwapChain->SubmitCommandBuffers(&commandBuffer, &m_CurrentImageIndex);
+        if (IsHeadless())
+        {
+            up_OffscreenTarget->SubmitCommandBuffers(&commandBuffer, &m_CurrentImageIndex);
+            m_IsFrameStart = false;
+            m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % m_Config.framesInFlight;
+            return;
+        }
+
+        uint64_t presentID = up_LatencyMonitor->NextPresentID();
+        auto result = up_SwapChain->SubmitCommandBuffers(&commandBuffer, &m_CurrentImageIndex, presentID);
+        up_LatencyMonitor->OnPresented(up_SwapChain->GetSwapChain(), presentID);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || r_Window.WasFrameBufferResizd())
         {
@@ -118,57 +169,7 @@ namespace Divine
             throw std::runtime_error("Failed to present swap chain image!");
 
         m_IsFrameStart = false;
-        m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
-    }
-
-    void Renderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
-    {
-        assert(m_IsFrameStart &&
-               "Can't call BeginSwapChainRenderPass when frame not in progress");
-        assert(commandBuffer == m_CommandBuffers[m_CurrentFrameIndex] &&
-               "Can't begin render pass on command buffer from a different frame");
-
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = up_SwapChain->GetRenderPass();
-        renderPassInfo.framebuffer = up_SwapChain->GetFrameBuffer(m_CurrentImageIndex);
-
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = up_SwapChain->GetSwapChainImageExtent();
-
-        std::array<VkClearValue, 2> clearValues = {};
-        clearValues[0].color = {0.1f, 0.1f, 0.1f, 1.0f};
-        clearValues[1].depthStencil = {1.0f, 0};
-
-        renderPassInfo.clearValueCount = 2;
-        renderPassInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(up_SwapChain->GetWidth());
-        viewport.height = static_cast<float>(up_SwapChain->GetHeight());
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = {up_SwapChain->GetWidth(), up_SwapChain->GetHeight()};
-
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-    }
-
-    void Renderer::EndSwapChainRenderPass(VkCommandBuffer commandBuffer)
-    {
-        assert(m_IsFrameStart &&
-               "Can't call EndSwapChainRenderPass when frame not in progress");
-        assert(commandBuffer == m_CommandBuffers[m_CurrentFrameIndex] &&
-               "Can't end render pass on command buffer from a different frame");
-
-        vkCmdEndRenderPass(commandBuffer);
+        m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % m_Config.framesInFlight;
     }
 
 }
\ No newline at end of file
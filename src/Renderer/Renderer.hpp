@@ -4,8 +4,12 @@
 #include "Window.hpp"
 #include "Device.hpp"
 #include "SwapChain.hpp"
+#include "Offscreen_Target.hpp"
+#include "Latency_Monitor.hpp"
 
 #include <memory>
+#include <functional>
+#include <deque>
 #include <assert.h>
 
 namespace Divine
@@ -13,7 +17,7 @@ namespace Divine
     class Renderer
     {
     public:
-        Renderer(Window &window, Device &device);
+        Renderer(Window &window, Device &device, const SwapChainConfig &config = SwapChainConfig{});
         ~Renderer();
         Renderer(const Renderer &) = delete;
         Renderer &operator=(const Renderer &) = delete;
@@ -31,27 +35,72 @@ namespace Divine
                    "Can't get frame index when frame not in progress");
             return m_CurrentFrameIndex;
         }
-        inline VkRenderPass GetSwapChainRenderPass() const { return up_SwapChain->GetRenderPass(); }
-        inline float GetAspectRatio() const { return up_SwapChain->GetExtentAspectRatio(); }
+        inline bool IsHeadless() const { return up_OffscreenTarget != nullptr; }
+        inline uint32_t GetFramesInFlight() const { return m_Config.framesInFlight; }
+        // null when headless, there is nothing presented to measure
+        inline const LatencyMonitor *GetLatencyMonitor() const { return up_LatencyMonitor.get(); }
+        inline void MarkInputSample()
+        {
+            if (up_LatencyMonitor != nullptr)
+                up_LatencyMonitor->MarkInputSample();
+        }
+        // never begun, the render graph records the frame. Pipelines drawing to the scene pass are created against it
+        inline VkRenderPass GetSwapChainRenderPass() const { return IsHeadless() ? up_OffscreenTarget->GetRenderPass() : up_SwapChain->GetRenderPass(); }
+        inline float GetAspectRatio() const { return IsHeadless() ? up_OffscreenTarget->GetExtentAspectRatio() : up_SwapChain->GetExtentAspectRatio(); }
+        inline VkExtent2D GetRenderExtent() const { return IsHeadless() ? up_OffscreenTarget->GetImageExtent() : up_SwapChain->GetSwapChainImageExtent(); }
 
+        // targets of the current frame, for render graphs importing them
+        inline uint32_t GetImageCount() const { return static_cast<uint32_t>(IsHeadless() ? up_OffscreenTarget->GetImageCount() : up_SwapChain->GetSwapChainImageCount()); }
+        inline uint32_t GetCurrentImageIndex() const { return m_CurrentImageIndex; }
+        inline VkImage GetCurrentColorImage() const { return IsHeadless() ? up_OffscreenTarget->GetColorImage(m_CurrentImageIndex) : up_SwapChain->GetSwapChainImage(m_CurrentImageIndex); }
+        inline VkImageView GetCurrentColorImageView() const { return IsHeadless() ? up_OffscreenTarget->GetColorImageView(m_CurrentImageIndex) : up_SwapChain->GetSwapChainImageView(m_CurrentImageIndex); }
+        inline VkFormat GetColorFormat() const { return IsHeadless() ? up_OffscreenTarget->GetImageFormat() : up_SwapChain->GetSwapChainImageFormat(); }
+        inline VkImageUsageFlags GetColorUsage() const { return IsHeadless() ? up_OffscreenTarget->GetImageUsage() : up_SwapChain->GetSwapChainImageUsage(); }
+        inline VkFormat GetDepthFormat() const { return IsHeadless() ? up_OffscreenTarget->GetDepthFormat() : up_SwapChain->GetSwapChainDepthFormat(); }
+        inline VkImage GetDepthImage() const { return IsHeadless() ? up_OffscreenTarget->GetDepthImage() : up_SwapChain->GetDepthImage(); }
+        inline VkImageView GetDepthImageView() const { return IsHeadless() ? up_OffscreenTarget->GetDepthImageView() : up_SwapChain->GetDepthImageView(); }
+        // layout the color target has to be in once the frame ends: presented, or read back when headless
+        inline VkImageLayout GetFinalColorLayout() const { return IsHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+        // bumped whenever the targets are recreated, anything built against them has to be rebuilt
+        inline uint64_t GetTargetGeneration() const { return m_TargetGeneration; }
+
+        // waits on the fence of the frame index's slot, so once it returns everything a system keeps
+        // per frame index is no longer read by the GPU and can be rewritten or replaced right away
         VkCommandBuffer BeginFrame();
         void EndFrame();
-        void BeginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-        void EndSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+        // runs once every frame submitted so far has retired, for resources that may still be in flight
+        void EnqueueDeferredDeletion(std::function<void()> deletion);
+        // drains the device and runs every deferred deletion
+        void WaitIdle();
 
     private:
         void RecreateSwapChain();
         void CreateCommandBuffers();
         void FreeCommandBuffers();
+        void FlushDeferredDeletions(bool all);
+
+    private:
+        struct DeferredDeletion
+        {
+            uint64_t retireFrame;
+            std::function<void()> deletion;
+        };
 
     private:
         Window &r_Window;
         Device &r_Device;
+        SwapChainConfig m_Config;
         std::unique_ptr<SwapChain> up_SwapChain;
+        std::unique_ptr<OffscreenTarget> up_OffscreenTarget;
+        std::unique_ptr<LatencyMonitor> up_LatencyMonitor;
         std::vector<VkCommandBuffer> m_CommandBuffers;
         uint32_t m_CurrentImageIndex;
         uint32_t m_CurrentFrameIndex = 0;
+        uint64_t m_FrameNumber = 0;
+        uint64_t m_TargetGeneration = 0;
         bool m_IsFrameStart = false;
+        std::deque<DeferredDeletion> m_DeferredDeletions;
     };
 }
 
@@ -0,0 +1,78 @@
+#include "Resolution_Scaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace Divine
+{
+    // weight of the newest sample in the smoothed frame time
+    static constexpr float s_SmoothingFactor = 0.2f;
+    // largest increase per step, growing is cautious since overshooting costs a missed frame
+    static constexpr float s_MaxScaleUpStep = 0.05f;
+
+    ResolutionScaler::ResolutionScaler(const ResolutionScalerConfig &config)
+        : m_Config{config}, m_Scale{config.maxScale}
+    {
+    }
+
+    float ResolutionScaler::Update(float gpuFrameMs)
+    {
+        if (!IsEnabled() || gpuFrameMs <= 0.0f)
+            return m_Scale;
+
+        m_SmoothedMs = m_SmoothedMs == 0.0f ? gpuFrameMs : m_SmoothedMs + s_SmoothingFactor * (gpuFrameMs - m_SmoothedMs);
+        m_ScaleSum += m_Scale;
+        ++m_UpdateCount;
+
+        if (++m_FramesSinceChange < m_Config.settleFrames)
+            return m_Scale;
+
+        // GPU time follows the pixel count, which goes with the square of the scale, aim for the middle of the band
+        float fitMs = m_Config.targetFrameMs * 0.5f * (m_Config.upperThreshold + m_Config.lowerThreshold);
+        float fitScale = m_Scale * std::sqrt(fitMs / m_SmoothedMs);
+        float newScale = m_Scale;
+        if (m_SmoothedMs > m_Config.targetFrameMs * m_Config.upperThreshold)
+        {
+            m_FramesUnderBudget = 0;
+            newScale = fitScale;
+        }
+        else if (m_SmoothedMs < m_Config.targetFrameMs * m_Config.lowerThreshold)
+        {
+            if (++m_FramesUnderBudget >= m_Config.settleFrames)
+                newScale = std::min(fitScale, m_Scale + s_MaxScaleUpStep);
+        }
+        else
+            m_FramesUnderBudget = 0;
+
+        newScale = std::clamp(newScale, m_Config.minScale, m_Config.maxScale);
+        if (std::abs(newScale - m_Scale) > 0.005f)
+        {
+            m_Scale = newScale;
+            m_FramesSinceChange = 0;
+            m_FramesUnderBudget = 0;
+            ++m_ScaleChanges;
+        }
+
+        return m_Scale;
+    }
+
+    VkExtent2D ResolutionScaler::GetScaledExtent(VkExtent2D extent) const
+    {
+        VkExtent2D scaled{};
+        scaled.width = std::max(1u, static_cast<uint32_t>(std::lround(extent.width * m_Scale)));
+        scaled.height = std::max(1u, static_cast<uint32_t>(std::lround(extent.height * m_Scale)));
+        return scaled;
+    }
+
+    void ResolutionScaler::Report(std::ostream &os) const
+    {
+        if (!IsEnabled())
+            return;
+
+        os << "\tResolution scale: " << std::fixed << std::setprecision(2)
+           << m_Scale << " final, " << (m_UpdateCount > 0 ? m_ScaleSum / m_UpdateCount : m_Scale) << " average, "
+           << m_ScaleChanges << " changes (target " << m_Config.targetFrameMs << " ms)" << std::endl;
+        os.unsetf(std::ios::fixed);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef RESOLUTION_SCALER_HEADER
+#define RESOLUTION_SCALER_HEADER
+
+#include "Device.hpp"
+
+#include <ostream>
+
+namespace Divine
+{
+    struct ResolutionScalerConfig
+    {
+        float targetFrameMs = 0.0f; // GPU budget per frame, 0 disables scaling
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        float upperThreshold = 0.95f; // scale down once the smoothed GPU time exceeds this fraction of the budget
+        float lowerThreshold = 0.80f; // scale up only while it stays below this fraction
+        uint32_t settleFrames = 8;    // frames to hold a new scale, timestamps lag behind by the frames in flight
+    };
+
+    // Picks the render scale of the next frame from measured GPU frame times. Scaling down reacts at once
+    // and jumps to the scale expected to fit the budget, scaling up creeps back in small steps after the
+    // frame time has stayed well under budget, so the two thresholds keep the scale from oscillating.
+    class ResolutionScaler
+    {
+    public:
+        ResolutionScaler(const ResolutionScalerConfig &config);
+
+        inline bool IsEnabled() const { return m_Config.targetFrameMs > 0.0f; }
+        inline float GetScale() const { return m_Scale; }
+
+        // feeds the latest resolved GPU frame time, returns the scale to render the next frame at
+        float Update(float gpuFrameMs);
+        VkExtent2D GetScaledExtent(VkExtent2D extent) const;
+        void Report(std::ostream &os) const;
+
+    private:
+        ResolutionScalerConfig m_Config;
+        float m_Scale;
+        float m_SmoothedMs = 0.0f;
+        uint32_t m_FramesSinceChange = 0;
+        uint32_t m_FramesUnderBudget = 0;
+        uint32_t m_ScaleChanges = 0;
+        float m_ScaleSum = 0.0f;
+        uint32_t m_UpdateCount = 0;
+    };
+}
+
+#endif
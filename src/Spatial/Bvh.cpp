@@ -0,0 +1,462 @@
+#include "Bvh.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <limits>
+
+namespace Divine
+{
+    // subtrees below this many leaves are built by one pool task
+    static constexpr uint32_t s_ParallelBuildLeaves = 2048;
+    static constexpr uint32_t s_SahBinCount = 16;
+
+    struct Bvh::BuildContext
+    {
+        std::vector<uint32_t> slots; // free nodes reserved for the inner nodes
+        std::atomic<uint32_t> nextSlot{0};
+        std::vector<uint32_t> topNodes; // inner nodes built on the caller, parents before children
+        std::vector<BuildTask> tasks;
+
+        inline uint32_t AllocateSlot() { return slots[nextSlot.fetch_add(1, std::memory_order_relaxed)]; }
+    };
+
+    Bvh::Bvh(float margin)
+        : m_Margin{margin}
+    {
+    }
+
+    uint32_t Bvh::AllocateNode()
+    {
+        if (m_FreeList == s_NullNode)
+        {
+            m_Nodes.emplace_back();
+            return static_cast<uint32_t>(m_Nodes.size() - 1);
+        }
+
+        uint32_t node = m_FreeList;
+        m_FreeList = m_Nodes[node].parent;
+        m_Nodes[node] = Node{};
+        return node;
+    }
+
+    void Bvh::FreeNode(uint32_t node)
+    {
+        m_Nodes[node].parent = m_FreeList;
+        m_Nodes[node].height = -1;
+        m_FreeList = node;
+    }
+
+    uint32_t Bvh::Insert(const Aabb &box, uint32_t userData)
+    {
+        uint32_t leaf = AllocateNode();
+        Node &node = m_Nodes[leaf];
+        node.box = {box.min - glm::vec3(m_Margin), box.max + glm::vec3(m_Margin)};
+        node.userData = userData;
+        node.height = 0;
+
+        InsertLeaf(leaf);
+        ++m_LeafCount;
+        return leaf;
+    }
+
+    void Bvh::Remove(uint32_t proxy)
+    {
+        assert(proxy < m_Nodes.size() && m_Nodes[proxy].height == 0 && "Proxy is not a leaf");
+        RemoveLeaf(proxy);
+        FreeNode(proxy);
+        --m_LeafCount;
+    }
+
+    bool Bvh::Move(uint32_t proxy, const Aabb &box)
+    {
+        assert(proxy < m_Nodes.size() && m_Nodes[proxy].height == 0 && "Proxy is not a leaf");
+        if (m_Nodes[proxy].box.Contains(box))
+            return false;
+
+        RemoveLeaf(proxy);
+        m_Nodes[proxy].box = {box.min - glm::vec3(m_Margin), box.max + glm::vec3(m_Margin)};
+        InsertLeaf(proxy);
+        return true;
+    }
+
+    void Bvh::InsertLeaf(uint32_t leaf)
+    {
+        if (m_Root == s_NullNode)
+        {
+            m_Root = leaf;
+            m_Nodes[leaf].parent = s_NullNode;
+            return;
+        }
+
+        // descend towards the sibling that grows the tree's surface area the least, the inherited
+        // cost is what every ancestor of the new node pays for its larger box
+        const Aabb leafBox = m_Nodes[leaf].box;
+        uint32_t index = m_Root;
+        while (!m_Nodes[index].IsLeaf())
+        {
+            const Node &node = m_Nodes[index];
+            float area = node.box.GetSurfaceArea();
+            float combinedArea = Aabb::Union(node.box, leafBox).GetSurfaceArea();
+
+            float cost = 2.0f * combinedArea;
+            float inheritedCost = 2.0f * (combinedArea - area);
+
+            float childCosts[2];
+            for (int i = 0; i < 2; ++i)
+            {
+                const Node &child = m_Nodes[node.children[i]];
+                float childArea = Aabb::Union(child.box, leafBox).GetSurfaceArea();
+                if (!child.IsLeaf())
+                    childArea -= child.box.GetSurfaceArea();
+                childCosts[i] = childArea + inheritedCost;
+            }
+
+            if (cost < childCosts[0] && cost < childCosts[1])
+                break;
+            index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+        }
+
+        uint32_t sibling = index;
+        uint32_t oldParent = m_Nodes[sibling].parent;
+        uint32_t newParent = AllocateNode();
+        m_Nodes[newParent].parent = oldParent;
+        m_Nodes[newParent].box = Aabb::Union(leafBox, m_Nodes[sibling].box);
+        m_Nodes[newParent].height = m_Nodes[sibling].height + 1;
+
+        if (oldParent != s_NullNode)
+            LinkChild(oldParent, m_Nodes[oldParent].children[0] == sibling ? 0 : 1, newParent);
+        else
+        {
+            m_Root = newParent;
+            m_Nodes[newParent].parent = s_NullNode;
+        }
+        LinkChild(newParent, 0, sibling);
+        LinkChild(newParent, 1, leaf);
+
+        Refit(m_Nodes[leaf].parent);
+    }
+
+    void Bvh::RemoveLeaf(uint32_t leaf)
+    {
+        if (leaf == m_Root)
+        {
+            m_Root = s_NullNode;
+            return;
+        }
+
+        uint32_t parent = m_Nodes[leaf].parent;
+        uint32_t grandParent = m_Nodes[parent].parent;
+        uint32_t sibling = m_Nodes[parent].children[0] == leaf ? m_Nodes[parent].children[1] : m_Nodes[parent].children[0];
+
+        if (grandParent != s_NullNode)
+        {
+            LinkChild(grandParent, m_Nodes[grandParent].children[0] == parent ? 0 : 1, sibling);
+            FreeNode(parent);
+            Refit(grandParent);
+        }
+        else
+        {
+            m_Root = sibling;
+            m_Nodes[sibling].parent = s_NullNode;
+            FreeNode(parent);
+        }
+    }
+
+    void Bvh::LinkChild(uint32_t parent, uint32_t childIndex, uint32_t child)
+    {
+        m_Nodes[parent].children[childIndex] = child;
+        m_Nodes[child].parent = parent;
+    }
+
+    void Bvh::Refit(uint32_t node)
+    {
+        // rebalance and refit every ancestor up to the root
+        while (node != s_NullNode)
+        {
+            node = Balance(node);
+
+            Node &current = m_Nodes[node];
+            const Node &left = m_Nodes[current.children[0]];
+            const Node &right = m_Nodes[current.children[1]];
+            current.height = 1 + std::max(left.height, right.height);
+            current.box = Aabb::Union(left.box, right.box);
+
+            node = current.parent;
+        }
+    }
+
+    uint32_t Bvh::Balance(uint32_t a)
+    {
+        // AVL rotation, the taller grandchild of the taller child takes A's place in that child
+        Node &nodeA = m_Nodes[a];
+        if (nodeA.IsLeaf() || nodeA.height < 2)
+            return a;
+
+        uint32_t b = nodeA.children[0];
+        uint32_t c = nodeA.children[1];
+        int32_t balance = m_Nodes[c].height - m_Nodes[b].height;
+        if (balance >= -1 && balance <= 1)
+            return a;
+
+        // the taller child rotates up, the shorter one stays below A
+        uint32_t up = balance > 1 ? c : b;
+        uint32_t stay = balance > 1 ? b : c;
+        uint32_t upSlot = balance > 1 ? 1 : 0;
+        Node &nodeUp = m_Nodes[up];
+
+        uint32_t f = nodeUp.children[0];
+        uint32_t g = nodeUp.children[1];
+
+        // A's parent now points to the rotated child
+        nodeUp.children[0] = a;
+        nodeUp.parent = nodeA.parent;
+        nodeA.parent = up;
+        if (nodeUp.parent != s_NullNode)
+        {
+            Node &parent = m_Nodes[nodeUp.parent];
+            parent.children[parent.children[0] == a ? 0 : 1] = up;
+        }
+        else
+            m_Root = up;
+
+        // the taller grandchild stays with the rotated child, the other one moves under A
+        uint32_t keep = m_Nodes[f].height > m_Nodes[g].height ? f : g;
+        uint32_t move = keep == f ? g : f;
+        nodeUp.children[1] = keep;
+        LinkChild(a, upSlot, move);
+
+        nodeA.box = Aabb::Union(m_Nodes[stay].box, m_Nodes[move].box);
+        nodeA.height = 1 + std::max(m_Nodes[stay].height, m_Nodes[move].height);
+        nodeUp.box = Aabb::Union(nodeA.box, m_Nodes[keep].box);
+        nodeUp.height = 1 + std::max(nodeA.height, m_Nodes[keep].height);
+        return up;
+    }
+
+    float Bvh::GetCost() const
+    {
+        if (m_Root == s_NullNode || m_Nodes[m_Root].IsLeaf())
+            return 0.0f;
+
+        float area = 0.0f;
+        for (const Node &node : m_Nodes)
+            if (node.height > 0)
+                area += node.box.GetSurfaceArea();
+        return area / m_Nodes[m_Root].box.GetSurfaceArea();
+    }
+
+    uint32_t Bvh::SplitSah(BuildItem *pItems, uint32_t count) const
+    {
+        if (count <= 2)
+            return count / 2;
+
+        Aabb centroidBounds{pItems[0].centroid, pItems[0].centroid};
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            centroidBounds.min = glm::min(centroidBounds.min, pItems[i].centroid);
+            centroidBounds.max = glm::max(centroidBounds.max, pItems[i].centroid);
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            uint32_t counts[s_SahBinCount] = {};
+            Aabb bounds[s_SahBinCount];
+            float scale = s_SahBinCount / extent;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint32_t bin = std::min(static_cast<uint32_t>((pItems[i].centroid[axis] - centroidBounds.min[axis]) * scale), s_SahBinCount - 1);
+                const Aabb &box = m_Nodes[pItems[i].node].box;
+                bounds[bin] = counts[bin] == 0 ? box : Aabb::Union(bounds[bin], box);
+                ++counts[bin];
+            }
+
+            // sweep from the right to collect suffix areas, then from the left to evaluate each plane
+            float rightAreas[s_SahBinCount];
+            uint32_t rightCounts[s_SahBinCount];
+            Aabb accumulated{};
+            uint32_t accumulatedCount = 0;
+            for (uint32_t bin = s_SahBinCount - 1; bin > 0; --bin)
+            {
+                if (counts[bin] > 0)
+                    accumulated = accumulatedCount == 0 ? bounds[bin] : Aabb::Union(accumulated, bounds[bin]);
+                accumulatedCount += counts[bin];
+                rightAreas[bin] = accumulatedCount > 0 ? accumulated.GetSurfaceArea() : 0.0f;
+                rightCounts[bin] = accumulatedCount;
+            }
+
+            accumulatedCount = 0;
+            for (uint32_t bin = 0; bin < s_SahBinCount - 1; ++bin)
+            {
+                if (counts[bin] > 0)
+                    accumulated = accumulatedCount == 0 ? bounds[bin] : Aabb::Union(accumulated, bounds[bin]);
+                accumulatedCount += counts[bin];
+                if (accumulatedCount == 0 || rightCounts[bin + 1] == 0)
+                    continue;
+
+                float cost = accumulated.GetSurfaceArea() * accumulatedCount + rightAreas[bin + 1] * rightCounts[bin + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        // coincident centroids, any split is as good as another
+        if (bestAxis < 0)
+            return count / 2;
+
+        float scale = s_SahBinCount / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+        float origin = centroidBounds.min[bestAxis];
+        BuildItem *pMiddle = std::partition(pItems, pItems + count, [&](const BuildItem &item)
+                                            { return std::min(static_cast<uint32_t>((item.centroid[bestAxis] - origin) * scale), s_SahBinCount - 1) <= bestBin; });
+        uint32_t split = static_cast<uint32_t>(pMiddle - pItems);
+        return split == 0 || split == count ? count / 2 : split;
+    }
+
+    uint32_t Bvh::BuildSubtree(BuildItem *pItems, uint32_t count, BuildContext &context)
+    {
+        if (count == 1)
+            return pItems[0].node;
+
+        uint32_t split = SplitSah(pItems, count);
+        uint32_t node = context.AllocateSlot();
+        uint32_t left = BuildSubtree(pItems, split, context);
+        uint32_t right = BuildSubtree(pItems + split, count - split, context);
+
+        Node &current = m_Nodes[node];
+        current = Node{};
+        LinkChild(node, 0, left);
+        LinkChild(node, 1, right);
+        current.box = Aabb::Union(m_Nodes[left].box, m_Nodes[right].box);
+        current.height = 1 + std::max(m_Nodes[left].height, m_Nodes[right].height);
+        return node;
+    }
+
+    void Bvh::BuildTopLevel(BuildItem *pItems, uint32_t count, uint32_t parent, uint32_t childIndex, BuildContext &context)
+    {
+        if (count < s_ParallelBuildLeaves)
+        {
+            context.tasks.push_back({pItems, count, parent, childIndex});
+            return;
+        }
+
+        uint32_t split = SplitSah(pItems, count);
+        uint32_t node = context.AllocateSlot();
+        m_Nodes[node] = Node{};
+        if (parent != s_NullNode)
+            LinkChild(parent, childIndex, node);
+        else
+            m_Root = node;
+        context.topNodes.push_back(node);
+
+        BuildTopLevel(pItems, split, node, 0, context);
+        BuildTopLevel(pItems + split, count - split, node, 1, context);
+    }
+
+    void Bvh::Rebuild(ThreadPool *pThreadPool)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        // inner nodes are thrown away, leaves keep their slots so proxies stay valid
+        std::vector<BuildItem> items;
+        items.reserve(m_LeafCount);
+        m_FreeList = s_NullNode;
+        for (uint32_t i = static_cast<uint32_t>(m_Nodes.size()); i-- > 0;)
+        {
+            if (m_Nodes[i].height == 0)
+                items.push_back({i, m_Nodes[i].box.GetCenter()});
+            else
+                FreeNode(i);
+        }
+
+        m_Root = s_NullNode;
+        uint32_t count = static_cast<uint32_t>(items.size());
+        if (count == 0)
+            return;
+        if (count == 1)
+        {
+            m_Root = items[0].node;
+            m_Nodes[m_Root].parent = s_NullNode;
+            return;
+        }
+
+        // n leaves need n - 1 inner nodes, reserved up front so tasks never grow the node array
+        BuildContext context{};
+        context.slots.reserve(count - 1);
+        while (context.slots.size() < count - 1)
+            context.slots.push_back(AllocateNode());
+
+        if (pThreadPool == nullptr || count < s_ParallelBuildLeaves)
+        {
+            m_Root = BuildSubtree(items.data(), count, context);
+            m_Nodes[m_Root].parent = s_NullNode;
+            return;
+        }
+
+        BuildTopLevel(items.data(), count, s_NullNode, 0, context);
+
+        std::vector<uint32_t> subtrees(context.tasks.size());
+        pThreadPool->ParallelFor(context.tasks.size(), 1, [&](size_t begin, size_t end)
+                                 {
+                                     for (size_t i = begin; i < end; ++i)
+                                         subtrees[i] = BuildSubtree(context.tasks[i].pItems, context.tasks[i].count, context); });
+
+        for (size_t i = 0; i < subtrees.size(); ++i)
+            LinkChild(context.tasks[i].parent, context.tasks[i].childIndex, subtrees[i]);
+
+        // children of the top nodes were filled in by the tasks, fit them bottom up
+        for (auto it = context.topNodes.rbegin(); it != context.topNodes.rend(); ++it)
+        {
+            Node &node = m_Nodes[*it];
+            const Node &left = m_Nodes[node.children[0]];
+            const Node &right = m_Nodes[node.children[1]];
+            node.box = Aabb::Union(left.box, right.box);
+            node.height = 1 + std::max(left.height, right.height);
+        }
+        m_Nodes[m_Root].parent = s_NullNode;
+    }
+
+    bool Bvh::IntersectRay(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, float &distance)
+    {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+
+        float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        distance = entry;
+        return entry <= exit;
+    }
+
+    float Bvh::DistanceSquared(const Aabb &box, const glm::vec3 &point)
+    {
+        glm::vec3 offset = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+        return glm::dot(offset, offset);
+    }
+
+    bool Bvh::RayCast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, BvhHit &hit) const
+    {
+        return RayCast(
+            origin, direction, maxDistance, [](uint32_t, float boxDistance, float)
+            { return boxDistance; },
+            hit);
+    }
+
+    bool Bvh::FindNearest(const glm::vec3 &point, float maxDistance, BvhHit &hit) const
+    {
+        return FindNearest(
+            point, maxDistance, [](uint32_t, float boxDistance)
+            { return boxDistance; },
+            hit);
+    }
+}
@@ -0,0 +1,317 @@
+#ifndef BVH_HEADER
+#define BVH_HEADER
+
+#include "Thread_Pool.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace Divine
+{
+    struct Aabb
+    {
+        glm::vec3 min{0.0f};
+        glm::vec3 max{0.0f};
+
+        inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+        inline glm::vec3 GetExtent() const { return (max - min) * 0.5f; }
+        inline float GetSurfaceArea() const
+        {
+            glm::vec3 size = max - min;
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+        inline bool Contains(const Aabb &other) const
+        {
+            return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+        }
+        inline bool Overlaps(const Aabb &other) const
+        {
+            return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+        }
+
+        static inline Aabb Union(const Aabb &a, const Aabb &b) { return {glm::min(a.min, b.min), glm::max(a.max, b.max)}; }
+    };
+
+    struct BvhHit
+    {
+        uint32_t userData = UINT32_MAX;
+        float distance = 0.0f;
+    };
+
+    // Dynamic AABB tree, one leaf per object. Leaves store their box grown by a margin so small moves
+    // leave the tree untouched, a leaf that leaves its fat box is reinserted at the cheapest sibling
+    // and the path to the root is rebalanced with AVL rotations. Rebuild replaces the inner nodes by a
+    // binned SAH build, run on the pool for large trees, which suits objects that stay where they are.
+    // Queries only read the tree and may run on several threads at once.
+    class Bvh
+    {
+    public:
+        static constexpr uint32_t s_NullNode = UINT32_MAX;
+
+        Bvh(float margin = 0.1f);
+
+        // returns the proxy of the new leaf, it stays valid until Remove, also across Rebuild
+        uint32_t Insert(const Aabb &box, uint32_t userData);
+        void Remove(uint32_t proxy);
+        // returns true when the box left the fat box and the leaf was reinserted
+        bool Move(uint32_t proxy, const Aabb &box);
+        void Rebuild(ThreadPool *pThreadPool = nullptr);
+
+        inline uint32_t GetUserData(uint32_t proxy) const { return m_Nodes[proxy].userData; }
+        inline const Aabb &GetFatBox(uint32_t proxy) const { return m_Nodes[proxy].box; }
+        inline uint32_t GetProxyCount() const { return m_LeafCount; }
+        inline uint32_t GetHeight() const { return m_Root == s_NullNode ? 0 : static_cast<uint32_t>(m_Nodes[m_Root].height); }
+        // summed inner node area over root area, the SAH traversal cost up to a constant
+        float GetCost() const;
+
+        // planes as returned by Camera::GetFrustumPlanes, callback(userData) for every leaf whose
+        // box is not completely outside. Subtrees fully inside are emitted without further tests.
+        template <typename F>
+        void QueryFrustum(const std::array<glm::vec4, 6> &planes, F &&callback) const;
+        template <typename F>
+        void QueryBox(const Aabb &box, F &&callback) const;
+        // hitTest(userData, boxDistance, maxDistance) returns the exact hit distance of the object or a
+        // negative value on a miss, boxDistance is where the ray enters the leaf box. Children are
+        // visited nearest first and pruned by the closest hit so far.
+        template <typename F>
+        bool RayCast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, F &&hitTest, BvhHit &hit) const;
+        bool RayCast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, BvhHit &hit) const;
+        // distanceTest(userData, boxDistance) returns the exact distance of the object to the point,
+        // leaves are visited in order of box distance until no closer one can exist
+        template <typename F>
+        bool FindNearest(const glm::vec3 &point, float maxDistance, F &&distanceTest, BvhHit &hit) const;
+        bool FindNearest(const glm::vec3 &point, float maxDistance, BvhHit &hit) const;
+
+    private:
+        struct Node
+        {
+            Aabb box;
+            uint32_t parent = s_NullNode; // next free node while on the free list
+            uint32_t children[2] = {s_NullNode, s_NullNode};
+            int32_t height = -1; // leaves are 0, free nodes -1
+            uint32_t userData = 0;
+
+            inline bool IsLeaf() const { return children[0] == s_NullNode; }
+        };
+
+        struct BuildItem
+        {
+            uint32_t node;
+            glm::vec3 centroid;
+        };
+
+        struct BuildTask
+        {
+            BuildItem *pItems;
+            uint32_t count;
+            uint32_t parent;
+            uint32_t childIndex;
+        };
+
+        struct BuildContext;
+
+        uint32_t AllocateNode();
+        void FreeNode(uint32_t node);
+        void InsertLeaf(uint32_t leaf);
+        void RemoveLeaf(uint32_t leaf);
+        uint32_t Balance(uint32_t node);
+        void Refit(uint32_t node);
+        void LinkChild(uint32_t parent, uint32_t childIndex, uint32_t child);
+        uint32_t SplitSah(BuildItem *pItems, uint32_t count) const;
+        uint32_t BuildSubtree(BuildItem *pItems, uint32_t count, BuildContext &context);
+        void BuildTopLevel(BuildItem *pItems, uint32_t count, uint32_t parent, uint32_t childIndex, BuildContext &context);
+
+        static bool IntersectRay(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, float &distance);
+        static float DistanceSquared(const Aabb &box, const glm::vec3 &point);
+
+    private:
+        std::vector<Node> m_Nodes;
+        uint32_t m_Root = s_NullNode;
+        uint32_t m_FreeList = s_NullNode;
+        uint32_t m_LeafCount = 0;
+        float m_Margin;
+    };
+
+    template <typename F>
+    void Bvh::QueryFrustum(const std::array<glm::vec4, 6> &planes, F &&callback) const
+    {
+        if (m_Root == s_NullNode)
+            return;
+
+        // the mask holds the planes the node still straddles, a cleared plane has the node on its inside
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.reserve(64);
+        stack.emplace_back(m_Root, 0x3Fu);
+        while (!stack.empty())
+        {
+            auto [index, mask] = stack.back();
+            stack.pop_back();
+            const Node &node = m_Nodes[index];
+
+            bool outside = false;
+            if (mask != 0)
+            {
+                glm::vec3 center = node.box.GetCenter();
+                glm::vec3 extent = node.box.GetExtent();
+                for (uint32_t plane = 0; plane < 6 && !outside; ++plane)
+                {
+                    if ((mask & (1u << plane)) == 0)
+                        continue;
+
+                    glm::vec3 normal = glm::vec3(planes[plane]);
+                    float distance = glm::dot(normal, center) + planes[plane].w;
+                    float radius = glm::dot(glm::abs(normal), extent);
+                    if (distance + radius < 0.0f)
+                        outside = true;
+                    else if (distance - radius >= 0.0f)
+                        mask &= ~(1u << plane);
+                }
+            }
+            if (outside)
+                continue;
+
+            if (node.IsLeaf())
+            {
+                callback(node.userData);
+                continue;
+            }
+            stack.emplace_back(node.children[0], mask);
+            stack.emplace_back(node.children[1], mask);
+        }
+    }
+
+    template <typename F>
+    void Bvh::QueryBox(const Aabb &box, F &&callback) const
+    {
+        if (m_Root == s_NullNode)
+            return;
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(m_Root);
+        while (!stack.empty())
+        {
+            const Node &node = m_Nodes[stack.back()];
+            stack.pop_back();
+            if (!node.box.Overlaps(box))
+                continue;
+
+            if (node.IsLeaf())
+                callback(node.userData);
+            else
+            {
+                stack.push_back(node.children[0]);
+                stack.push_back(node.children[1]);
+            }
+        }
+    }
+
+    template <typename F>
+    bool Bvh::RayCast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, F &&hitTest, BvhHit &hit) const
+    {
+        if (m_Root == s_NullNode)
+            return false;
+
+        // infinite components are fine, the slabs of axis parallel rays are all or nothing
+        const glm::vec3 inverseDirection = 1.0f / direction;
+        bool found = false;
+        float closest = maxDistance;
+
+        float entry;
+        if (!IntersectRay(m_Nodes[m_Root].box, origin, inverseDirection, closest, entry))
+            return false;
+
+        std::vector<std::pair<uint32_t, float>> stack;
+        stack.reserve(64);
+        stack.emplace_back(m_Root, entry);
+        while (!stack.empty())
+        {
+            auto [index, nodeEntry] = stack.back();
+            stack.pop_back();
+            if (nodeEntry > closest)
+                continue;
+
+            const Node &node = m_Nodes[index];
+            if (node.IsLeaf())
+            {
+                float distance = hitTest(node.userData, nodeEntry, closest);
+                if (distance >= 0.0f && distance <= closest)
+                {
+                    closest = distance;
+                    hit = {node.userData, distance};
+                    found = true;
+                }
+                continue;
+            }
+
+            float entries[2];
+            bool hits[2];
+            for (int child = 0; child < 2; ++child)
+                hits[child] = IntersectRay(m_Nodes[node.children[child]].box, origin, inverseDirection, closest, entries[child]);
+
+            // the nearer child goes on top
+            int nearer = (hits[0] && hits[1] && entries[1] < entries[0]) || !hits[0] ? 1 : 0;
+            int farther = 1 - nearer;
+            if (hits[farther])
+                stack.emplace_back(node.children[farther], entries[farther]);
+            if (hits[nearer])
+                stack.emplace_back(node.children[nearer], entries[nearer]);
+        }
+
+        return found;
+    }
+
+    template <typename F>
+    bool Bvh::FindNearest(const glm::vec3 &point, float maxDistance, F &&distanceTest, BvhHit &hit) const
+    {
+        if (m_Root == s_NullNode)
+            return false;
+
+        using Entry = std::pair<float, uint32_t>; // squared box distance, node
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        bool found = false;
+        float closest = maxDistance;
+
+        queue.emplace(DistanceSquared(m_Nodes[m_Root].box, point), m_Root);
+        while (!queue.empty())
+        {
+            auto [distanceSquared, index] = queue.top();
+            queue.pop();
+            // everything left is farther than the best hit
+            if (distanceSquared > closest * closest)
+                break;
+
+            const Node &node = m_Nodes[index];
+            if (node.IsLeaf())
+            {
+                float distance = distanceTest(node.userData, glm::sqrt(distanceSquared));
+                if (distance >= 0.0f && distance <= closest)
+                {
+                    closest = distance;
+                    hit = {node.userData, distance};
+                    found = true;
+                }
+                continue;
+            }
+
+            for (uint32_t child : node.children)
+            {
+                float childDistance = DistanceSquared(m_Nodes[child].box, point);
+                if (childDistance <= closest * closest)
+                    queue.emplace(childDistance, child);
+            }
+        }
+
+        return found;
+    }
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "Offscreen_Target.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace Divine
+{
+    OffscreenTarget::OffscreenTarget(Device &device, VkExtent2D extent, uint32_t imageCount)
+        : r_Device{device}, m_Extent{extent}
+    {
+        m_ColorFormat = ChooseColorFormat();
+        m_ColorImages.resize(imageCount);
+        CreateColorResources();
+        m_DepthTarget = CreateDepthTarget(r_Device, m_Extent);
+        m_RenderPass = CreateTargetRenderPass(r_Device, m_ColorFormat, m_DepthTarget.format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        CreateSyncObjects();
+    }
+
+    OffscreenTarget::~OffscreenTarget()
+    {
+        for (auto fence : m_InFlightFences)
+            vkDestroyFence(r_Device.GetDevice(), fence, nullptr);
+        vkDestroyRenderPass(r_Device.GetDevice(), m_RenderPass, nullptr);
+        DestroyDepthTarget(r_Device, m_DepthTarget);
+        for (size_t i = 0; i < m_ColorImages.size(); ++i)
+        {
+            vkDestroyImageView(r_Device.GetDevice(), m_ColorImageViews[i], nullptr);
+            vkDestroyImage(r_Device.GetDevice(), m_ColorImages[i], nullptr);
+            vkFreeMemory(r_Device.GetDevice(), m_ColorImageMemories[i], nullptr);
+        }
+    }
+
+    VkFormat OffscreenTarget::ChooseColorFormat()
+    {
+        // the frames are drawn to, blitted to when upscaling and read back. Before Vulkan 1.1 every format allows
+        // transfers and the transfer feature bits are not reported. Readbacks expect four 8 bit channels
+        VkFormatFeatureFlags features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(r_Device.GetPhysicalDevice(), &properties);
+        if (properties.apiVersion >= VK_API_VERSION_1_1)
+            features |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+        return r_Device.FindSupportedFormat({VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB}, VK_IMAGE_TILING_OPTIMAL, features);
+    }
+
+    void OffscreenTarget::CreateColorResources()
+    {
+        m_ColorImageMemories.resize(m_ColorImages.size());
+        m_ColorImageViews.resize(m_ColorImages.size());
+
+        for (size_t i = 0; i < m_ColorImages.size(); ++i)
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = m_Extent.width;
+            imageInfo.extent.height = m_Extent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = m_ColorFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = GetImageUsage();
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            r_Device.CreateImageWithInfo(
+                imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_ColorImages[i],
+                m_ColorImageMemories[i]);
+
+            m_ColorImageViews[i] = CreateTargetImageView(r_Device, m_ColorImages[i], m_ColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        }
+    }
+
+    void OffscreenTarget::CreateSyncObjects()
+    {
+        // one image per frame in flight, so the image index doubles as the frame index
+        m_InFlightFences.resize(m_ColorImages.size());
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (auto &fence : m_InFlightFences)
+        {
+            if (vkCreateFence(r_Device.GetDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create synchronization objects!");
+        }
+    }
+
+    VkResult OffscreenTarget::AcquireNextImage(uint32_t *pImageIndex)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        vkWaitForFences(
+            r_Device.GetDevice(),
+            1,
+            &m_InFlightFences[m_CurrentFrame],
+            VK_TRUE,
+            std::numeric_limits<uint64_t>::max());
+
+        if (vkResetFences(r_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to reset fence!");
+
+        *pImageIndex = static_cast<uint32_t>(m_CurrentFrame);
+
+        return VK_SUCCESS;
+    }
+
+    VkResult OffscreenTarget::SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = pBuffers;
+
+        if (vkQueueSubmit(r_Device.GetGraphicsQueue(), 1, &submitInfo, m_InFlightFences[*pImageIndex]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit command buffer!");
+
+        m_CurrentFrame = (m_CurrentFrame + 1) % m_ColorImages.size();
+
+        return VK_SUCCESS;
+    }
+}
\ No newline at end of file
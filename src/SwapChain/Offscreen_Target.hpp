@@ -0,0 +1,57 @@
+#ifndef OFFSCREEN_TARGET_HEADER
+#define OFFSCREEN_TARGET_HEADER
+
+#include "Device.hpp"
+#include "Target_Resources.hpp"
+
+#include <vector>
+
+namespace Divine
+{
+    // Stand-in for SwapChain when running headless: a ring of color targets sharing one depth target that are
+    // rendered to but never presented. The interface mirrors SwapChain so Renderer can switch.
+    class OffscreenTarget
+    {
+    public:
+        OffscreenTarget(Device &device, VkExtent2D extent, uint32_t imageCount);
+        ~OffscreenTarget();
+        OffscreenTarget(const OffscreenTarget &) = delete;
+        OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+        inline size_t GetImageCount() const { return m_ColorImages.size(); }
+        inline VkFormat GetImageFormat() const { return m_ColorFormat; }
+        inline VkImageUsageFlags GetImageUsage() const { return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT; }
+        inline VkExtent2D GetImageExtent() const { return m_Extent; }
+        inline uint32_t GetWidth() const { return m_Extent.width; }
+        inline uint32_t GetHeight() const { return m_Extent.height; }
+        inline VkImage GetColorImage(size_t index) const { return m_ColorImages[index]; }
+        inline VkImageView GetColorImageView(size_t index) const { return m_ColorImageViews[index]; }
+        inline VkFormat GetDepthFormat() const { return m_DepthTarget.format; }
+        inline VkImage GetDepthImage() const { return m_DepthTarget.image; }
+        inline VkImageView GetDepthImageView() const { return m_DepthTarget.imageView; }
+        inline VkRenderPass GetRenderPass() const { return m_RenderPass; }
+        inline float GetExtentAspectRatio() const { return static_cast<float>(m_Extent.width) / static_cast<float>(m_Extent.height); }
+
+        VkResult AcquireNextImage(uint32_t *pImageIndex);
+        VkResult SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex);
+
+    private:
+        VkFormat ChooseColorFormat();
+        void CreateColorResources();
+        void CreateSyncObjects();
+
+    private:
+        Device &r_Device;
+        VkExtent2D m_Extent;
+        VkFormat m_ColorFormat;
+        std::vector<VkImage> m_ColorImages;
+        std::vector<VkDeviceMemory> m_ColorImageMemories;
+        std::vector<VkImageView> m_ColorImageViews;
+        DepthTarget m_DepthTarget;
+        VkRenderPass m_RenderPass;
+        std::vector<VkFence> m_InFlightFences;
+        size_t m_CurrentFrame = 0;
+    };
+}
+
+#endif
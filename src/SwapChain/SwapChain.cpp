@@ -1,22 +1,22 @@
 #include "SwapChain.hpp"
+#include "Cpu_Profiler.hpp"
 
 #include <iostream>
 #include <limits>
 #include <stdexcept>
-#include <array>
+#include <algorithm>
+#include <assert.h>
 
 namespace Divine
 {
-    const unsigned int SwapChain::MAX_FRAMES_IN_FLIGHT = 2;
-
-    SwapChain::SwapChain(Device &device, VkExtent2D windowExtent)
-        : r_Device{device}, m_WindowExtent{windowExtent}
+    SwapChain::SwapChain(Device &device, VkExtent2D windowExtent, const SwapChainConfig &config)
+        : r_Device{device}, m_WindowExtent{windowExtent}, m_Config{config}
     {
         Init();
     }
 
-    SwapChain::SwapChain(Device &device, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous)
-        : r_Device{device}, m_WindowExtent{windowExtent}, sp_OldSwapChain{previous}
+    SwapChain::SwapChain(Device &device, VkExtent2D windowExtent, const SwapChainConfig &config, std::shared_ptr<SwapChain> previous)
+        : r_Device{device}, m_WindowExtent{windowExtent}, m_Config{config}, sp_OldSwapChain{previous}
     {
         Init();
 
@@ -25,30 +25,44 @@ namespace Divine
 
     void SwapChain::Init()
     {
+        assert(m_Config.framesInFlight > 0 &&
+               "Frames in flight must be at least one");
+
         CreateSwapChain();
         CreateImageViews();
-        CreateRenderPass();
-        CreateDepthResources();
-        CreateFrameBuffers();
-        CreateSyncObjects();
+        m_DepthTarget = CreateDepthTarget(r_Device, m_SwapChainImageExtent);
+
+        // pipelines were built against the first render pass, a compatible one is handed over instead of rebuilt
+        if (sp_OldSwapChain != nullptr && CompareSwapFormats(*sp_OldSwapChain))
+            std::swap(m_RenderPass, sp_OldSwapChain->m_RenderPass);
+        else
+            m_RenderPass = CreateTargetRenderPass(r_Device, m_SwapChainImageFormat, m_DepthTarget.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        // frames submitted through the old swap chain signal these fences, so the frame ring carries over
+        if (sp_OldSwapChain != nullptr)
+        {
+            m_ImageAvailableSemaphores = std::move(sp_OldSwapChain->m_ImageAvailableSemaphores);
+            m_RenderFinishedSemaphores = std::move(sp_OldSwapChain->m_RenderFinishedSemaphores);
+            m_InFlightFences = std::move(sp_OldSwapChain->m_InFlightFences);
+            m_CurrentFrame = sp_OldSwapChain->m_CurrentFrame;
+            sp_OldSwapChain->m_ImageAvailableSemaphores.clear();
+            sp_OldSwapChain->m_RenderFinishedSemaphores.clear();
+            sp_OldSwapChain->m_InFlightFences.clear();
+        }
+        else
+            CreateSyncObjects();
     }
 
     SwapChain::~SwapChain()
     {
-        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; ++i)
+        // empty when a newer swap chain adopted them
+        for (size_t i = 0; i < m_InFlightFences.size(); ++i)
         {
             vkDestroySemaphore(r_Device.GetDevice(), m_ImageAvailableSemaphores[i], nullptr);
             vkDestroySemaphore(r_Device.GetDevice(), m_RenderFinishedSemaphores[i], nullptr);
             vkDestroyFence(r_Device.GetDevice(), m_InFlightFences[i], nullptr);
         }
-        for (auto frameBuffer : m_SwapChainFrameBuffers)
-            vkDestroyFramebuffer(r_Device.GetDevice(), frameBuffer, nullptr);
-        for (size_t i = 0; i < m_DepthImages.size(); ++i)
-        {
-            vkDestroyImageView(r_Device.GetDevice(), m_DepthImageViews[i], nullptr);
-            vkDestroyImage(r_Device.GetDevice(), m_DepthImages[i], nullptr);
-            vkFreeMemory(r_Device.GetDevice(), m_DepthImageMemories[i], nullptr);
-        }
+        DestroyDepthTarget(r_Device, m_DepthTarget);
         vkDestroyRenderPass(r_Device.GetDevice(), m_RenderPass, nullptr);
         for (auto imageView : m_SwapChainImageViews)
             vkDestroyImageView(r_Device.GetDevice(), imageView, nullptr);
@@ -64,7 +78,8 @@ namespace Divine
         VkSurfaceFormatKHR format = ChooseSwapChainSurfaceFormat(details.formats);
         VkPresentModeKHR presentMode = ChooseSwapChainPresentMode(details.presentModes);
 
-        uint32_t imageCount = details.capabilities.minImageCount + 1;
+        // deeper pipelining needs as many images as frames that can be recorded ahead
+        uint32_t imageCount = std::max(details.capabilities.minImageCount + 1, m_Config.framesInFlight);
         if (details.capabilities.maxImageCount > 0 && imageCount > details.capabilities.maxImageCount)
             imageCount = details.capabilities.maxImageCount;
 
@@ -75,7 +90,10 @@ namespace Divine
         createInfo.imageFormat = format.format;
         createInfo.imageColorSpace = format.colorSpace;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // transfers let a lower resolution frame be upscaled straight into the image and the image be read back
+        m_SwapChainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                (details.capabilities.supportedUsageFlags & (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
+        createInfo.imageUsage = m_SwapChainImageUsage;
 
         QueueFamilyIndices indices = r_Device.GetQueueFamilyIndices();
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -108,6 +126,7 @@ namespace Divine
 
         m_SwapChainImageFormat = format.format;
         m_SwapChainImageExtent = extent;
+        m_PresentMode = presentMode;
     }
 
     VkExtent2D SwapChain::ChooseSwapChainExtent(VkSurfaceCapabilitiesKHR capabilities)
@@ -140,198 +159,52 @@ namespace Divine
         return formats[0];
     }
 
+    static const char *PresentModeName(VkPresentModeKHR presentMode)
+    {
+        switch (presentMode)
+        {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "Immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "Mailbox";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "V-Sync (relaxed)";
+        default:
+            return "V-Sync";
+        }
+    }
+
     VkPresentModeKHR SwapChain::ChooseSwapChainPresentMode(const std::vector<VkPresentModeKHR> &presentModes)
     {
+        VkPresentModeKHR chosen = VK_PRESENT_MODE_FIFO_KHR;
         for (VkPresentModeKHR presentMode : presentModes)
         {
-            if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (presentMode == m_Config.presentMode)
             {
-                std::cout << "\tPresent mode: Mailbox" << std::endl;
-                return presentMode;
+                chosen = presentMode;
+                break;
             }
         }
 
-        std::cout << "\tPresent mode: V-Sync" << std::endl;
-        return VK_PRESENT_MODE_FIFO_KHR;
+        if (chosen != m_Config.presentMode)
+            std::cout << "\tPresent mode " << PresentModeName(m_Config.presentMode) << " is not supported, falling back" << std::endl;
+        std::cout << "\tPresent mode: " << PresentModeName(chosen) << ", " << m_Config.framesInFlight << " frames in flight" << std::endl;
+
+        return chosen;
     }
 
     void SwapChain::CreateImageViews()
     {
         m_SwapChainImageViews.resize(m_SwapChainImages.size());
         for (size_t i = 0; i < m_SwapChainImageViews.size(); ++i)
-        {
-            VkImageViewCreateInfo viewInfo{};
-            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            viewInfo.image = m_SwapChainImages[i];
-            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            viewInfo.format = m_SwapChainImageFormat;
-            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            viewInfo.subresourceRange.baseMipLevel = 0;
-            viewInfo.subresourceRange.levelCount = 1;
-            viewInfo.subresourceRange.baseArrayLayer = 0;
-            viewInfo.subresourceRange.layerCount = 1;
-
-            if (vkCreateImageView(r_Device.GetDevice(), &viewInfo, nullptr, &m_SwapChainImageViews[i]) != VK_SUCCESS)
-                throw std::runtime_error("Failed to create iamge view!");
-        }
-    }
-
-    void SwapChain::CreateRenderPass()
-    {
-        VkAttachmentDescription colorAttachment{};
-        colorAttachment.format = m_SwapChainImageFormat;
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;              /*clear*/
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;            /*store*/
-        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;   /*don't care*/
-        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; /*don't care*/
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference colorAttachmentRef{};
-        colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentDescription depthAttachment{};
-        depthAttachment.format = FindDepthFormat();
-        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;              /*clear*/
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;        /*don't care*/
-        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;   /*don't care*/
-        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; /*don't care*/
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentReference depthAttachmentRef{};
-        depthAttachmentRef.attachment = 1;
-        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription subpass{};
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
-        subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-        VkSubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcAccessMask = VK_ACCESS_NONE;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-
-        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
-        VkRenderPassCreateInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        renderPassInfo.pAttachments = attachments.data();
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
-
-        if (vkCreateRenderPass(r_Device.GetDevice(), &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create render pass!");
-    }
-
-    VkFormat SwapChain::FindDepthFormat()
-    {
-        return r_Device.FindSupportedFormat(
-            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-    }
-
-    void SwapChain::CreateDepthResources()
-    {
-        VkFormat depthFormat = FindDepthFormat();
-        m_SwapChainDepthFormat = depthFormat;
-
-        m_DepthImages.resize(m_SwapChainImages.size());
-        m_DepthImageMemories.resize(m_SwapChainImages.size());
-        m_DepthImageViews.resize(m_SwapChainImages.size());
-
-        for (size_t i = 0; i < m_DepthImages.size(); ++i)
-        {
-            VkImageCreateInfo imageInfo{};
-            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = m_SwapChainImageExtent.width;
-            imageInfo.extent.height = m_SwapChainImageExtent.height;
-            imageInfo.extent.depth = 1;
-            imageInfo.mipLevels = 1;
-            imageInfo.arrayLayers = 1;
-            imageInfo.format = depthFormat;
-            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-
-            QueueFamilyIndices indices = r_Device.GetQueueFamilyIndices();
-            uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
-            if (indices.graphicsFamily != indices.presentFamily)
-            {
-                imageInfo.queueFamilyIndexCount = 2;
-                imageInfo.pQueueFamilyIndices = queueFamilyIndices;
-                imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-            }
-            else
-            {
-                imageInfo.queueFamilyIndexCount = 0;
-                imageInfo.pQueueFamilyIndices = nullptr;
-                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            }
-
-            r_Device.CreateImageWithInfo(
-                imageInfo,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                m_DepthImages[i],
-                m_DepthImageMemories[i]);
-
-            VkImageViewCreateInfo viewInfo{};
-            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            viewInfo.image = m_DepthImages[i];
-            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            viewInfo.format = depthFormat;
-            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            viewInfo.subresourceRange.baseMipLevel = 0;
-            viewInfo.subresourceRange.levelCount = 1;
-            viewInfo.subresourceRange.baseArrayLayer = 0;
-            viewInfo.subresourceRange.layerCount = 1;
-
-            if (vkCreateImageView(r_Device.GetDevice(), &viewInfo, nullptr, &m_DepthImageViews[i]) != VK_SUCCESS)
-                throw std::runtime_error("Failed to create iamge view!");
-        }
-    }
-
-    void SwapChain::CreateFrameBuffers()
-    {
-        m_SwapChainFrameBuffers.resize(m_SwapChainImages.size());
-
-        for (size_t i = 0; i < m_SwapChainFrameBuffers.size(); ++i)
-        {
-            std::array<VkImageView, 2> attachments = {m_SwapChainImageViews[i], m_DepthImageViews[i]};
-            VkExtent2D SwapChainExtent = m_SwapChainImageExtent;
-
-            VkFramebufferCreateInfo frameBufferInfo{};
-            frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            frameBufferInfo.renderPass = m_RenderPass;
-            frameBufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-            frameBufferInfo.pAttachments = attachments.data();
-            frameBufferInfo.width = SwapChainExtent.width;
-            frameBufferInfo.height = SwapChainExtent.height;
-            frameBufferInfo.layers = 1;
-
-            if (vkCreateFramebuffer(r_Device.GetDevice(), &frameBufferInfo, nullptr, &m_SwapChainFrameBuffers[i]) != VK_SUCCESS)
-                throw std::runtime_error("Failed to create frame buffer!");
-        }
+            m_SwapChainImageViews[i] = CreateTargetImageView(r_Device, m_SwapChainImages[i], m_SwapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
     }
 
     void SwapChain::CreateSyncObjects()
     {
-        m_ImageAvailableSemaphores.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
-        m_RenderFinishedSemaphores.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
-        m_InFlightFences.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        m_ImageAvailableSemaphores.resize(m_Config.framesInFlight);
+        m_RenderFinishedSemaphores.resize(m_Config.framesInFlight);
+        m_InFlightFences.resize(m_Config.framesInFlight);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -340,7 +213,7 @@ namespace Divine
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; ++i)
+        for (size_t i = 0; i < m_Config.framesInFlight; ++i)
         {
             if (vkCreateSemaphore(r_Device.GetDevice(), &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) ||
                 vkCreateSemaphore(r_Device.GetDevice(), &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) ||
@@ -351,16 +224,17 @@ namespace Divine
 
     VkResult SwapChain::AcquireNextImage(uint32_t *pImageIndex)
     {
-        vkWaitForFences(
-            r_Device.GetDevice(),
-            1,
-            &m_InFlightFences[m_CurrentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
-
-        if (vkResetFences(r_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to reset fence!");
+        {
+            DIVINE_PROFILE_SCOPE("WaitForFrameFence");
+            vkWaitForFences(
+                r_Device.GetDevice(),
+                1,
+                &m_InFlightFences[m_CurrentFrame],
+                VK_TRUE,
+                std::numeric_limits<uint64_t>::max());
+        }
 
+        DIVINE_PROFILE_SCOPE("AcquireNextImage");
         VkResult result = vkAcquireNextImageKHR(
             r_Device.GetDevice(),
             m_SwapChain,
@@ -369,10 +243,17 @@ namespace Divine
             VK_NULL_HANDLE,
             pImageIndex);
 
+        // an out of date acquire submits nothing, the fence has to stay signaled for the recreated swap chain
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+        {
+            if (vkResetFences(r_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to reset fence!");
+        }
+
         return result;
     }
 
-    VkResult SwapChain::SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex)
+    VkResult SwapChain::SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex, uint64_t presentID)
     {
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -391,8 +272,11 @@ namespace Divine
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(r_Device.GetGraphicsQueue(), 1, &submitInfo, m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to submit command buffer!");
+        {
+            DIVINE_PROFILE_SCOPE("QueueSubmit");
+            if (vkQueueSubmit(r_Device.GetGraphicsQueue(), 1, &submitInfo, m_InFlightFences[m_CurrentFrame]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit command buffer!");
+        }
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -405,9 +289,19 @@ namespace Divine
 
         presentInfo.pImageIndices = pImageIndex;
 
+        VkPresentIdKHR presentIDInfo{};
+        if (presentID != 0)
+        {
+            presentIDInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentIDInfo.swapchainCount = 1;
+            presentIDInfo.pPresentIds = &presentID;
+            presentInfo.pNext = &presentIDInfo;
+        }
+
+        DIVINE_PROFILE_SCOPE("QueuePresent");
         VkResult result = vkQueuePresentKHR(r_Device.GetPresentQueue(), &presentInfo);
 
-        m_CurrentFrame = (m_CurrentFrame + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+        m_CurrentFrame = (m_CurrentFrame + 1) % m_Config.framesInFlight;
 
         return result;
     }
@@ -2,6 +2,7 @@
 #define SWAPCHAIN_HEADER
 
 #include "Device.hpp"
+#include "Target_Resources.hpp"
 
 #include <string>
 #include <vector>
@@ -9,11 +10,18 @@
 
 namespace Divine
 {
+    struct SwapChainConfig
+    {
+        // falls back to FIFO, the only mode every implementation must support
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        uint32_t framesInFlight = 2;
+    };
+
     class SwapChain
     {
     public:
-        SwapChain(Device &device, VkExtent2D windowExtent);
-        SwapChain(Device &device, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+        SwapChain(Device &device, VkExtent2D windowExtent, const SwapChainConfig &config);
+        SwapChain(Device &device, VkExtent2D windowExtent, const SwapChainConfig &config, std::shared_ptr<SwapChain> previous);
         ~SwapChain();
         SwapChain(const SwapChain &) = delete;
         SwapChain &operator=(const SwapChain &) = delete;
@@ -21,24 +29,27 @@ namespace Divine
         inline VkSwapchainKHR GetSwapChain() const { return m_SwapChain; }
         inline size_t GetSwapChainImageCount() const { return m_SwapChainImages.size(); }
         inline VkFormat GetSwapChainImageFormat() const { return m_SwapChainImageFormat; }
+        inline VkImageUsageFlags GetSwapChainImageUsage() const { return m_SwapChainImageUsage; }
         inline VkExtent2D GetSwapChainImageExtent() const { return m_SwapChainImageExtent; }
         inline uint32_t GetWidth() const { return m_SwapChainImageExtent.width; }
         inline uint32_t GetHeight() const { return m_SwapChainImageExtent.height; }
+        inline VkImage GetSwapChainImage(size_t index) const { return m_SwapChainImages[index]; }
         inline VkImageView GetSwapChainImageView(size_t index) const { return m_SwapChainImageViews[index]; }
+        inline VkFormat GetSwapChainDepthFormat() const { return m_DepthTarget.format; }
+        inline VkImage GetDepthImage() const { return m_DepthTarget.image; }
+        inline VkImageView GetDepthImageView() const { return m_DepthTarget.imageView; }
         inline VkRenderPass GetRenderPass() const { return m_RenderPass; }
         inline float GetExtentAspectRatio() const { return static_cast<float>(m_SwapChainImageExtent.width) / static_cast<float>(m_SwapChainImageExtent.height); }
-        inline VkFramebuffer GetFrameBuffer(size_t index) const { return m_SwapChainFrameBuffers[index]; }
+        inline uint32_t GetFramesInFlight() const { return m_Config.framesInFlight; }
+        inline VkPresentModeKHR GetPresentMode() const { return m_PresentMode; }
         inline bool CompareSwapFormats(const SwapChain &swapChain) const
         {
-            return swapChain.m_SwapChainDepthFormat == m_SwapChainDepthFormat && swapChain.m_SwapChainImageFormat == m_SwapChainImageFormat;
+            return swapChain.m_DepthTarget.format == m_DepthTarget.format && swapChain.m_SwapChainImageFormat == m_SwapChainImageFormat;
         }
 
-        VkFormat FindDepthFormat();
-
         VkResult AcquireNextImage(uint32_t *pImageIndex);
-        VkResult SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex);
-
-        static const unsigned int MAX_FRAMES_IN_FLIGHT;
+        // presentID 0 leaves the present untagged, see VK_KHR_present_id
+        VkResult SubmitCommandBuffers(const VkCommandBuffer *pBuffers, uint32_t *pImageIndex, uint64_t presentID = 0);
 
     private:
         void Init();
@@ -50,29 +61,22 @@ namespace Divine
 
         void CreateImageViews();
 
-        void CreateRenderPass();
-
-        void CreateDepthResources();
-
-        void CreateFrameBuffers();
-
         void CreateSyncObjects();
 
     private:
         Device &r_Device;
         VkExtent2D m_WindowExtent;
+        SwapChainConfig m_Config;
+        VkPresentModeKHR m_PresentMode;
         std::shared_ptr<SwapChain> sp_OldSwapChain;
         VkSwapchainKHR m_SwapChain;
         std::vector<VkImage> m_SwapChainImages;
         VkFormat m_SwapChainImageFormat;
-        VkFormat m_SwapChainDepthFormat;
+        VkImageUsageFlags m_SwapChainImageUsage;
         VkExtent2D m_SwapChainImageExtent;
         std::vector<VkImageView> m_SwapChainImageViews;
-        VkRenderPass m_RenderPass;
-        std::vector<VkImage> m_DepthImages;
-        std::vector<VkDeviceMemory> m_DepthImageMemories;
-        std::vector<VkImageView> m_DepthImageViews;
-        std::vector<VkFramebuffer> m_SwapChainFrameBuffers;
+        VkRenderPass m_RenderPass = VK_NULL_HANDLE;
+        DepthTarget m_DepthTarget;
         std::vector<VkSemaphore> m_ImageAvailableSemaphores;
         std::vector<VkSemaphore> m_RenderFinishedSemaphores;
         std::vector<VkFence> m_InFlightFences;
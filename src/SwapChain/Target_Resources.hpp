@@ -0,0 +1,28 @@
+#ifndef TARGET_RESOURCES_HEADER
+#define TARGET_RESOURCES_HEADER
+
+#include "Device.hpp"
+
+namespace Divine
+{
+    // shared by SwapChain and OffscreenTarget, which build the same resources around their color images
+    VkImageView CreateTargetImageView(Device &device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask);
+
+    // depth is only consumed inside the frame's render passes, so one transient image serves every frame in flight
+    struct DepthTarget
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+    };
+
+    DepthTarget CreateDepthTarget(Device &device, VkExtent2D extent);
+    void DestroyDepthTarget(Device &device, DepthTarget &depthTarget);
+
+    // one subpass drawing to the color and depth targets. It is never begun, the render graph records the
+    // frame, pipelines drawing to the scene pass are created against it
+    VkRenderPass CreateTargetRenderPass(Device &device, VkFormat colorFormat, VkFormat depthFormat, VkImageLayout colorFinalLayout);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "Deferred_Render_System.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <stdexcept>
+#include <array>
+
+namespace Divine
+{
+    // two triangles for each face of the cube around a light
+    static constexpr uint32_t s_LightVolumeVertexCount = 36;
+
+    DeferredRenderSystem::DeferredRenderSystem(Device &device, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight)
+        : r_Device{device}, m_Frames(framesInFlight)
+    {
+        CreateDescriptors(framesInFlight);
+        CreatePipelineLayout(globalSetLayout);
+    }
+
+    DeferredRenderSystem::~DeferredRenderSystem()
+    {
+        up_AmbientPipeline = nullptr;
+        up_LightPipeline = nullptr;
+        vkDestroyPipelineLayout(r_Device.GetDevice(), m_PipelineLayout, nullptr);
+    }
+
+    void DeferredRenderSystem::CreateDescriptors(uint32_t framesInFlight)
+    {
+        up_SetLayout = DescriptorSetLayout::Builder(r_Device)
+                           .AddBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+                           .AddBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+                           .AddBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+                           .Build();
+
+        up_DescriptorPool = DescriptorPool::Builder(r_Device)
+                                .SetMaxSets(framesInFlight)
+                                .AddPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3 * framesInFlight)
+                                .Build();
+    }
+
+    void DeferredRenderSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
+    {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout, up_SetLayout->GetDescriptorSetLayout()};
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        layoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        layoutInfo.pushConstantRangeCount = 0;
+        layoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(r_Device.GetDevice(), &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline layout!");
+    }
+
+    void DeferredRenderSystem::CreatePipelines(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass)
+    {
+        assert(m_PipelineLayout != VK_NULL_HANDLE &&
+               "Can't create pipeline without pipeline layout");
+
+        // the triangle lies on the far plane, only pixels some geometry got in front of pass
+        PipelineRequest ambientRequest{};
+        ambientRequest.vertFilePath = HOME_DIR "res/shaders/deferred_ambient.vert.spv";
+        ambientRequest.fragFilePath = HOME_DIR "res/shaders/deferred_ambient.frag.spv";
+
+        PipelineConfigInfo &ambientConfig = *ambientRequest.up_ConfigInfo;
+        Pipeline::DefaultPipelineConfigInfo(ambientConfig);
+        ambientConfig.renderPass = renderPass;
+        ambientConfig.subpass = subpass;
+        ambientConfig.pipelineLayout = m_PipelineLayout;
+        ambientConfig.bindingDescriptions.clear();
+        ambientConfig.attributeDescriptions.clear();
+        ambientConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+        ambientConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_GREATER;
+
+        // back faces behind or on the scene, so the camera may stand inside a volume
+        PipelineRequest lightRequest{};
+        lightRequest.vertFilePath = HOME_DIR "res/shaders/deferred_light.vert.spv";
+        lightRequest.fragFilePath = HOME_DIR "res/shaders/deferred_light.frag.spv";
+
+        PipelineConfigInfo &lightConfig = *lightRequest.up_ConfigInfo;
+        Pipeline::DefaultPipelineConfigInfo(lightConfig);
+        lightConfig.renderPass = renderPass;
+        lightConfig.subpass = subpass;
+        lightConfig.pipelineLayout = m_PipelineLayout;
+        lightConfig.bindingDescriptions.clear();
+        lightConfig.attributeDescriptions.clear();
+        lightConfig.rasterizationInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
+        lightConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+        lightConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+        // lights add up, the alpha of the ambient pass is kept
+        lightConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+        lightConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        lightConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        lightConfig.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        lightConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        lightConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        lightConfig.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        up_AmbientPipeline = compiler.CompileAsync(std::move(ambientRequest));
+        up_LightPipeline = compiler.CompileAsync(std::move(lightRequest));
+    }
+
+    void DeferredRenderSystem::SetGBuffer(VkImageView albedo, VkImageView normal, VkImageView depth)
+    {
+        if (albedo == m_AlbedoView && normal == m_NormalView && depth == m_DepthView)
+            return;
+
+        m_AlbedoView = albedo;
+        m_NormalView = normal;
+        m_DepthView = depth;
+        ++m_GBufferGeneration;
+    }
+
+    void DeferredRenderSystem::WriteDescriptorSet(FrameResources &frame)
+    {
+        VkDescriptorImageInfo albedoInfo{VK_NULL_HANDLE, m_AlbedoView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo normalInfo{VK_NULL_HANDLE, m_NormalView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo depthInfo{VK_NULL_HANDLE, m_DepthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+        DescriptorWriter writer(*up_SetLayout, *up_DescriptorPool);
+        writer.WriteImage(0, &albedoInfo)
+            .WriteImage(1, &normalInfo)
+            .WriteImage(2, &depthInfo);
+
+        if (frame.descriptorSet == VK_NULL_HANDLE)
+        {
+            if (!writer.Build(frame.descriptorSet))
+                throw std::runtime_error("Failed to allocate G-buffer descriptor set!");
+        }
+        else
+            writer.OverWrite(frame.descriptorSet);
+        frame.gBufferGeneration = m_GBufferGeneration;
+    }
+
+    void DeferredRenderSystem::Render(FrameInfo &frameInfo, uint32_t lightCount)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        assert(HasPipelines() && m_AlbedoView != VK_NULL_HANDLE &&
+               "The deferred pipelines and the G-buffer are set once the render graph is compiled");
+
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+        if (frame.descriptorSet == VK_NULL_HANDLE || frame.gBufferGeneration != m_GBufferGeneration)
+            WriteDescriptorSet(frame);
+
+        std::array<VkDescriptorSet, 2> descriptorSets = {frameInfo.globalDescriptorSet, frame.descriptorSet};
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_PipelineLayout,
+            0,
+            static_cast<uint32_t>(descriptorSets.size()),
+            descriptorSets.data(),
+            0,
+            nullptr);
+
+        up_AmbientPipeline->Bind(frameInfo.commandBuffer);
+        vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+
+        if (lightCount == 0)
+            return;
+
+        // the instance picks the light, the vertex shader builds the cube from the vertex index
+        up_LightPipeline->Bind(frameInfo.commandBuffer);
+        vkCmdDraw(frameInfo.commandBuffer, s_LightVolumeVertexCount, lightCount, 0, 0);
+    }
+
+}
@@ -0,0 +1,64 @@
+#ifndef DEFERRED_RENDER_SYSTEM_HEADER
+#define DEFERRED_RENDER_SYSTEM_HEADER
+
+#include "Device.hpp"
+#include "Descriptors.hpp"
+#include "Pipeline.hpp"
+#include "Pipeline_Compiler.hpp"
+#include "FrameInfo.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Divine
+{
+    // Lighting subpass of the deferred path. The G-buffer written by the previous subpass is read as input
+    // attachments, so on tilers it never leaves tile memory. A fullscreen triangle applies the ambient light
+    // to the covered pixels, then every light adds itself through the back faces of a cube around its range,
+    // all lights in one instanced draw. Volume faces in front of the scene fail the depth test, which keeps
+    // each light to the pixels it can reach.
+    class DeferredRenderSystem
+    {
+    public:
+        DeferredRenderSystem(Device &device, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight);
+        ~DeferredRenderSystem();
+        DeferredRenderSystem(const DeferredRenderSystem &) = delete;
+        DeferredRenderSystem &operator=(const DeferredRenderSystem &) = delete;
+
+        // the render pass only exists once the render graph is compiled, any compatible one will do later
+        void CreatePipelines(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass);
+        inline bool HasPipelines() const { return up_AmbientPipeline != nullptr; }
+        inline bool ArePipelinesReady() const { return HasPipelines() && up_AmbientPipeline->IsReady() && up_LightPipeline->IsReady(); }
+
+        // views of the graph's G-buffer images, the frame sets are rewritten when the graph is rebuilt
+        void SetGBuffer(VkImageView albedo, VkImageView normal, VkImageView depth);
+        void Render(FrameInfo &frameInfo, uint32_t lightCount);
+
+    private:
+        struct FrameResources
+        {
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            uint64_t gBufferGeneration = 0;
+        };
+
+        void CreateDescriptors(uint32_t framesInFlight);
+        void CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout);
+        void WriteDescriptorSet(FrameResources &frame);
+
+    private:
+        Device &r_Device;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<AsyncPipeline> up_AmbientPipeline;
+        std::unique_ptr<AsyncPipeline> up_LightPipeline;
+        std::unique_ptr<DescriptorSetLayout> up_SetLayout;
+        std::unique_ptr<DescriptorPool> up_DescriptorPool;
+        std::vector<FrameResources> m_Frames;
+
+        VkImageView m_AlbedoView = VK_NULL_HANDLE;
+        VkImageView m_NormalView = VK_NULL_HANDLE;
+        VkImageView m_DepthView = VK_NULL_HANDLE;
+        uint64_t m_GBufferGeneration = 0;
+    };
+}
+
+#endif
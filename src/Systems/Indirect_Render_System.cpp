@@ -0,0 +1,428 @@
+#include "Indirect_Render_System.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Divine
+{
+    static constexpr uint32_t s_CullGroupSize = 64; // local_size_x of cull.comp
+    static constexpr uint32_t s_MinObjectCapacity = 256;
+    static constexpr uint32_t s_MinBatchCapacity = 16;
+
+    IndirectRenderSystem::IndirectRenderSystem(Device &device, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight)
+        : r_Device{device}, m_FramesInFlight{framesInFlight}, m_Frames(framesInFlight)
+    {
+        assert(IsSupported(device) && "Indirect drawing needs multiDrawIndirect and drawIndirectFirstInstance");
+
+        if (r_Device.IsExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+            m_pDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(r_Device.GetDevice(), "vkCmdDrawIndexedIndirectCountKHR"));
+
+        ReserveBuffers(0, 0);
+        CreateDescriptors();
+        CreatePipelineLayouts(globalSetLayout);
+        CreatePipelines(compiler, renderPass);
+    }
+
+    IndirectRenderSystem::~IndirectRenderSystem()
+    {
+        up_Pipeline = nullptr;
+        up_DeferredPipeline = nullptr;
+        up_CullPipeline = nullptr;
+        vkDestroyPipelineLayout(r_Device.GetDevice(), m_PipelineLayout, nullptr);
+        vkDestroyPipelineLayout(r_Device.GetDevice(), m_CullPipelineLayout, nullptr);
+    }
+
+    bool IndirectRenderSystem::IsSupported(const Device &device)
+    {
+        const VkPhysicalDeviceFeatures &features = device.GetEnabledFeatures();
+        return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    }
+
+    void IndirectRenderSystem::CreateDescriptors()
+    {
+        up_SetLayout = DescriptorSetLayout::Builder(r_Device)
+                           .AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT)
+                           .AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .Build();
+
+        up_DescriptorPool = DescriptorPool::Builder(r_Device)
+                                .SetMaxSets(m_FramesInFlight)
+                                .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * m_FramesInFlight)
+                                .Build();
+
+        for (FrameResources &frame : m_Frames)
+            WriteDescriptorSet(frame);
+    }
+
+    void IndirectRenderSystem::CreatePipelineLayouts(VkDescriptorSetLayout globalSetLayout)
+    {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout, up_SetLayout->GetDescriptorSetLayout()};
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        layoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        layoutInfo.pushConstantRangeCount = 0;
+        layoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(r_Device.GetDevice(), &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline layout!");
+
+        VkPushConstantRange cullPushConstantRange{};
+        cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        cullPushConstantRange.offset = 0;
+        cullPushConstantRange.size = sizeof(CullPushConstantData);
+
+        VkDescriptorSetLayout cullSetLayout = up_SetLayout->GetDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo cullLayoutInfo{};
+        cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        cullLayoutInfo.setLayoutCount = 1;
+        cullLayoutInfo.pSetLayouts = &cullSetLayout;
+        cullLayoutInfo.pushConstantRangeCount = 1;
+        cullLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+
+        if (vkCreatePipelineLayout(r_Device.GetDevice(), &cullLayoutInfo, nullptr, &m_CullPipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create culling pipeline layout!");
+    }
+
+    void IndirectRenderSystem::CreatePipelines(PipelineCompiler &compiler, VkRenderPass renderPass)
+    {
+        assert(m_PipelineLayout != VK_NULL_HANDLE && m_CullPipelineLayout != VK_NULL_HANDLE &&
+               "Can't create pipeline without pipeline layout");
+        PipelineRequest request{};
+        request.vertFilePath = HOME_DIR "res/shaders/indirect_vert.vert.spv";
+        request.fragFilePath = HOME_DIR "res/shaders/basic_frag.frag.spv";
+
+        PipelineConfigInfo &configInfo = *request.up_ConfigInfo;
+        Pipeline::DefaultPipelineConfigInfo(configInfo);
+        configInfo.renderPass = renderPass;
+        configInfo.pipelineLayout = m_PipelineLayout;
+
+        up_Pipeline = compiler.CompileAsync(std::move(request));
+        up_CullPipeline = std::make_unique<ComputePipeline>(r_Device, HOME_DIR "res/shaders/cull.comp.spv", m_CullPipelineLayout);
+    }
+
+    void IndirectRenderSystem::CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass)
+    {
+        assert(m_PipelineLayout != VK_NULL_HANDLE &&
+               "Can't create pipeline without pipeline layout");
+        PipelineRequest request{};
+        request.vertFilePath = HOME_DIR "res/shaders/indirect_vert.vert.spv";
+        request.fragFilePath = HOME_DIR "res/shaders/gbuffer.frag.spv";
+
+        PipelineConfigInfo &configInfo = *request.up_ConfigInfo;
+        Pipeline::DefaultPipelineConfigInfo(configInfo);
+        Pipeline::SetColorAttachmentCount(configInfo, 2); // albedo and normal
+        configInfo.renderPass = renderPass;
+        configInfo.subpass = subpass;
+        configInfo.pipelineLayout = m_PipelineLayout;
+
+        up_DeferredPipeline = compiler.CompileAsync(std::move(request));
+    }
+
+    void IndirectRenderSystem::RetireBuffer(std::unique_ptr<Buffer> &up_Buffer)
+    {
+        if (up_Buffer != nullptr)
+            m_RetiredBuffers.emplace_back(m_UpdateCount + m_FramesInFlight, std::move(up_Buffer));
+    }
+
+    void IndirectRenderSystem::ReserveBuffers(uint32_t objectCount, uint32_t batchCount)
+    {
+        uint32_t objectCapacity = up_ObjectBuffer != nullptr ? up_ObjectBuffer->GetInstanceCount() : 0;
+        if (up_ObjectBuffer == nullptr || objectCount > objectCapacity)
+        {
+            uint32_t capacity = std::max({objectCount, objectCapacity * 2, s_MinObjectCapacity});
+            RetireBuffer(up_ObjectBuffer);
+            RetireBuffer(up_CommandBuffer);
+            up_ObjectBuffer = std::make_unique<Buffer>(r_Device,
+                                                       sizeof(GpuObject),
+                                                       capacity,
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            up_CommandBuffer = std::make_unique<Buffer>(r_Device,
+                                                        sizeof(VkDrawIndexedIndirectCommand),
+                                                        capacity,
+                                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            ++m_BufferGeneration;
+        }
+
+        uint32_t batchCapacity = up_BatchBuffer != nullptr ? up_BatchBuffer->GetInstanceCount() : 0;
+        if (up_BatchBuffer == nullptr || batchCount > batchCapacity)
+        {
+            uint32_t capacity = std::max({batchCount, batchCapacity * 2, s_MinBatchCapacity});
+            RetireBuffer(up_BatchBuffer);
+            RetireBuffer(up_CountBuffer);
+            up_BatchBuffer = std::make_unique<Buffer>(r_Device,
+                                                      sizeof(GpuBatch),
+                                                      capacity,
+                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            up_CountBuffer = std::make_unique<Buffer>(r_Device,
+                                                      sizeof(uint32_t),
+                                                      capacity,
+                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            ++m_BufferGeneration;
+        }
+    }
+
+    void IndirectRenderSystem::ReserveStaging(FrameResources &frame, VkDeviceSize size)
+    {
+        VkDeviceSize capacity = frame.up_Staging != nullptr ? frame.up_Staging->GetBufferSize() : 0;
+        if (frame.up_Staging != nullptr && size <= capacity)
+            return;
+
+        frame.up_Staging = std::make_unique<Buffer>(r_Device,
+                                                    1,
+                                                    static_cast<uint32_t>(std::max(size, capacity * 2)),
+                                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.up_Staging->Map();
+    }
+
+    void IndirectRenderSystem::WriteDescriptorSet(FrameResources &frame)
+    {
+        auto objectInfo = up_ObjectBuffer->GetDescriptorBufferInfo();
+        auto batchInfo = up_BatchBuffer->GetDescriptorBufferInfo();
+        auto commandInfo = up_CommandBuffer->GetDescriptorBufferInfo();
+        auto countInfo = up_CountBuffer->GetDescriptorBufferInfo();
+
+        DescriptorWriter writer(*up_SetLayout, *up_DescriptorPool);
+        writer.WriteBuffer(0, &objectInfo)
+            .WriteBuffer(1, &batchInfo)
+            .WriteBuffer(2, &commandInfo)
+            .WriteBuffer(3, &countInfo);
+
+        if (frame.descriptorSet == VK_NULL_HANDLE)
+        {
+            if (!writer.Build(frame.descriptorSet))
+                throw std::runtime_error("Failed to allocate culling descriptor set!");
+        }
+        else
+            writer.OverWrite(frame.descriptorSet);
+        frame.bufferGeneration = m_BufferGeneration;
+    }
+
+    void IndirectRenderSystem::RebuildBatches(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        // group by model in first seen order, every model has its own vertex and index buffers
+        std::unordered_map<Model *, std::vector<Entity>> groups;
+        std::vector<Model *> order;
+        auto view = registry.GetView<ModelComponent, WorldTransformComponent>();
+        view.Each([&](Entity entity, ModelComponent &model, WorldTransformComponent &)
+                  {
+                      Model *pModel = model.sp_Model.get();
+                      assert(pModel->HasIndexBuffer() && "Indirect drawing needs indexed models");
+                      if (!pModel->HasIndexBuffer())
+                          return;
+
+                      auto [it, inserted] = groups.try_emplace(pModel);
+                      if (inserted)
+                          order.push_back(pModel);
+                      it->second.push_back(entity); });
+
+        m_Batches.clear();
+        m_Objects.clear();
+        uint32_t maxDrawCount = r_Device.m_DeviceProperties.limits.maxDrawIndirectCount;
+        for (Model *pModel : order)
+        {
+            const std::vector<Entity> &entities = groups[pModel];
+            for (size_t begin = 0; begin < entities.size(); begin += maxDrawCount)
+            {
+                uint32_t count = static_cast<uint32_t>(std::min<size_t>(maxDrawCount, entities.size() - begin));
+                uint32_t batch = static_cast<uint32_t>(m_Batches.size());
+                m_Batches.push_back({pModel, static_cast<uint32_t>(m_Objects.size()), count});
+                for (uint32_t slot = 0; slot < count; ++slot)
+                    m_Objects.push_back({entities[begin + slot], batch, slot});
+            }
+        }
+
+        ReserveBuffers(static_cast<uint32_t>(m_Objects.size()), static_cast<uint32_t>(m_Batches.size()));
+    }
+
+    void IndirectRenderSystem::Update(FrameInfo &frameInfo)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        ++m_UpdateCount;
+        m_RetiredBuffers.erase(std::remove_if(m_RetiredBuffers.begin(), m_RetiredBuffers.end(), [&](const auto &retired)
+                                              { return retired.first <= m_UpdateCount; }),
+                               m_RetiredBuffers.end());
+
+        auto &models = frameInfo.registry.GetPool<ModelComponent>();
+        auto &worldTransforms = frameInfo.registry.GetPool<WorldTransformComponent>();
+        auto &colors = frameInfo.registry.GetPool<ColorComponent>();
+        // colors travel with the transforms, adding or removing one uploads everything
+        bool structural = m_ModelVersion != models.GetVersion() || m_WorldVersion != worldTransforms.GetVersion() ||
+                          m_ColorVersion != colors.GetVersion();
+        if (structural)
+        {
+            RebuildBatches(frameInfo.registry);
+            m_ModelVersion = models.GetVersion();
+            m_WorldVersion = worldTransforms.GetVersion();
+            m_ColorVersion = colors.GetVersion();
+        }
+
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+        frame.objectCopies.clear();
+        frame.uploadBatches = structural;
+
+        // a structural change uploads everything, otherwise only what TransformSystem recomputed
+        m_Staged.clear();
+        for (uint32_t i = 0; i < m_Objects.size(); ++i)
+        {
+            const ObjectRecord &record = m_Objects[i];
+            const WorldTransformComponent &world = worldTransforms.Get(record.entity);
+            if (!structural && !world.changed)
+                continue;
+
+            const Model::BoundingSphere &sphere = m_Batches[record.batch].pModel->GetBoundingSphere();
+            GpuObject &object = m_Staged.emplace_back();
+            object.modelMatrix = world.modelMatrix;
+            object.normalMatrix = world.normalMatrix;
+            object.boundingSphere = glm::vec4(sphere.center, sphere.radius);
+            object.color = glm::vec4(colors.Contains(record.entity) ? colors.Get(record.entity).color : glm::vec3{1.0f}, 1.0f);
+            object.batch = record.batch;
+            object.slot = record.slot;
+
+            // runs of consecutive objects share one copy region
+            VkDeviceSize srcOffset = (m_Staged.size() - 1) * sizeof(GpuObject);
+            VkDeviceSize dstOffset = i * sizeof(GpuObject);
+            if (!frame.objectCopies.empty() && frame.objectCopies.back().dstOffset + frame.objectCopies.back().size == dstOffset)
+                frame.objectCopies.back().size += sizeof(GpuObject);
+            else
+                frame.objectCopies.push_back({srcOffset, dstOffset, sizeof(GpuObject)});
+        }
+
+        VkDeviceSize objectBytes = m_Staged.size() * sizeof(GpuObject);
+        VkDeviceSize batchBytes = frame.uploadBatches ? m_Batches.size() * sizeof(GpuBatch) : 0;
+        if (objectBytes + batchBytes > 0)
+        {
+            ReserveStaging(frame, objectBytes + batchBytes);
+            char *pStaging = static_cast<char *>(frame.up_Staging->GetMappedMemory());
+            std::memcpy(pStaging, m_Staged.data(), objectBytes);
+
+            frame.batchOffset = objectBytes;
+            GpuBatch *pBatches = reinterpret_cast<GpuBatch *>(pStaging + objectBytes);
+            for (size_t i = 0; i < batchBytes / sizeof(GpuBatch); ++i)
+                pBatches[i] = {m_Batches[i].pModel->GetIndexCount(), 0, 0, m_Batches[i].commandBase};
+        }
+
+        if (frame.bufferGeneration != m_BufferGeneration)
+            WriteDescriptorSet(frame);
+        m_TotalUploaded += m_Staged.size();
+    }
+
+    void IndirectRenderSystem::RecordUpload(FrameInfo &frameInfo)
+    {
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+        if (!frame.objectCopies.empty())
+            vkCmdCopyBuffer(frameInfo.commandBuffer,
+                            frame.up_Staging->GetBuffer(),
+                            up_ObjectBuffer->GetBuffer(),
+                            static_cast<uint32_t>(frame.objectCopies.size()),
+                            frame.objectCopies.data());
+
+        if (frame.uploadBatches && !m_Batches.empty())
+        {
+            VkBufferCopy copy{frame.batchOffset, 0, m_Batches.size() * sizeof(GpuBatch)};
+            vkCmdCopyBuffer(frameInfo.commandBuffer, frame.up_Staging->GetBuffer(), up_BatchBuffer->GetBuffer(), 1, &copy);
+        }
+
+        // the culling pass appends to the counts
+        vkCmdFillBuffer(frameInfo.commandBuffer, up_CountBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+    }
+
+    void IndirectRenderSystem::RecordCull(FrameInfo &frameInfo)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        if (m_Objects.empty())
+            return;
+
+        up_CullPipeline->Bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_CullPipelineLayout,
+            0,
+            1,
+            &m_Frames[frameInfo.frameIndex].descriptorSet,
+            0,
+            nullptr);
+
+        std::array<glm::vec4, 6> planes = frameInfo.camera.GetFrustumPlanes();
+        CullPushConstantData push{};
+        std::copy(planes.begin(), planes.end(), push.frustumPlanes);
+        push.objectCount = static_cast<uint32_t>(m_Objects.size());
+        push.compact = IsCompact() ? 1 : 0;
+
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_CullPipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            static_cast<uint32_t>(sizeof(CullPushConstantData)),
+            &push);
+
+        vkCmdDispatch(frameInfo.commandBuffer, ComputePipeline::GetGroupCount(push.objectCount, s_CullGroupSize), 1, 1);
+    }
+
+    void IndirectRenderSystem::Render(FrameInfo &frameInfo, bool deferred)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        assert((!deferred || up_DeferredPipeline != nullptr) && "The deferred pipeline was never created");
+        if (m_Batches.empty())
+            return;
+
+        (deferred ? up_DeferredPipeline : up_Pipeline)->Bind(frameInfo.commandBuffer);
+
+        std::array<VkDescriptorSet, 2> descriptorSets = {frameInfo.globalDescriptorSet, m_Frames[frameInfo.frameIndex].descriptorSet};
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_PipelineLayout,
+            0,
+            static_cast<uint32_t>(descriptorSets.size()),
+            descriptorSets.data(),
+            0,
+            nullptr);
+
+        // one call per batch, the GPU decides how many of its commands draw anything
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        for (uint32_t i = 0; i < m_Batches.size(); ++i)
+        {
+            const Batch &batch = m_Batches[i];
+            batch.pModel->Bind(frameInfo.commandBuffer);
+
+            VkDeviceSize offset = static_cast<VkDeviceSize>(batch.commandBase) * stride;
+            if (IsCompact())
+                m_pDrawIndexedIndirectCount(frameInfo.commandBuffer,
+                                            up_CommandBuffer->GetBuffer(), offset,
+                                            up_CountBuffer->GetBuffer(), i * sizeof(uint32_t),
+                                            batch.objectCount, stride);
+            else
+                vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, up_CommandBuffer->GetBuffer(), offset, batch.objectCount, stride);
+        }
+    }
+
+    void IndirectRenderSystem::Report(std::ostream &os) const
+    {
+        if (m_UpdateCount == 0)
+            return;
+
+        os << "\tGPU culling: " << m_Objects.size() << " objects in " << m_Batches.size() << " indirect draws, "
+           << std::fixed << std::setprecision(1) << static_cast<double>(m_TotalUploaded) / m_UpdateCount
+           << " object uploads per frame (" << (IsCompact() ? "count buffer" : "zero instance draws") << ")" << std::endl;
+        os.unsetf(std::ios::fixed);
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef INDIRECT_RENDER_SYSTEM_HEADER
+#define INDIRECT_RENDER_SYSTEM_HEADER
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "Pipeline.hpp"
+#include "Pipeline_Compiler.hpp"
+#include "Compute_Pipeline.hpp"
+#include "Game_Object.hpp"
+#include "FrameInfo.hpp"
+
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace Divine
+{
+    // GPU driven counterpart of RenderSystem. Object transforms and bounds live in a storage buffer that
+    // only receives the objects whose world transform changed, a compute pass tests them against the
+    // frustum and writes one indexed indirect command per object into the command range of its model.
+    // Recording costs one indirect draw per model whatever the object count. With the draw indirect count
+    // extension visible objects are appended and counted, otherwise culled objects draw zero instances.
+    class IndirectRenderSystem
+    {
+    public:
+        IndirectRenderSystem(Device &device, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight);
+        ~IndirectRenderSystem();
+        IndirectRenderSystem(const IndirectRenderSystem &) = delete;
+        IndirectRenderSystem &operator=(const IndirectRenderSystem &) = delete;
+
+        // multi draw indirect and firstInstance in indirect commands
+        static bool IsSupported(const Device &device);
+
+        // the buffers are replaced when they grow, import them into the render graph every frame
+        inline VkBuffer GetObjectBuffer() const { return up_ObjectBuffer->GetBuffer(); }
+        inline VkBuffer GetBatchBuffer() const { return up_BatchBuffer->GetBuffer(); }
+        inline VkBuffer GetCommandBuffer() const { return up_CommandBuffer->GetBuffer(); }
+        inline VkBuffer GetCountBuffer() const { return up_CountBuffer->GetBuffer(); }
+        inline uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_Objects.size()); }
+        inline uint32_t GetBatchCount() const { return static_cast<uint32_t>(m_Batches.size()); }
+        inline bool IsCompact() const { return m_pDrawIndexedIndirectCount != nullptr; }
+
+        // call after TransformSystem::Update, stages the changed objects in the frame's upload buffer
+        void Update(FrameInfo &frameInfo);
+        // transfer pass, copies the staged objects and clears the counts
+        void RecordUpload(FrameInfo &frameInfo);
+        // compute pass, fills the indirect commands
+        void RecordCull(FrameInfo &frameInfo);
+        // G-buffer variant for the first subpass of the deferred render pass
+        void CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass);
+        inline bool IsDeferredPipelineReady() const { return up_DeferredPipeline != nullptr && up_DeferredPipeline->IsReady(); }
+        void Render(FrameInfo &frameInfo, bool deferred = false);
+
+        void Report(std::ostream &os) const;
+
+    private:
+        // layouts shared with cull.comp and indirect_vert.vert
+        struct GpuObject
+        {
+            glm::mat4 modelMatrix{1.0f};
+            glm::mat4 normalMatrix{1.0f};
+            glm::vec4 boundingSphere{0.0f}; // object space center, w is radius
+            glm::vec4 color{1.0f};          // multiplies the vertex color, white without a ColorComponent
+            uint32_t batch = 0;
+            uint32_t slot = 0; // position inside the batch's command range
+            uint32_t pad0 = 0;
+            uint32_t pad1 = 0;
+        };
+
+        struct GpuBatch
+        {
+            uint32_t indexCount;
+            uint32_t firstIndex;
+            int32_t vertexOffset;
+            uint32_t commandBase;
+        };
+
+        struct CullPushConstantData
+        {
+            glm::vec4 frustumPlanes[6];
+            uint32_t objectCount;
+            uint32_t compact;
+        };
+
+        // objects of one model, large models are split to respect maxDrawIndirectCount
+        struct Batch
+        {
+            Model *pModel;
+            uint32_t commandBase;
+            uint32_t objectCount;
+        };
+
+        struct ObjectRecord
+        {
+            Entity entity;
+            uint32_t batch;
+            uint32_t slot;
+        };
+
+        struct FrameResources
+        {
+            std::unique_ptr<Buffer> up_Staging;
+            std::vector<VkBufferCopy> objectCopies;
+            VkDeviceSize batchOffset = 0; // of the batch table in the staging buffer
+            bool uploadBatches = false;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            uint64_t bufferGeneration = 0;
+        };
+
+        void CreateDescriptors();
+        void CreatePipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+        void CreatePipelines(PipelineCompiler &compiler, VkRenderPass renderPass);
+        void ReserveBuffers(uint32_t objectCount, uint32_t batchCount);
+        void ReserveStaging(FrameResources &frame, VkDeviceSize size);
+        void RebuildBatches(Registry &registry);
+        void WriteDescriptorSet(FrameResources &frame);
+        void RetireBuffer(std::unique_ptr<Buffer> &up_Buffer);
+
+    private:
+        Device &r_Device;
+        uint32_t m_FramesInFlight;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        VkPipelineLayout m_CullPipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<AsyncPipeline> up_Pipeline;
+        std::unique_ptr<AsyncPipeline> up_DeferredPipeline;
+        std::unique_ptr<ComputePipeline> up_CullPipeline;
+        std::unique_ptr<DescriptorSetLayout> up_SetLayout;
+        std::unique_ptr<DescriptorPool> up_DescriptorPool;
+        PFN_vkCmdDrawIndexedIndirectCountKHR m_pDrawIndexedIndirectCount = nullptr;
+
+        std::unique_ptr<Buffer> up_ObjectBuffer;
+        std::unique_ptr<Buffer> up_BatchBuffer;
+        std::unique_ptr<Buffer> up_CommandBuffer;
+        std::unique_ptr<Buffer> up_CountBuffer;
+        uint64_t m_BufferGeneration = 0;
+        // replaced buffers wait until the frames that used them have retired, keyed by update count
+        std::vector<std::pair<uint64_t, std::unique_ptr<Buffer>>> m_RetiredBuffers;
+        std::vector<FrameResources> m_Frames;
+
+        std::vector<Batch> m_Batches;
+        std::vector<ObjectRecord> m_Objects; // indexed by object index, the objects of a batch are contiguous
+        std::vector<GpuObject> m_Staged;
+        uint64_t m_ModelVersion = 0;
+        uint64_t m_WorldVersion = 0;
+        uint64_t m_ColorVersion = 0;
+
+        uint64_t m_UpdateCount = 0;
+        uint64_t m_TotalUploaded = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,288 @@
+#include "Light_Cluster_System.hpp"
+#include "Cpu_Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+namespace Divine
+{
+    static constexpr uint32_t s_BinGroupSize = 64; // local_size_x of light_cluster.comp
+
+    static uint32_t ToTile(float ndc, uint32_t tileCount)
+    {
+        float tile = std::floor((ndc * 0.5f + 0.5f) * tileCount);
+        return static_cast<uint32_t>(std::clamp(tile, 0.0f, static_cast<float>(tileCount - 1)));
+    }
+
+    LightClusterSystem::LightClusterSystem(Device &device, uint32_t framesInFlight, bool cpuBinning)
+        : r_Device{device}, m_CpuBinning{cpuBinning}, m_Frames(framesInFlight)
+    {
+        CreateBuffers();
+        if (!m_CpuBinning)
+        {
+            CreateDescriptors();
+            CreatePipeline();
+        }
+        else
+            m_Counts.resize(s_ClusterCount);
+    }
+
+    LightClusterSystem::~LightClusterSystem()
+    {
+        up_Pipeline = nullptr;
+        vkDestroyPipelineLayout(r_Device.GetDevice(), m_PipelineLayout, nullptr);
+    }
+
+    void LightClusterSystem::CreateBuffers()
+    {
+        // the CPU binning writes the lists in place, the compute pass keeps them on the device
+        VkMemoryPropertyFlags listMemory = m_CpuBinning ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                        : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        for (FrameResources &frame : m_Frames)
+        {
+            frame.up_LightBuffer = std::make_unique<Buffer>(r_Device,
+                                                            sizeof(PointLight),
+                                                            MAX_LIGHTS,
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            frame.up_LightBuffer->Map();
+            frame.up_CountBuffer = std::make_unique<Buffer>(r_Device,
+                                                            sizeof(uint32_t),
+                                                            s_ClusterCount,
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                            listMemory);
+            frame.up_IndexBuffer = std::make_unique<Buffer>(r_Device,
+                                                            sizeof(uint32_t),
+                                                            s_ClusterCount * s_MaxLightsPerCluster,
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                            listMemory);
+            if (m_CpuBinning)
+            {
+                frame.up_CountBuffer->Map();
+                frame.up_IndexBuffer->Map();
+            }
+        }
+    }
+
+    void LightClusterSystem::CreateDescriptors()
+    {
+        up_SetLayout = DescriptorSetLayout::Builder(r_Device)
+                           .AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                           .Build();
+
+        uint32_t frameCount = static_cast<uint32_t>(m_Frames.size());
+        up_DescriptorPool = DescriptorPool::Builder(r_Device)
+                                .SetMaxSets(frameCount)
+                                .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameCount)
+                                .Build();
+
+        for (FrameResources &frame : m_Frames)
+        {
+            auto lightInfo = frame.up_LightBuffer->GetDescriptorBufferInfo();
+            auto countInfo = frame.up_CountBuffer->GetDescriptorBufferInfo();
+            auto indexInfo = frame.up_IndexBuffer->GetDescriptorBufferInfo();
+            bool built = DescriptorWriter(*up_SetLayout, *up_DescriptorPool)
+                             .WriteBuffer(0, &lightInfo)
+                             .WriteBuffer(1, &countInfo)
+                             .WriteBuffer(2, &indexInfo)
+                             .Build(frame.descriptorSet);
+            if (!built)
+                throw std::runtime_error("Failed to allocate light cluster descriptor set!");
+        }
+    }
+
+    void LightClusterSystem::CreatePipeline()
+    {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(BinPushConstantData);
+
+        VkDescriptorSetLayout setLayout = up_SetLayout->GetDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &setLayout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(r_Device.GetDevice(), &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create light cluster pipeline layout!");
+
+        // the grid is specialized into the shader so it can't drift from the one the fragments look up
+        std::array<uint32_t, 4> constants = {s_GridX, s_GridY, s_GridZ, s_MaxLightsPerCluster};
+        std::array<VkSpecializationMapEntry, 4> entries{};
+        for (uint32_t i = 0; i < entries.size(); ++i)
+            entries[i] = {i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t)};
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+        specializationInfo.pMapEntries = entries.data();
+        specializationInfo.dataSize = sizeof(constants);
+        specializationInfo.pData = constants.data();
+
+        up_Pipeline = std::make_unique<ComputePipeline>(r_Device, HOME_DIR "res/shaders/light_cluster.comp.spv", m_PipelineLayout, &specializationInfo);
+    }
+
+    void LightClusterSystem::Update(FrameInfo &frameInfo, GlobalUBO &ubo, const std::vector<PointLight> &lights)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        const glm::mat4 &projection = frameInfo.camera.GetProjectionMat();
+        assert(projection[2][3] == 1.0f && projection[3][3] == 0.0f && "Clustered lighting expects a perspective projection");
+
+        // Camera maps the view depth near..far to 0..1 and keeps the view depth in w
+        float near = -projection[3][2] / projection[2][2];
+        float far = projection[3][2] / (1.0f - projection[2][2]);
+        float sliceScale = s_GridZ / std::log(far / near);
+
+        assert(lights.size() <= MAX_LIGHTS && "Point lights exceed maximum specified");
+        uint32_t lightCount = static_cast<uint32_t>(std::min<size_t>(lights.size(), MAX_LIGHTS));
+
+        ubo.ClusterGrid = glm::uvec4(s_GridX, s_GridY, s_GridZ, s_MaxLightsPerCluster);
+        ubo.ClusterDepth = glm::vec4(near, far, sliceScale, -std::log(near) * sliceScale);
+        ubo.numLights = static_cast<int>(lightCount);
+
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+        std::memcpy(frame.up_LightBuffer->GetMappedMemory(), lights.data(), lightCount * sizeof(PointLight));
+        frame.push.view = frameInfo.camera.GetViewMat();
+        frame.push.projection = glm::vec4(projection[0][0], projection[1][1], near, far);
+        frame.push.lightCount = lightCount;
+
+        ++m_UpdateCount;
+        m_TotalLights += lightCount;
+        if (m_CpuBinning)
+            BinLights(frame, lights);
+    }
+
+    void LightClusterSystem::BinLights(FrameResources &frame, const std::vector<PointLight> &lights)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        const BinPushConstantData &push = frame.push;
+        const float near = push.projection.z;
+        const float far = push.projection.w;
+        const float sliceScale = s_GridZ / std::log(far / near);
+        for (uint32_t z = 0; z <= s_GridZ; ++z)
+            m_SliceDepths[z] = near * std::pow(far / near, static_cast<float>(z) / s_GridZ);
+
+        uint32_t *pIndices = static_cast<uint32_t *>(frame.up_IndexBuffer->GetMappedMemory());
+        std::fill(m_Counts.begin(), m_Counts.end(), 0u);
+
+        // lights only visit the clusters under their screen space bounds, the exact test is the one
+        // of light_cluster.comp: the sphere against the view space box around the cluster
+        for (uint32_t i = 0; i < push.lightCount; ++i)
+        {
+            glm::vec3 center = glm::vec3(push.view * glm::vec4(glm::vec3(lights[i].Position), 1.0f));
+            float range = lights[i].Range;
+            float minDepth = std::max(center.z - range, near);
+            float maxDepth = std::min(center.z + range, far);
+            if (minDepth > maxDepth)
+                continue;
+
+            // for a fixed view offset the projection is monotonic in depth, so the box around the
+            // sphere projects inside the ratios at its depth bounds
+            auto project = [&](float offset, float scale, float &low, float &high)
+            {
+                float a = (offset - range) * scale;
+                float b = (offset + range) * scale;
+                low = std::min({a / minDepth, a / maxDepth, b / minDepth, b / maxDepth});
+                high = std::max({a / minDepth, a / maxDepth, b / minDepth, b / maxDepth}); };
+            float left, right, top, bottom;
+            project(center.x, push.projection.x, left, right);
+            project(center.y, push.projection.y, top, bottom);
+            if (right < -1.0f || left > 1.0f || bottom < -1.0f || top > 1.0f)
+                continue;
+
+            uint32_t xBegin = ToTile(left, s_GridX), xEnd = ToTile(right, s_GridX);
+            uint32_t yBegin = ToTile(top, s_GridY), yEnd = ToTile(bottom, s_GridY);
+            uint32_t zBegin = std::min(static_cast<uint32_t>(std::log(minDepth / near) * sliceScale), s_GridZ - 1);
+            uint32_t zEnd = std::min(static_cast<uint32_t>(std::log(maxDepth / near) * sliceScale), s_GridZ - 1);
+
+            for (uint32_t z = zBegin; z <= zEnd; ++z)
+            {
+                float sliceNear = m_SliceDepths[z];
+                float sliceFar = m_SliceDepths[z + 1];
+                float closestZ = std::clamp(center.z, sliceNear, sliceFar) - center.z;
+                for (uint32_t y = yBegin; y <= yEnd; ++y)
+                {
+                    float y0 = (2.0f * y / s_GridY - 1.0f) / push.projection.y;
+                    float y1 = (2.0f * (y + 1) / s_GridY - 1.0f) / push.projection.y;
+                    float minY = std::min({y0 * sliceNear, y0 * sliceFar, y1 * sliceNear, y1 * sliceFar});
+                    float maxY = std::max({y0 * sliceNear, y0 * sliceFar, y1 * sliceNear, y1 * sliceFar});
+                    float closestY = std::clamp(center.y, minY, maxY) - center.y;
+                    for (uint32_t x = xBegin; x <= xEnd; ++x)
+                    {
+                        float x0 = (2.0f * x / s_GridX - 1.0f) / push.projection.x;
+                        float x1 = (2.0f * (x + 1) / s_GridX - 1.0f) / push.projection.x;
+                        float minX = std::min({x0 * sliceNear, x0 * sliceFar, x1 * sliceNear, x1 * sliceFar});
+                        float maxX = std::max({x0 * sliceNear, x0 * sliceFar, x1 * sliceNear, x1 * sliceFar});
+                        float closestX = std::clamp(center.x, minX, maxX) - center.x;
+                        if (closestX * closestX + closestY * closestY + closestZ * closestZ > range * range)
+                            continue;
+
+                        uint32_t cluster = x + s_GridX * (y + s_GridY * z);
+                        uint32_t &count = m_Counts[cluster];
+                        if (count == s_MaxLightsPerCluster)
+                        {
+                            ++m_TotalDropped;
+                            continue;
+                        }
+                        pIndices[cluster * s_MaxLightsPerCluster + count++] = i;
+                        ++m_TotalEntries;
+                    }
+                }
+            }
+        }
+
+        std::memcpy(frame.up_CountBuffer->GetMappedMemory(), m_Counts.data(), m_Counts.size() * sizeof(uint32_t));
+    }
+
+    void LightClusterSystem::RecordBinning(FrameInfo &frameInfo)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        assert(!m_CpuBinning && "The lights were already binned on the CPU");
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+
+        up_Pipeline->Bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_PipelineLayout,
+            0,
+            1,
+            &frame.descriptorSet,
+            0,
+            nullptr);
+
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_PipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            static_cast<uint32_t>(sizeof(BinPushConstantData)),
+            &frame.push);
+
+        // one invocation per cluster, empty clusters still have their count cleared
+        vkCmdDispatch(frameInfo.commandBuffer, ComputePipeline::GetGroupCount(s_ClusterCount, s_BinGroupSize), 1, 1);
+    }
+
+    void LightClusterSystem::Report(std::ostream &os) const
+    {
+        if (m_UpdateCount == 0)
+            return;
+
+        os << "\tClustered lighting: " << s_GridX << "x" << s_GridY << "x" << s_GridZ << " clusters, "
+           << std::fixed << std::setprecision(1) << static_cast<double>(m_TotalLights) / m_UpdateCount
+           << " lights per frame binned on the " << (m_CpuBinning ? "CPU" : "GPU");
+        if (m_CpuBinning)
+            os << ", " << static_cast<double>(m_TotalEntries) / m_UpdateCount << " list entries per frame, "
+               << m_TotalDropped << " dropped";
+        os << std::endl;
+        os.unsetf(std::ios::fixed);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef LIGHT_CLUSTER_SYSTEM_HEADER
+#define LIGHT_CLUSTER_SYSTEM_HEADER
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "Compute_Pipeline.hpp"
+#include "FrameInfo.hpp"
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace Divine
+{
+    // Clustered forward lighting. The view frustum is split into screen space tiles and exponential depth
+    // slices, every cluster lists the lights whose range reaches it, so a fragment only shades the lights
+    // of its own cluster whatever the light count. The lists are built by a compute pass, or on the CPU
+    // into host visible buffers when cpuBinning is set. Lights beyond the capacity of a cluster are dropped.
+    class LightClusterSystem
+    {
+    public:
+        static constexpr uint32_t s_GridX = 16;
+        static constexpr uint32_t s_GridY = 9;
+        static constexpr uint32_t s_GridZ = 24;
+        static constexpr uint32_t s_ClusterCount = s_GridX * s_GridY * s_GridZ;
+        static constexpr uint32_t s_MaxLightsPerCluster = 128;
+
+        LightClusterSystem(Device &device, uint32_t framesInFlight, bool cpuBinning);
+        ~LightClusterSystem();
+        LightClusterSystem(const LightClusterSystem &) = delete;
+        LightClusterSystem &operator=(const LightClusterSystem &) = delete;
+
+        // the buffers never grow, the global descriptor sets are written once
+        inline VkDescriptorBufferInfo GetLightInfo(uint32_t frameIndex) { return m_Frames[frameIndex].up_LightBuffer->GetDescriptorBufferInfo(); }
+        inline VkDescriptorBufferInfo GetCountInfo(uint32_t frameIndex) { return m_Frames[frameIndex].up_CountBuffer->GetDescriptorBufferInfo(); }
+        inline VkDescriptorBufferInfo GetIndexInfo(uint32_t frameIndex) { return m_Frames[frameIndex].up_IndexBuffer->GetDescriptorBufferInfo(); }
+        inline VkBuffer GetCountBuffer(uint32_t frameIndex) const { return m_Frames[frameIndex].up_CountBuffer->GetBuffer(); }
+        inline VkBuffer GetIndexBuffer(uint32_t frameIndex) const { return m_Frames[frameIndex].up_IndexBuffer->GetBuffer(); }
+        inline bool IsCpuBinning() const { return m_CpuBinning; }
+        // lights the last update uploaded to the frame slot
+        inline uint32_t GetLightCount(uint32_t frameIndex) const { return m_Frames[frameIndex].push.lightCount; }
+
+        // uploads up to MAX_LIGHTS lights to the frame slot, fills numLights and the cluster parameters
+        // of the ubo and bins the lights right away on the CPU
+        void Update(FrameInfo &frameInfo, GlobalUBO &ubo, const std::vector<PointLight> &lights);
+        // compute pass, bins the lights uploaded by the update
+        void RecordBinning(FrameInfo &frameInfo);
+
+        void Report(std::ostream &os) const;
+
+    private:
+        // layout shared with light_cluster.comp
+        struct BinPushConstantData
+        {
+            glm::mat4 view;
+            glm::vec4 projection; // [0][0] and [1][1] of the projection, near and far
+            uint32_t lightCount;
+        };
+
+        struct FrameResources
+        {
+            std::unique_ptr<Buffer> up_LightBuffer;
+            std::unique_ptr<Buffer> up_CountBuffer;
+            std::unique_ptr<Buffer> up_IndexBuffer;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            BinPushConstantData push{};
+        };
+
+        void CreateBuffers();
+        void CreateDescriptors();
+        void CreatePipeline();
+        void BinLights(FrameResources &frame, const std::vector<PointLight> &lights);
+
+    private:
+        Device &r_Device;
+        bool m_CpuBinning;
+        VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<ComputePipeline> up_Pipeline;
+        std::unique_ptr<DescriptorSetLayout> up_SetLayout;
+        std::unique_ptr<DescriptorPool> up_DescriptorPool;
+        std::vector<FrameResources> m_Frames;
+
+        // CPU binning, view depth of every slice boundary and the light count of every cluster
+        std::array<float, s_GridZ + 1> m_SliceDepths{};
+        std::vector<uint32_t> m_Counts;
+
+        uint64_t m_UpdateCount = 0;
+        uint64_t m_TotalLights = 0;
+        uint64_t m_TotalEntries = 0;  // cluster list entries written by the CPU binning
+        uint64_t m_TotalDropped = 0;  // entries beyond the capacity of their cluster
+    };
+}
+
+#endif
@@ -1,141 +1,188 @@
 #include "PointLight_System.hpp"
+#include "Cpu_Profiler.hpp"
 
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 #include <array>
-#include <map>
+#include <cmath>
 
 namespace Divine
 {
-    PointLightSystem::PointLightSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-        : r_Device{device}
+    static constexpr uint32_t s_MinLightCapacity = 16;
+    // intensity over squared distance below which a light without a range stops contributing
+    static constexpr float s_LightCutoff = 0.01f;
+
+    PointLightSystem::PointLightSystem(Device &device, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight)
+        : r_Device{device}, m_Frames(framesInFlight)
     {
+        CreateDescriptors();
         CreatePipelineLayout(globalSetLayout);
-        CreatePipeline(renderPass);
+        CreatePipeline(compiler, renderPass);
     }
 
     PointLightSystem::~PointLightSystem()
     {
+        up_Pipeline = nullptr;
+        up_DeferredPipeline = nullptr;
         vkDestroyPipelineLayout(r_Device.GetDevice(), m_PipelineLayout, nullptr);
     }
 
-    void PointLightSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
+    void PointLightSystem::CreateDescriptors()
     {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(PointLightPushData);
+        up_SetLayout = DescriptorSetLayout::Builder(r_Device)
+                           .AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                           .Build();
+
+        uint32_t frameCount = static_cast<uint32_t>(m_Frames.size());
+        up_DescriptorPool = DescriptorPool::Builder(r_Device)
+                                .SetMaxSets(frameCount)
+                                .AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount)
+                                .Build();
+
+        for (FrameResources &frame : m_Frames)
+            ReserveFrame(frame, s_MinLightCapacity);
+    }
 
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout};
+    void PointLightSystem::ReserveFrame(FrameResources &frame, uint32_t lightCount)
+    {
+        uint32_t capacity = frame.up_OrderBuffer != nullptr ? frame.up_OrderBuffer->GetInstanceCount() : 0;
+        if (frame.up_OrderBuffer != nullptr && lightCount <= capacity)
+            return;
+
+        capacity = std::max({lightCount, capacity * 2, s_MinLightCapacity});
+        frame.up_OrderBuffer = std::make_unique<Buffer>(r_Device,
+                                                        sizeof(uint32_t),
+                                                        capacity,
+                                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.up_OrderBuffer->Map();
+
+        auto orderInfo = frame.up_OrderBuffer->GetDescriptorBufferInfo();
+        DescriptorWriter writer(*up_SetLayout, *up_DescriptorPool);
+        writer.WriteBuffer(0, &orderInfo);
+
+        if (frame.descriptorSet == VK_NULL_HANDLE)
+        {
+            if (!writer.Build(frame.descriptorSet))
+                throw std::runtime_error("Failed to allocate point light descriptor set!");
+        }
+        else
+            writer.OverWrite(frame.descriptorSet);
+    }
+
+    void PointLightSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
+    {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout, up_SetLayout->GetDescriptorSetLayout()};
 
         VkPipelineLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         layoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        layoutInfo.pushConstantRangeCount = 1;
-        layoutInfo.pPushConstantRanges = &pushConstantRange;
+        layoutInfo.pushConstantRangeCount = 0;
+        layoutInfo.pPushConstantRanges = nullptr;
 
         if (vkCreatePipelineLayout(r_Device.GetDevice(), &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
             throw std::runtime_error("Failed to create pipeline layout!");
     }
 
-    void PointLightSystem::CreatePipeline(VkRenderPass renderPass)
+    void PointLightSystem::CreatePipeline(PipelineCompiler &compiler, VkRenderPass renderPass)
+    {
+        up_Pipeline = CompilePipeline(compiler, renderPass, 0);
+    }
+
+    void PointLightSystem::CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass)
+    {
+        up_DeferredPipeline = CompilePipeline(compiler, renderPass, subpass);
+    }
+
+    std::unique_ptr<AsyncPipeline> PointLightSystem::CompilePipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass)
     {
         assert(m_PipelineLayout != VK_NULL_HANDLE &&
                "Can't create pipeline without pipeline layout");
-        PipelineConfigInfo configInfo{};
+        PipelineRequest request{};
+        request.vertFilePath = HOME_DIR "res/shaders/point_light.vert.spv";
+        request.fragFilePath = HOME_DIR "res/shaders/point_light.frag.spv";
+
+        PipelineConfigInfo &configInfo = *request.up_ConfigInfo;
         Pipeline::DefaultPipelineConfigInfo(configInfo);
         Pipeline::EnableAlphaBlending(configInfo);
         configInfo.renderPass = renderPass;
+        configInfo.subpass = subpass;
         configInfo.pipelineLayout = m_PipelineLayout;
 
         configInfo.bindingDescriptions.clear();
         configInfo.attributeDescriptions.clear();
 
-        up_Pipeline = std::make_unique<Pipeline>(
-            r_Device,
-            HOME_DIR "res/shaders/point_light.vert.spv",
-            HOME_DIR "res/shaders/point_light.frag.spv",
-            configInfo);
+        return compiler.CompileAsync(std::move(request));
     }
 
-    void PointLightSystem::Update(FrameInfo &frameInfo, GlobalUBO &ubo)
+    void PointLightSystem::Update(FrameInfo &frameInfo, std::vector<PointLight> &lights)
     {
+        DIVINE_PROFILE_FUNCTION();
         auto rotateLight = glm::rotate(glm::mat4(1.0f),
                                        frameInfo.frameTime,
                                        {0.f, -1.f, 0.f});
 
-        int lightIndex = 0;
-        for (auto &kv : frameInfo.gameObjects)
-        {
-            auto &obj = kv.second;
-            if (obj.up_PointLight == nullptr)
-                continue;
-
-            assert(lightIndex < MAX_LIGHTS &&
-                   "Point lights exceed maximum specified");
-
-            // update light position
-            obj.m_ModelMatrix.translation = glm::vec3(rotateLight * glm::vec4(obj.m_ModelMatrix.translation, 1.0f));
-
-            // copy light to ubo
-            ubo.PointLights[lightIndex].Position = glm::vec4(obj.m_ModelMatrix.translation, 1.0f);         // w will be ignored
-            ubo.PointLights[lightIndex].Color = glm::vec4(obj.m_Color, obj.up_PointLight->lightIntensity); // w is intensity
-
-            ++lightIndex;
-        }
-
-        ubo.numLights = lightIndex;
+        lights.clear();
+        auto view = frameInfo.registry.GetView<PointLightComponent, TransformComponent, ColorComponent>();
+        view.Each([&](Entity, PointLightComponent &light, TransformComponent &transform, ColorComponent &color)
+                  {
+                      // update light position
+                      transform.SetTranslation(glm::vec3(rotateLight * glm::vec4(transform.translation, 1.0f)));
+
+                      PointLight &pointLight = lights.emplace_back();
+                      pointLight.Position = glm::vec4(transform.translation, 1.0f);    // w will be ignored
+                      pointLight.Color = glm::vec4(color.color, light.lightIntensity); // w is intensity
+                      pointLight.Radius = light.radius;
+                      pointLight.Range = light.range > 0.0f ? light.range : std::sqrt(light.lightIntensity / s_LightCutoff); });
     }
 
-    void PointLightSystem::Render(FrameInfo &frameInfo)
+    void PointLightSystem::Render(FrameInfo &frameInfo, bool deferred)
     {
-        // sort lights
-        std::map<float, DivineGameObject::id_t> sorted; // by default compare by "less" of the "key"
-        for (auto &kv : frameInfo.gameObjects)
-        {
-            auto &obj = kv.second;
-            if (obj.up_PointLight == nullptr)
-                continue;
-
-            // calculate distence
-            auto offset = frameInfo.camera.GetPosition() - obj.m_ModelMatrix.translation;
-            float disSquared = glm::dot(offset, offset);
-            sorted[disSquared] = obj.GetID();
-        }
-
-        up_Pipeline->Bind(frameInfo.commandBuffer);
-
+        DIVINE_PROFILE_FUNCTION();
+        assert((!deferred || up_DeferredPipeline != nullptr) && "The deferred pipeline was never created");
+        auto &lights = frameInfo.registry.GetPool<PointLightComponent>();
+        FrameResources &frame = m_Frames[frameInfo.frameIndex];
+        uint32_t maxLightCount = std::min<uint32_t>(static_cast<uint32_t>(lights.GetSize()), MAX_LIGHTS);
+        ReserveFrame(frame, maxLightCount);
+
+        // the light buffer holds the lights in view order, the order list sorts them back to front and
+        // equal distances keep the view order instead of overwriting each other
+        uint32_t lightCount = 0;
+        m_TransparencyQueue.Clear();
+        auto view = frameInfo.registry.GetView<PointLightComponent, TransformComponent, ColorComponent>();
+        view.Each([&](Entity, PointLightComponent &, TransformComponent &transform, ColorComponent &)
+                  {
+                      if (lightCount == maxLightCount)
+                          return;
+
+                      auto offset = frameInfo.camera.GetPosition() - transform.translation;
+                      m_TransparencyQueue.Push(glm::dot(offset, offset), lightCount);
+                      ++lightCount; });
+        if (lightCount == 0)
+            return;
+
+        m_TransparencyQueue.Sort();
+        uint32_t *pOrder = static_cast<uint32_t *>(frame.up_OrderBuffer->GetMappedMemory());
+        for (uint32_t i = 0; i < lightCount; ++i)
+            pOrder[i] = m_TransparencyQueue[i];
+
+        (deferred ? up_DeferredPipeline : up_Pipeline)->Bind(frameInfo.commandBuffer);
+
+        std::array<VkDescriptorSet, 2> descriptorSets = {frameInfo.globalDescriptorSet, frame.descriptorSet};
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             m_PipelineLayout,
             0,
-            1,
-            &frameInfo.globalDescriptorSet,
+            static_cast<uint32_t>(descriptorSets.size()),
+            descriptorSets.data(),
             0,
             nullptr);
 
-        // iterate in reverse order so that we render objects from back to front
-        for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
-        {
-            // using ID to find game object since game object is NOT copyable
-            auto &obj = frameInfo.gameObjects.at(it->second);
-
-            PointLightPushData push{};
-            push.position = glm::vec4(obj.m_ModelMatrix.translation, 1.0f);
-            push.color = glm::vec4(obj.m_Color, obj.up_PointLight->lightIntensity);
-            push.radius = obj.m_ModelMatrix.scale.x;
-
-            vkCmdPushConstants(frameInfo.commandBuffer,
-                               m_PipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                               0,
-                               static_cast<uint32_t>(sizeof(PointLightPushData)),
-                               &push);
-
-            vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-        }
+        // six vertices of a quad per light, the instance picks the light
+        vkCmdDraw(frameInfo.commandBuffer, 6, lightCount, 0, 0);
     }
 
 }
\ No newline at end of file
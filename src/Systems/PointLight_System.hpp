@@ -2,40 +2,60 @@
 #define POINTLIGHT_SYSTEM_HEADER
 
 #include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
 #include "Pipeline.hpp"
+#include "Pipeline_Compiler.hpp"
 #include "Game_Object.hpp"
 #include "FrameInfo.hpp"
+#include "Transparency_Queue.hpp"
 
 #include <memory>
+#include <vector>
 
 namespace Divine
 {
-    struct PointLightPushData
-    {
-        glm::vec4 position{};
-        glm::vec4 color{};
-        float radius;
-    };
-
+    // Billboards of every light in one instanced draw. The lights are read from the light buffer of the
+    // global set, the back to front order is written to a storage buffer of the frame slot and the vertex
+    // shader looks its light up by instance.
     class PointLightSystem
     {
     public:
-        PointLightSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+        PointLightSystem(Device &device, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight);
         ~PointLightSystem();
         PointLightSystem(const PointLightSystem &) = delete;
         PointLightSystem &operator=(const PointLightSystem &) = delete;
 
-        void Update(FrameInfo &frameInfo, GlobalUBO &ubo);
-        void Render(FrameInfo &frameInfo);
+        // animates the lights and gathers them in view order for LightClusterSystem::Update
+        void Update(FrameInfo &frameInfo, std::vector<PointLight> &lights);
+        // variant for the forward subpass that follows the lighting of the deferred render pass
+        void CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass);
+        inline bool IsDeferredPipelineReady() const { return up_DeferredPipeline != nullptr && up_DeferredPipeline->IsReady(); }
+        void Render(FrameInfo &frameInfo, bool deferred = false);
 
     private:
+        struct FrameResources
+        {
+            std::unique_ptr<Buffer> up_OrderBuffer;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        };
+
+        void CreateDescriptors();
         void CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout);
-        void CreatePipeline(VkRenderPass renderPass);
+        void CreatePipeline(PipelineCompiler &compiler, VkRenderPass renderPass);
+        std::unique_ptr<AsyncPipeline> CompilePipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass);
+        // grows the slot's order buffer to hold lightCount lights and points its descriptor set at it
+        void ReserveFrame(FrameResources &frame, uint32_t lightCount);
 
     private:
         Device &r_Device;
         VkPipelineLayout m_PipelineLayout;
-        std::unique_ptr<Pipeline> up_Pipeline;
+        std::unique_ptr<AsyncPipeline> up_Pipeline;
+        std::unique_ptr<AsyncPipeline> up_DeferredPipeline;
+        std::unique_ptr<DescriptorSetLayout> up_SetLayout;
+        std::unique_ptr<DescriptorPool> up_DescriptorPool;
+        std::vector<FrameResources> m_Frames;
+        TransparencyQueue m_TransparencyQueue; // values are light indices
     };
 }
 
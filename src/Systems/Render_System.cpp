@@ -1,94 +1,324 @@
 #include "Render_System.hpp"
+#include "Cpu_Profiler.hpp"
+#include "Frustum_Cull.hpp"
+#include "Sphere_Overlap.hpp"
+#include "Command_Recorder.hpp"
 
 #include <iostream>
+#include <iomanip>
 #include <stdexcept>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
 
 namespace Divine
 {
-    RenderSystem::RenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-        : r_Device{device}
+    static constexpr uint32_t s_MinInstanceCapacity = 64;
+    // instances per pool task, one assignment costs a pass over every light
+    static constexpr size_t s_MinAssignRange = 32;
+
+    static_assert(MAX_LIGHTS <= 0x10000, "Instance light lists hold 16 bit light indices");
+
+    std::vector<VkVertexInputBindingDescription> InstanceData::GetBindingDescriptions()
+    {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+
+        bindingDescriptions[0].binding = 1;
+        bindingDescriptions[0].stride = sizeof(InstanceData);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> InstanceData::GetAttributeDescriptions()
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+        // matrices take one location per column, after the 4 of Model::Vertex
+        for (uint32_t column = 0; column < 4; ++column)
+            attributeDescriptions.push_back({4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4))});
+        for (uint32_t column = 0; column < 3; ++column)
+            attributeDescriptions.push_back({8 + column, 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec4))});
+        attributeDescriptions.push_back({11, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, color)});
+        attributeDescriptions.push_back({12, 1, VK_FORMAT_R32G32B32A32_UINT, offsetof(InstanceData, lights)});
+        attributeDescriptions.push_back({13, 1, VK_FORMAT_R32_UINT, offsetof(InstanceData, lightCount)});
+
+        return attributeDescriptions;
+    }
+
+    RenderSystem::RenderSystem(Device &device, ThreadPool &threadPool, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight)
+        : r_Device{device}, r_ThreadPool{threadPool}, m_InstanceBuffers(framesInFlight)
     {
         CreatePipelineLayout(globalSetLayout);
-        CreatePipeline(renderPass);
+        CreatePipeline(compiler, renderPass);
     }
 
     RenderSystem::~RenderSystem()
     {
+        up_Pipeline = nullptr;
+        up_DeferredPipeline = nullptr;
         vkDestroyPipelineLayout(r_Device.GetDevice(), m_PipelineLayout, nullptr);
     }
 
     void RenderSystem::CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout)
     {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(PushConstantData);
-
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout};
 
         VkPipelineLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         layoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        layoutInfo.pushConstantRangeCount = 1;
-        layoutInfo.pPushConstantRanges = &pushConstantRange;
+        layoutInfo.pushConstantRangeCount = 0;
+        layoutInfo.pPushConstantRanges = nullptr;
 
         if (vkCreatePipelineLayout(r_Device.GetDevice(), &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
             throw std::runtime_error("Failed to create pipeline layout!");
     }
 
-    void RenderSystem::CreatePipeline(VkRenderPass renderPass)
+    void RenderSystem::FillPipelineConfigInfo(PipelineConfigInfo &configInfo, VkRenderPass renderPass)
     {
         assert(m_PipelineLayout != VK_NULL_HANDLE &&
                "Can't create pipeline without pipeline layout");
-        PipelineConfigInfo configInfo{};
         Pipeline::DefaultPipelineConfigInfo(configInfo);
         configInfo.renderPass = renderPass;
         configInfo.pipelineLayout = m_PipelineLayout;
+        std::vector<VkVertexInputBindingDescription> instanceBindings = InstanceData::GetBindingDescriptions();
+        std::vector<VkVertexInputAttributeDescription> instanceAttributes = InstanceData::GetAttributeDescriptions();
+        configInfo.bindingDescriptions.insert(configInfo.bindingDescriptions.end(), instanceBindings.begin(), instanceBindings.end());
+        configInfo.attributeDescriptions.insert(configInfo.attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+    }
 
-        up_Pipeline = std::make_unique<Pipeline>(
-            r_Device,
-            HOME_DIR "res/shaders/basic_vert.vert.spv",
-            HOME_DIR "res/shaders/basic_frag.frag.spv",
-            configInfo);
+    void RenderSystem::CreatePipeline(PipelineCompiler &compiler, VkRenderPass renderPass)
+    {
+        PipelineRequest request{};
+        request.vertFilePath = HOME_DIR "res/shaders/basic_vert.vert.spv";
+        request.fragFilePath = HOME_DIR "res/shaders/basic_frag.frag.spv";
+        FillPipelineConfigInfo(*request.up_ConfigInfo, renderPass);
+
+        up_Pipeline = compiler.CompileAsync(std::move(request));
     }
 
-    void RenderSystem::RenderGameObjects(FrameInfo &frameInfo)
+    void RenderSystem::CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass)
     {
-        up_Pipeline->Bind(frameInfo.commandBuffer);
-
-        vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            m_PipelineLayout,
-            0,
-            1,
-            &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
-
-        for (auto &kv : frameInfo.gameObjects)
+        PipelineRequest request{};
+        request.vertFilePath = HOME_DIR "res/shaders/basic_vert.vert.spv";
+        request.fragFilePath = HOME_DIR "res/shaders/gbuffer.frag.spv";
+        FillPipelineConfigInfo(*request.up_ConfigInfo, renderPass);
+        request.up_ConfigInfo->subpass = subpass;
+        Pipeline::SetColorAttachmentCount(*request.up_ConfigInfo, 2); // albedo and normal
+
+        up_DeferredPipeline = compiler.CompileAsync(std::move(request));
+    }
+
+    void RenderSystem::CullGameObjects(FrameInfo &frameInfo, const Bvh &spatialIndex)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        // the tree discards whole off-screen regions, the spheres are tighter than the fat leaf boxes
+        std::array<glm::vec4, 6> planes = frameInfo.camera.GetFrustumPlanes();
+        auto &models = frameInfo.registry.GetPool<ModelComponent>();
+        auto &worldTransforms = frameInfo.registry.GetPool<WorldTransformComponent>();
+        auto &colors = frameInfo.registry.GetPool<ColorComponent>();
+        m_Candidates.clear();
+        spatialIndex.QueryFrustum(planes, [&](uint32_t entity)
+                                  {
+                                      glm::vec3 color = colors.Contains(entity) ? colors.Get(entity).color : glm::vec3{1.0f};
+                                      m_Candidates.push_back({models.Get(entity).sp_Model.get(), &worldTransforms.Get(entity), color}); });
+
+        size_t count = m_Candidates.size();
+        m_Spheres.resize(count * 4);
+        m_VisibleIndices.resize(count);
+        float *centerX = m_Spheres.data();
+        float *centerY = centerX + count;
+        float *centerZ = centerY + count;
+        float *radius = centerZ + count;
+
+        // world space spheres, the radius grows with the largest axis scale
+        for (size_t i = 0; i < count; ++i)
         {
-            auto &obj = kv.second;
-            if (obj.sp_Model == nullptr)
-                continue;
-
-            PushConstantData push{};
-            push.normalMatrix = obj.m_ModelMatrix.GetNormalMat();
-            push.modelMatrix = obj.m_ModelMatrix.GetModelMat();
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                m_PipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                static_cast<uint32_t>(sizeof(PushConstantData)),
-                &push);
-
-            obj.sp_Model->Bind(frameInfo.commandBuffer);
-            obj.sp_Model->Draw(frameInfo.commandBuffer);
+            const Model::BoundingSphere &sphere = m_Candidates[i].pModel->GetBoundingSphere();
+            const glm::mat4 &model = m_Candidates[i].pWorld->modelMatrix;
+            glm::vec3 center = glm::vec3(model * glm::vec4(sphere.center, 1.0f));
+            float scaleSquared = glm::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                                          glm::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                                                   glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+            centerX[i] = center.x;
+            centerY[i] = center.y;
+            centerZ[i] = center.z;
+            radius[i] = sphere.radius * glm::sqrt(scaleSquared);
         }
+
+        SphereBatch batch{centerX, centerY, centerZ, radius, count};
+        m_VisibleCount = CullSpheres(&planes[0].x, batch, m_VisibleIndices.data());
+
+        m_TestedCount = static_cast<uint32_t>(count);
+        m_DrawnCount = m_VisibleCount;
+        m_TotalTested += m_TestedCount;
+        m_TotalDrawn += m_DrawnCount;
+        ++m_CulledFrames;
+    }
+
+    void RenderSystem::WriteInstances(FrameInfo &frameInfo)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        // one pipeline and no materials yet, the model and the distance to the camera order the packets
+        glm::vec3 cameraPosition = glm::vec3(frameInfo.camera.GetInverseViewMat()[3]);
+        size_t count = m_Candidates.size();
+        const float *centerX = m_Spheres.data();
+        const float *centerY = centerX + count;
+        const float *centerZ = centerY + count;
+
+        m_DrawQueue.Clear();
+        for (uint32_t i = 0; i < m_VisibleCount; ++i)
+        {
+            uint32_t index = m_VisibleIndices[i];
+            float distance = glm::length(glm::vec3(centerX[index], centerY[index], centerZ[index]) - cameraPosition);
+            m_DrawQueue.Push(DrawKey::Make(0, 0, 0, m_Candidates[index].pModel->GetId(), DrawKey::QuantizeDepth(distance)), index);
+        }
+        m_DrawQueue.Sort();
+
+        std::unique_ptr<Buffer> &up_InstanceBuffer = m_InstanceBuffers[frameInfo.frameIndex];
+        uint32_t capacity = up_InstanceBuffer != nullptr ? up_InstanceBuffer->GetInstanceCount() : 0;
+        if (up_InstanceBuffer == nullptr || m_VisibleCount > capacity)
+        {
+            up_InstanceBuffer = std::make_unique<Buffer>(r_Device,
+                                                         sizeof(InstanceData),
+                                                         std::max({m_VisibleCount, capacity * 2, s_MinInstanceCapacity}),
+                                                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            up_InstanceBuffer->Map();
+        }
+
+        // world matrices are cached by TransformSystem, nothing is recomputed here
+        InstanceData *pInstances = static_cast<InstanceData *>(up_InstanceBuffer->GetMappedMemory());
+        for (uint32_t i = 0; i < m_VisibleCount; ++i)
+        {
+            const DrawCandidate &candidate = m_Candidates[m_DrawQueue[i].value];
+            pInstances[i].modelMatrix = candidate.pWorld->modelMatrix;
+            pInstances[i].normalMatrix = candidate.pWorld->normalMatrix;
+            pInstances[i].color = glm::vec4(candidate.color, 1.0f);
+        }
+    }
+
+    void RenderSystem::AssignLights(const std::vector<PointLight> &lights, InstanceData *pInstances)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        // the light buffer holds the first MAX_LIGHTS lights
+        size_t lightCount = std::min<size_t>(lights.size(), MAX_LIGHTS);
+        m_LightSpheres.resize(lightCount * 4);
+        float *centerX = m_LightSpheres.data();
+        float *centerY = centerX + lightCount;
+        float *centerZ = centerY + lightCount;
+        float *radius = centerZ + lightCount;
+        for (size_t i = 0; i < lightCount; ++i)
+        {
+            centerX[i] = lights[i].Position.x;
+            centerY[i] = lights[i].Position.y;
+            centerZ[i] = lights[i].Position.z;
+            radius[i] = lights[i].Range;
+        }
+        SphereBatch batch{centerX, centerY, centerZ, radius, lightCount};
+
+        std::atomic<uint32_t> assignedLights{0};
+        std::atomic<uint32_t> clusterShaded{0};
+        r_ThreadPool.ParallelFor(m_VisibleCount, s_MinAssignRange, [&](size_t begin, size_t end)
+                                 {
+                                     uint32_t rangeLights = 0;
+                                     uint32_t rangeClusterShaded = 0;
+                                     std::array<uint32_t, InstanceData::s_MaxLights> indices;
+                                     for (size_t i = begin; i < end; ++i)
+                                     {
+                                         // world box of the local bounds, much tighter than the sphere for flat objects
+                                         const DrawCandidate &candidate = m_Candidates[m_DrawQueue[i].value];
+                                         const Model::BoundingBox &local = candidate.pModel->GetBoundingBox();
+                                         const glm::mat4 &model = candidate.pWorld->modelMatrix;
+                                         glm::vec3 center = glm::vec3(model * glm::vec4((local.min + local.max) * 0.5f, 1.0f));
+                                         glm::vec3 extent = glm::mat3(glm::vec3(glm::abs(model[0])), glm::vec3(glm::abs(model[1])), glm::vec3(glm::abs(model[2]))) * ((local.max - local.min) * 0.5f);
+                                         glm::vec3 boxMin = center - extent;
+                                         glm::vec3 boxMax = center + extent;
+                                         uint32_t count = OverlapSpheresBox(batch, &boxMin.x, &boxMax.x, indices.data(), InstanceData::s_MaxLights);
+
+                                         // packed on the stack, the instance buffer may be write combined
+                                         glm::uvec4 packed{0};
+                                         if (count > InstanceData::s_MaxLights)
+                                         {
+                                             count = InstanceData::s_UseClusters;
+                                             ++rangeClusterShaded;
+                                         }
+                                         else
+                                         {
+                                             for (uint32_t j = 0; j < count; ++j)
+                                                 packed[j / 2] |= indices[j] << (j % 2 * 16);
+                                             rangeLights += count;
+                                         }
+                                         pInstances[i].lights = packed;
+                                         pInstances[i].lightCount = count;
+                                     }
+                                     assignedLights += rangeLights;
+                                     clusterShaded += rangeClusterShaded; });
+
+        m_TotalAssignedLights += assignedLights;
+        m_TotalClusterShaded += clusterShaded;
+        m_TotalAssigned += m_VisibleCount;
+        ++m_AssignedFrames;
+    }
+
+    void RenderSystem::RenderGameObjects(FrameInfo &frameInfo, const Bvh &spatialIndex, const std::vector<PointLight> &lights, bool deferred)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        assert((!deferred || up_DeferredPipeline != nullptr) && "The deferred pipeline was never created");
+        AsyncPipeline &pipeline = deferred ? *up_DeferredPipeline : *up_Pipeline;
+        CullGameObjects(frameInfo, spatialIndex);
+        WriteInstances(frameInfo);
+        // the G-buffer is lit by the light volumes, its instances keep whatever lists they had
+        if (!deferred)
+            AssignLights(lights, static_cast<InstanceData *>(m_InstanceBuffers[frameInfo.frameIndex]->GetMappedMemory()));
+
+        CommandRecorder recorder{frameInfo.commandBuffer};
+        // Model::Bind only rebinds binding 0, the instances stay bound for every run
+        VkBuffer instanceBuffer = m_InstanceBuffers[frameInfo.frameIndex]->GetBuffer();
+        VkDeviceSize instanceOffset = 0;
+        recorder.BindVertexBuffers(1, 1, &instanceBuffer, &instanceOffset);
+
+        // packets with equal state bits and model become one instanced draw, the recorder drops repeated binds
+        m_DrawCallCount = 0;
+        for (uint32_t first = 0; first < m_VisibleCount;)
+        {
+            uint64_t state = DrawKey::GetState(m_DrawQueue[first].key);
+            Model *pModel = m_Candidates[m_DrawQueue[first].value].pModel;
+            uint32_t last = first + 1;
+            while (last < m_VisibleCount && DrawKey::GetState(m_DrawQueue[last].key) == state &&
+                   m_Candidates[m_DrawQueue[last].value].pModel == pModel)
+                ++last;
+
+            pipeline.Bind(recorder);
+            recorder.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &frameInfo.globalDescriptorSet);
+            pModel->Bind(recorder);
+            pModel->Draw(recorder, last - first, first);
+            ++m_DrawCallCount;
+            first = last;
+        }
+
+        m_SkippedBindCount = recorder.GetSkippedCount();
+        m_TotalDrawCalls += m_DrawCallCount;
+        m_TotalSkippedBinds += m_SkippedBindCount;
+    }
+
+    void RenderSystem::Report(std::ostream &os) const
+    {
+        if (m_CulledFrames == 0)
+            return;
+
+        os << "\tFrustum culling: " << std::fixed << std::setprecision(1)
+           << static_cast<double>(m_TotalDrawn) / m_CulledFrames << " of "
+           << static_cast<double>(m_TotalTested) / m_CulledFrames << " objects drawn per frame in "
+           << static_cast<double>(m_TotalDrawCalls) / m_CulledFrames << " instanced draws, "
+           << static_cast<double>(m_TotalSkippedBinds) / m_CulledFrames << " redundant binds skipped" << std::endl;
+        if (m_TotalAssigned > m_TotalClusterShaded)
+            os << "\tLight assignment: "
+               << static_cast<double>(m_TotalAssignedLights) / (m_TotalAssigned - m_TotalClusterShaded) << " lights per listed object, "
+               << static_cast<double>(m_TotalClusterShaded) / m_AssignedFrames << " objects per frame left to the clusters" << std::endl;
+        os.unsetf(std::ios::fixed);
     }
 
 }
\ No newline at end of file
@@ -2,38 +2,108 @@
 #define RENDER_SYSTEM_HEADER
 
 #include "Device.hpp"
+#include "Buffer.hpp"
 #include "Pipeline.hpp"
+#include "Pipeline_Compiler.hpp"
 #include "Game_Object.hpp"
 #include "FrameInfo.hpp"
+#include "Bvh.hpp"
+#include "Draw_Queue.hpp"
+#include "Thread_Pool.hpp"
 
 #include <memory>
+#include <ostream>
+#include <vector>
 
 namespace Divine
 {
-    struct PushConstantData
+    // second vertex binding of basic_vert, advanced once per instance
+    struct InstanceData
     {
+        static constexpr uint32_t s_MaxLights = 8;             // two 16 bit light indices per component of lights
+        static constexpr uint32_t s_UseClusters = UINT32_MAX; // lightCount of objects reached by more lights
+
         glm::mat4 modelMatrix{1.0f};
-        glm::mat4 normalMatrix{1.0f};
+        glm::mat4 normalMatrix{1.0f}; // the shader reads the upper 3x3
+        glm::vec4 color{1.0f};        // multiplies the vertex color, white without a ColorComponent
+        glm::uvec4 lights{0};         // indices into the light buffer of the lights reaching the object
+        uint32_t lightCount = s_UseClusters;
+
+        static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
     };
 
     class RenderSystem
     {
     public:
-        RenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+        RenderSystem(Device &device, ThreadPool &threadPool, PipelineCompiler &compiler, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, uint32_t framesInFlight);
         ~RenderSystem();
         RenderSystem(const RenderSystem &) = delete;
         RenderSystem &operator=(const RenderSystem &) = delete;
 
-        void RenderGameObjects(FrameInfo &frameInfo);
+        // G-buffer variant for the first subpass of the deferred render pass
+        void CreateDeferredPipeline(PipelineCompiler &compiler, VkRenderPass renderPass, uint32_t subpass);
+        inline bool IsDeferredPipelineReady() const { return up_DeferredPipeline != nullptr && up_DeferredPipeline->IsReady(); }
+
+        // candidates come from the spatial index, the ones whose bounding sphere is outside the
+        // camera frustum are skipped. Visible objects sharing a model are drawn with one instanced draw.
+        // Every forward instance carries the lights whose range overlaps its world box, so its fragments
+        // shade only those, objects reached by more than InstanceData::s_MaxLights use the clusters.
+        void RenderGameObjects(FrameInfo &frameInfo, const Bvh &spatialIndex, const std::vector<PointLight> &lights, bool deferred = false);
+
+        // counters of the last frame, tested are the leaves the BVH query returned
+        inline uint32_t GetTestedCount() const { return m_TestedCount; }
+        inline uint32_t GetDrawnCount() const { return m_DrawnCount; }
+        inline uint32_t GetDrawCallCount() const { return m_DrawCallCount; }
+        inline uint32_t GetSkippedBindCount() const { return m_SkippedBindCount; }
+        void Report(std::ostream &os) const;
 
     private:
+        struct DrawCandidate
+        {
+            Model *pModel;
+            const WorldTransformComponent *pWorld;
+            glm::vec3 color;
+        };
+
         void CreatePipelineLayout(VkDescriptorSetLayout globalSetLayout);
-        void CreatePipeline(VkRenderPass renderPass);
+        void CreatePipeline(PipelineCompiler &compiler, VkRenderPass renderPass);
+        void FillPipelineConfigInfo(PipelineConfigInfo &configInfo, VkRenderPass renderPass);
+        void CullGameObjects(FrameInfo &frameInfo, const Bvh &spatialIndex);
+        // sorts the visible candidates by draw key and writes them to the frame's instance buffer in that order
+        void WriteInstances(FrameInfo &frameInfo);
+        // fills the light lists of the written instances on the pool, lights are indexed like the light buffer
+        void AssignLights(const std::vector<PointLight> &lights, InstanceData *pInstances);
 
     private:
         Device &r_Device;
+        ThreadPool &r_ThreadPool;
         VkPipelineLayout m_PipelineLayout;
-        std::unique_ptr<Pipeline> up_Pipeline;
+        std::unique_ptr<AsyncPipeline> up_Pipeline;
+        std::unique_ptr<AsyncPipeline> up_DeferredPipeline;
+        std::vector<std::unique_ptr<Buffer>> m_InstanceBuffers; // one per frame in flight, host visible
+
+        // culling scratch, reused every frame
+        std::vector<DrawCandidate> m_Candidates;
+        std::vector<float> m_Spheres; // four streams of candidate count, see SphereBatch
+        std::vector<uint32_t> m_VisibleIndices;
+        uint32_t m_VisibleCount = 0;
+        DrawQueue m_DrawQueue; // values are candidate indices
+        std::vector<float> m_LightSpheres; // four streams of light count, see SphereBatch
+
+        uint32_t m_TestedCount = 0;
+        uint32_t m_DrawnCount = 0;
+        uint32_t m_DrawCallCount = 0;
+        uint32_t m_SkippedBindCount = 0;
+        uint64_t m_TotalAssignedLights = 0; // entries of the instance light lists
+        uint64_t m_TotalClusterShaded = 0;  // instances whose lights overflowed their list
+        uint64_t m_TotalAssigned = 0;       // instances that got a list
+        uint64_t m_AssignedFrames = 0;
+        uint64_t m_TotalTested = 0;
+        uint64_t m_TotalDrawn = 0;
+        uint64_t m_TotalDrawCalls = 0;
+        uint64_t m_TotalSkippedBinds = 0;
+        uint32_t m_CulledFrames = 0;
     };
 }
 
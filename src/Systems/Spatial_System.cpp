@@ -0,0 +1,96 @@
+#include "Spatial_System.hpp"
+#include "Cpu_Profiler.hpp"
+
+namespace Divine
+{
+    // rebuild once the incrementally inserted leaves make up this share of the tree
+    static constexpr float s_RebuildInsertedRatio = 0.25f;
+    static constexpr uint32_t s_MinRebuildLeaves = 64;
+
+    SpatialSystem::SpatialSystem(ThreadPool &threadPool, float margin)
+        : r_ThreadPool{threadPool}, m_Bvh{margin}
+    {
+    }
+
+    void SpatialSystem::RemoveStaleProxies(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        for (Proxy &proxy : m_Proxies)
+        {
+            if (proxy.proxy == Bvh::s_NullNode)
+                continue;
+            if (registry.IsValid(proxy.entity) && registry.Has<ModelComponent>(proxy.entity) && registry.Has<WorldTransformComponent>(proxy.entity))
+                continue;
+
+            m_Bvh.Remove(proxy.proxy);
+            proxy = Proxy{};
+        }
+    }
+
+    void SpatialSystem::Update(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        auto &models = registry.GetPool<ModelComponent>();
+        auto &worldTransforms = registry.GetPool<WorldTransformComponent>();
+
+        // destroyed entities only show up as a structural change of the pools
+        if (m_ModelVersion != models.GetVersion() || m_WorldVersion != worldTransforms.GetVersion())
+        {
+            RemoveStaleProxies(registry);
+            m_ModelVersion = models.GetVersion();
+            m_WorldVersion = worldTransforms.GetVersion();
+        }
+
+        m_Changed.clear();
+        auto view = registry.GetView<ModelComponent, WorldTransformComponent>();
+        view.Each([&](Entity entity, ModelComponent &, WorldTransformComponent &world)
+                  {
+                      uint32_t index = GetEntityIndex(entity);
+                      if (index >= m_Proxies.size())
+                          m_Proxies.resize(index + 1);
+
+                      bool tracked = m_Proxies[index].proxy != Bvh::s_NullNode && m_Proxies[index].entity == entity;
+                      if (!tracked || world.changed)
+                          m_Changed.push_back(entity); });
+
+        // world boxes of the local bounds, the extent is rotated through the absolute matrix
+        m_ChangedBoxes.resize(m_Changed.size());
+        r_ThreadPool.ParallelFor(m_Changed.size(), 256, [&](size_t begin, size_t end)
+                                 {
+                                     for (size_t i = begin; i < end; ++i)
+                                     {
+                                         const Model::BoundingBox &local = models.Get(m_Changed[i]).sp_Model->GetBoundingBox();
+                                         const glm::mat4 &model = worldTransforms.Get(m_Changed[i]).modelMatrix;
+                                         glm::vec3 center = glm::vec3(model * glm::vec4((local.min + local.max) * 0.5f, 1.0f));
+                                         glm::vec3 extent = glm::mat3(glm::vec3(glm::abs(model[0])), glm::vec3(glm::abs(model[1])), glm::vec3(glm::abs(model[2]))) * ((local.max - local.min) * 0.5f);
+                                         m_ChangedBoxes[i] = {center - extent, center + extent};
+                                     } });
+
+        m_ReinsertedCount = 0;
+        for (size_t i = 0; i < m_Changed.size(); ++i)
+        {
+            Entity entity = m_Changed[i];
+            Proxy &proxy = m_Proxies[GetEntityIndex(entity)];
+            if (proxy.proxy != Bvh::s_NullNode && proxy.entity == entity)
+            {
+                if (m_Bvh.Move(proxy.proxy, m_ChangedBoxes[i]))
+                    ++m_ReinsertedCount;
+                continue;
+            }
+
+            // the slot may still hold a recycled entity that was never seen as removed
+            if (proxy.proxy != Bvh::s_NullNode)
+                m_Bvh.Remove(proxy.proxy);
+            proxy.entity = entity;
+            proxy.proxy = m_Bvh.Insert(m_ChangedBoxes[i], entity);
+            ++m_InsertedSinceRebuild;
+        }
+
+        uint32_t count = m_Bvh.GetProxyCount();
+        if (count >= s_MinRebuildLeaves && m_InsertedSinceRebuild >= s_RebuildInsertedRatio * count)
+        {
+            m_Bvh.Rebuild(&r_ThreadPool);
+            m_InsertedSinceRebuild = 0;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SPATIAL_SYSTEM_HEADER
+#define SPATIAL_SYSTEM_HEADER
+
+#include "Game_Object.hpp"
+#include "Bvh.hpp"
+#include "Thread_Pool.hpp"
+
+#include <vector>
+
+namespace Divine
+{
+    // Mirrors every entity with a model and a world transform into a BVH keyed by the entity, for
+    // culling and gameplay queries. Moved entities get their world box recomputed on the pool and only
+    // reinsert when they leave their fat box. A large batch of new entities, like loading a map,
+    // triggers a SAH rebuild instead of keeping the incrementally inserted tree.
+    class SpatialSystem
+    {
+    public:
+        SpatialSystem(ThreadPool &threadPool, float margin = 0.1f);
+        SpatialSystem(const SpatialSystem &) = delete;
+        SpatialSystem &operator=(const SpatialSystem &) = delete;
+
+        // user data of the leaves is the entity
+        inline const Bvh &GetIndex() const { return m_Bvh; }
+        inline uint32_t GetReinsertedCount() const { return m_ReinsertedCount; }
+
+        // call after TransformSystem::Update, it reads the changed flags
+        void Update(Registry &registry);
+
+    private:
+        struct Proxy
+        {
+            Entity entity = NullEntity;
+            uint32_t proxy = Bvh::s_NullNode;
+        };
+
+        void RemoveStaleProxies(Registry &registry);
+
+    private:
+        ThreadPool &r_ThreadPool;
+        Bvh m_Bvh;
+        std::vector<Proxy> m_Proxies; // indexed by entity index
+        uint64_t m_ModelVersion = 0;
+        uint64_t m_WorldVersion = 0;
+        uint32_t m_InsertedSinceRebuild = 0;
+        uint32_t m_ReinsertedCount = 0;
+
+        std::vector<Entity> m_Changed;
+        std::vector<Aabb> m_ChangedBoxes;
+    };
+}
+
+#endif
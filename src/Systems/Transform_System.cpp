@@ -0,0 +1,179 @@
+#include "Transform_System.hpp"
+#include "Cpu_Profiler.hpp"
+#include "Batch_Transform.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <assert.h>
+
+namespace Divine
+{
+    void TransformSystem::SetParent(Registry &registry, Entity child, Entity parent)
+    {
+        for (Entity ancestor = parent; ancestor != NullEntity;)
+        {
+            assert(ancestor != child && "Parenting would create a cycle");
+            ancestor = registry.Has<HierarchyComponent>(ancestor) ? registry.Get<HierarchyComponent>(ancestor).parent : NullEntity;
+        }
+
+        if (!registry.Has<HierarchyComponent>(child))
+            registry.Add<HierarchyComponent>(child);
+
+        registry.Get<HierarchyComponent>(child).parent = parent;
+        registry.Get<TransformComponent>(child).dirty = true;
+        m_OrderDirty = true;
+    }
+
+    bool TransformSystem::IsOrderValid(Registry &registry)
+    {
+        return !m_OrderDirty &&
+               m_TransformVersion == registry.GetPool<TransformComponent>().GetVersion() &&
+               m_HierarchyVersion == registry.GetPool<HierarchyComponent>().GetVersion();
+    }
+
+    void TransformSystem::RebuildOrder(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        auto &transforms = registry.GetPool<TransformComponent>();
+        std::vector<Entity> entities = transforms.GetEntities();
+
+        for (Entity entity : entities)
+        {
+            if (!registry.Has<WorldTransformComponent>(entity))
+                registry.Add<WorldTransformComponent>(entity);
+            transforms.Get(entity).dirty = true;
+        }
+
+        // parents always sit at a lower depth, sorting by depth is a topological order
+        std::vector<std::pair<uint32_t, Entity>> depths;
+        depths.reserve(entities.size());
+        for (Entity entity : entities)
+        {
+            uint32_t depth = 0;
+            for (Entity ancestor = entity; registry.Has<HierarchyComponent>(ancestor);)
+            {
+                ancestor = registry.Get<HierarchyComponent>(ancestor).parent;
+                if (ancestor == NullEntity || !registry.IsValid(ancestor))
+                    break;
+                ++depth;
+            }
+            depths.emplace_back(depth, entity);
+        }
+        std::stable_sort(depths.begin(), depths.end(), [](const auto &a, const auto &b)
+                         { return a.first < b.first; });
+
+        m_Order.clear();
+        m_RootCount = 0;
+        for (const auto &depth : depths)
+        {
+            m_Order.push_back(depth.second);
+            if (depth.first == 0)
+                ++m_RootCount;
+        }
+        m_OrderDirty = false;
+        m_TransformVersion = transforms.GetVersion();
+        m_HierarchyVersion = registry.GetPool<HierarchyComponent>().GetVersion();
+    }
+
+    void TransformSystem::UpdateRoots(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        auto &transforms = registry.GetPool<TransformComponent>();
+        auto &worldTransforms = registry.GetPool<WorldTransformComponent>();
+
+        m_BatchEntities.clear();
+        for (size_t i = 0; i < m_RootCount; ++i)
+        {
+            Entity entity = m_Order[i];
+            bool dirty = transforms.Get(entity).dirty;
+            worldTransforms.Get(entity).changed = dirty;
+            if (dirty)
+                m_BatchEntities.push_back(entity);
+        }
+
+        size_t count = m_BatchEntities.size();
+        if (count == 0)
+            return;
+
+        m_BatchInput.resize(count * 9);
+        m_BatchModelMatrices.resize(count * 16);
+        m_BatchNormalMatrices.resize(count * 16);
+
+        float *streams[9];
+        for (size_t k = 0; k < 9; ++k)
+            streams[k] = m_BatchInput.data() + k * count;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const TransformComponent &transform = transforms.Get(m_BatchEntities[i]);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                streams[axis][i] = transform.translation[axis];
+                streams[3 + axis][i] = transform.rotation[axis];
+                streams[6 + axis][i] = transform.scale[axis];
+            }
+        }
+
+        TransformBatch batch{streams[0], streams[1], streams[2],
+                             streams[3], streams[4], streams[5],
+                             streams[6], streams[7], streams[8],
+                             count};
+        ComputeTransforms(batch, m_BatchModelMatrices.data(), m_BatchNormalMatrices.data());
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            WorldTransformComponent &world = worldTransforms.Get(m_BatchEntities[i]);
+            world.modelMatrix = glm::make_mat4(m_BatchModelMatrices.data() + i * 16);
+            world.normalMatrix = glm::make_mat4(m_BatchNormalMatrices.data() + i * 16);
+            transforms.Get(m_BatchEntities[i]).dirty = false;
+        }
+        m_UpdatedCount += static_cast<uint32_t>(count);
+    }
+
+    void TransformSystem::Update(Registry &registry)
+    {
+        DIVINE_PROFILE_FUNCTION();
+        if (!IsOrderValid(registry))
+            RebuildOrder(registry);
+
+        auto &transforms = registry.GetPool<TransformComponent>();
+        auto &worldTransforms = registry.GetPool<WorldTransformComponent>();
+        auto &hierarchies = registry.GetPool<HierarchyComponent>();
+
+        m_UpdatedCount = 0;
+        UpdateRoots(registry);
+
+        // children depend on their parents, they stay on the sequential path
+        for (size_t i = m_RootCount; i < m_Order.size(); ++i)
+        {
+            Entity entity = m_Order[i];
+            TransformComponent &transform = transforms.Get(entity);
+            WorldTransformComponent &world = worldTransforms.Get(entity);
+
+            const WorldTransformComponent *pParent = nullptr;
+            if (hierarchies.Contains(entity))
+            {
+                Entity parent = hierarchies.Get(entity).parent;
+                if (parent != NullEntity && worldTransforms.Contains(parent))
+                    pParent = &worldTransforms.Get(parent);
+            }
+
+            world.changed = transform.dirty || (pParent != nullptr && pParent->changed);
+            if (!world.changed)
+                continue;
+
+            world.modelMatrix = transform.GetModelMat();
+            world.normalMatrix = glm::mat4(transform.GetNormalMat());
+            if (pParent != nullptr)
+            {
+                // inverse transpose of a product is the product of the inverse transposes
+                world.modelMatrix = pParent->modelMatrix * world.modelMatrix;
+                world.normalMatrix = glm::mat4(glm::mat3(pParent->normalMatrix) * glm::mat3(world.normalMatrix));
+            }
+
+            transform.dirty = false;
+            ++m_UpdatedCount;
+        }
+    }
+}
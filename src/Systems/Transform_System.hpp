@@ -0,0 +1,47 @@
+#ifndef TRANSFORM_SYSTEM_HEADER
+#define TRANSFORM_SYSTEM_HEADER
+
+#include "Registry.hpp"
+#include "Transform_Component.hpp"
+
+#include <vector>
+
+namespace Divine
+{
+    // Keeps WorldTransformComponent up to date. Entities are visited parents first, an entity is
+    // recomputed only when its own transform is dirty or its parent changed, so a static scene costs
+    // one flag test per entity. The order is rebuilt when the hierarchy or the set of transforms changes.
+    // Dirty roots, which are most of a flat scene, go through the SIMD batch kernel in one call.
+    class TransformSystem
+    {
+    public:
+        TransformSystem() = default;
+        TransformSystem(const TransformSystem &) = delete;
+        TransformSystem &operator=(const TransformSystem &) = delete;
+
+        inline uint32_t GetUpdatedCount() const { return m_UpdatedCount; }
+
+        // NullEntity detaches, the child keeps its local transform which is now relative to the parent
+        void SetParent(Registry &registry, Entity child, Entity parent);
+        void Update(Registry &registry);
+
+    private:
+        bool IsOrderValid(Registry &registry);
+        void RebuildOrder(Registry &registry);
+        void UpdateRoots(Registry &registry);
+
+    private:
+        std::vector<Entity> m_Order;
+        size_t m_RootCount = 0; // depth zero entities lead the order
+        std::vector<Entity> m_BatchEntities;
+        std::vector<float> m_BatchInput; // nine streams of batch size, see TransformBatch
+        std::vector<float> m_BatchModelMatrices;
+        std::vector<float> m_BatchNormalMatrices;
+        bool m_OrderDirty = true;
+        uint64_t m_TransformVersion = 0;
+        uint64_t m_HierarchyVersion = 0;
+        uint32_t m_UpdatedCount = 0;
+    };
+}
+
+#endif
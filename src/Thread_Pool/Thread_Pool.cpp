@@ -0,0 +1,62 @@
+#include "Thread_Pool.hpp"
+#include "Cpu_Profiler.hpp"
+
+namespace Divine
+{
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        m_Workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; ++i)
+            m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Condition.notify_all();
+
+        // queued tasks are drained before the workers exit
+        for (auto &worker : m_Workers)
+            worker.join();
+    }
+
+    void ThreadPool::Enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.push(std::move(task));
+        }
+        m_Condition.notify_one();
+    }
+
+    void ThreadPool::WorkerLoop()
+    {
+        DIVINE_PROFILE_THREAD("Pool Worker");
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]()
+                                 { return m_Stop || !m_Tasks.empty(); });
+
+                if (m_Stop && m_Tasks.empty())
+                    return;
+
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop();
+            }
+
+            task();
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Divine
+{
+    class ThreadPool
+    {
+    public:
+        // threadCount == 0 uses one worker per hardware thread except the main one
+        ThreadPool(uint32_t threadCount = 0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+        template <typename F>
+        auto Submit(F &&task) -> std::future<decltype(task())>
+        {
+            using ResultType = decltype(task());
+
+            auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(task));
+            std::future<ResultType> future = packagedTask->get_future();
+            Enqueue([packagedTask]()
+                    { (*packagedTask)(); });
+
+            return future;
+        }
+
+        // Splits [0, count) into one range per worker plus one for the caller and returns once all
+        // ranges ran, function(begin, end) must be safe to call concurrently. Ranges are at least
+        // minRange long so small counts stay on the caller. The caller claims ranges itself and the
+        // workers only help once they pick up their task, so queued background work never delays the
+        // loop, the caller at most waits for ranges a worker is already running.
+        template <typename F>
+        void ParallelFor(size_t count, size_t minRange, F &&function)
+        {
+            size_t rangeCount = std::min<size_t>(GetThreadCount() + 1, (count + minRange - 1) / std::max<size_t>(minRange, 1));
+            if (rangeCount <= 1)
+            {
+                if (count > 0)
+                    function(size_t(0), count);
+                return;
+            }
+
+            size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+            // helpers that start after the caller claimed every range return without touching function
+            auto sp_Loop = std::make_shared<ParallelLoop>();
+            sp_Loop->rangeCount = (count + rangeSize - 1) / rangeSize;
+            for (size_t i = 1; i < sp_Loop->rangeCount; ++i)
+                Enqueue([sp_Loop, &function, count, rangeSize]()
+                        { RunRanges(*sp_Loop, count, rangeSize, function); });
+
+            RunRanges(*sp_Loop, count, rangeSize, function);
+
+            std::unique_lock<std::mutex> lock(sp_Loop->mutex);
+            sp_Loop->condition.wait(lock, [&]()
+                                    { return sp_Loop->doneCount == sp_Loop->rangeCount; });
+            if (sp_Loop->exception)
+                std::rethrow_exception(sp_Loop->exception);
+        }
+
+    private:
+        struct ParallelLoop
+        {
+            std::atomic<size_t> nextRange{0};
+            size_t rangeCount = 0;
+            size_t doneCount = 0; // guarded by mutex
+            std::exception_ptr exception;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+
+        // claims ranges until none are left, the first exception is handed to the caller of ParallelFor
+        template <typename F>
+        static void RunRanges(ParallelLoop &loop, size_t count, size_t rangeSize, F &function)
+        {
+            size_t doneCount = 0;
+            std::exception_ptr exception;
+            for (size_t range = loop.nextRange++; range < loop.rangeCount; range = loop.nextRange++)
+            {
+                size_t begin = range * rangeSize;
+                try
+                {
+                    function(begin, std::min(begin + rangeSize, count));
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+                ++doneCount;
+            }
+
+            if (doneCount == 0)
+                return;
+
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            if (exception && !loop.exception)
+                loop.exception = exception;
+            loop.doneCount += doneCount;
+            if (loop.doneCount == loop.rangeCount)
+                loop.condition.notify_all();
+        }
+
+        void Enqueue(std::function<void()> task);
+        void WorkerLoop();
+
+    private:
+        std::vector<std::thread> m_Workers;
+        std::queue<std::function<void()>> m_Tasks;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        bool m_Stop = false;
+    };
+}
+
+#endif
@@ -9,12 +9,16 @@
 namespace Divine
 {
 
-#define MAX_LIGHTS 10
+#define MAX_LIGHTS 4096 // capacity of the light storage buffer of a frame
 
+    // std430 element of the light storage buffer
     struct PointLight
     {
         glm::vec4 Position{}; // ignore w
         glm::vec4 Color{};    // w is intensity
+        float Radius = 0.0f;  // of the billboard
+        float Range = 0.0f;   // the light fades out to nothing at this distance
+        float pad[2] = {};
     };
 
     struct GlobalUBO
@@ -23,7 +27,8 @@ namespace Divine
         glm::mat4 View{1.0f};
         glm::mat4 InverseView{1.0f};
         glm::vec4 AmbientLightColor{1.0f, 1.0f, 1.0f, 0.02f}; // w is indtensity
-        PointLight PointLights[MAX_LIGHTS];
+        glm::uvec4 ClusterGrid{1};      // clusters along x, y and depth, w is the light capacity of a cluster
+        glm::vec4 ClusterDepth{0.0f};   // near, far, slice scale and bias, slice = log(depth) * scale + bias
         int numLights;
     };
 
@@ -34,7 +39,7 @@ namespace Divine
         VkCommandBuffer commandBuffer;
         Camera &camera;
         VkDescriptorSet globalDescriptorSet;
-        DivineGameObject::Map &gameObjects;
+        Registry &registry;
     };
 
 }
@@ -2,14 +2,18 @@
 
 namespace Divine
 {
-    Window::Window(int w, int h, const std::string &name)
-        : m_Width(w), m_Height(h), m_Name(name)
+    Window::Window(int w, int h, const std::string &name, bool headless)
+        : m_Width(w), m_Height(h), m_Name(name), m_Headless(headless)
     {
-        InitWindow();
+        if (!m_Headless)
+            InitWindow();
     }
 
     Window::~Window()
     {
+        if (m_Headless)
+            return;
+
         glfwDestroyWindow(m_WindowHandle);
         glfwTerminate();
     }
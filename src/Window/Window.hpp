@@ -11,13 +11,15 @@ namespace Divine
     class Window
     {
     public:
-        Window(int w, int h, const std::string &name);
+        // a headless window has no GLFW window or surface, only an extent to render at
+        Window(int w, int h, const std::string &name, bool headless = false);
         ~Window();
         Window(const Window &) = delete;
         Window &operator=(const Window &) = delete;
 
         inline GLFWwindow *GetWindowHandle() const { return m_WindowHandle; }
-        inline bool ShouldClose() const { return glfwWindowShouldClose(m_WindowHandle); }
+        inline bool IsHeadless() const { return m_Headless; }
+        inline bool ShouldClose() const { return !m_Headless && glfwWindowShouldClose(m_WindowHandle); }
         inline VkExtent2D GetExtent() const { return {static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height)}; }
         inline bool WasFrameBufferResizd() const { return m_FrameBufferResizeFlag; }
         inline void ResetFrameBufferResizeFlag() { m_FrameBufferResizeFlag = false; }
@@ -31,8 +33,9 @@ namespace Divine
     private:
         int m_Width, m_Height;
         std::string m_Name;
-        GLFWwindow *m_WindowHandle;
+        GLFWwindow *m_WindowHandle = nullptr;
         bool m_FrameBufferResizeFlag = false;
+        bool m_Headless;
     };
 }
 
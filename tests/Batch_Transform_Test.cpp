@@ -0,0 +1,123 @@
+#include "Batch_Transform.hpp"
+#include "Transform_Component.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace Divine;
+
+// a batch of count transforms with angles past several turns in both directions
+struct TestBatch
+{
+    std::vector<TransformComponent> transforms;
+    std::vector<float> input; // nine streams of count, see TransformBatch
+
+    explicit TestBatch(size_t count)
+        : transforms(count), input(count * 9)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            float t = static_cast<float>(i);
+            transforms[i].translation = {t * 0.5f - 9.0f, t * 0.25f, -t};
+            transforms[i].rotation = {t * 0.61f - 11.0f, 13.0f - t * 0.83f, t * 1.37f - 25.0f};
+            transforms[i].scale = {0.25f + (i % 17) * 0.1f, 2.0f - (i % 23) * 0.04f, 0.5f + (i % 13) * 0.07f};
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                input[axis * count + i] = transforms[i].translation[axis];
+                input[(3 + axis) * count + i] = transforms[i].rotation[axis];
+                input[(6 + axis) * count + i] = transforms[i].scale[axis];
+            }
+        }
+    }
+
+    TransformBatch Get() const
+    {
+        size_t count = transforms.size();
+        const float *p = input.data();
+        return {p, p + count, p + 2 * count,
+                p + 3 * count, p + 4 * count, p + 5 * count,
+                p + 6 * count, p + 7 * count, p + 8 * count,
+                count};
+    }
+};
+
+static bool Near(float value, float expected)
+{
+    return std::fabs(value - expected) <= 1e-4f * (1.0f + std::fabs(expected));
+}
+
+// compares count matrices element by element and reports the first mismatch
+static bool Compare(const char *name, size_t count, const float *pValues, const float *pExpected)
+{
+    for (size_t i = 0; i < count * 16; ++i)
+    {
+        if (!Near(pValues[i], pExpected[i]))
+        {
+            std::cout << "\t" << name << ": object " << i / 16 << " element " << i % 16 << " is "
+                      << pValues[i] << ", expected " << pExpected[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestCount(size_t count)
+{
+    TestBatch testBatch{count};
+    TransformBatch batch = testBatch.Get();
+
+    std::vector<float> models(count * 16);
+    std::vector<float> normals(count * 16);
+    ComputeTransforms(batch, models.data(), normals.data());
+
+    std::vector<float> scalarModels(count * 16);
+    std::vector<float> scalarNormals(count * 16);
+    ComputeTransformsScalar(batch, scalarModels.data(), scalarNormals.data());
+
+    std::vector<float> expectedModels(count * 16);
+    std::vector<float> expectedNormals(count * 16);
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::mat4 model = testBatch.transforms[i].GetModelMat();
+        glm::mat4 normal = glm::mat4(testBatch.transforms[i].GetNormalMat());
+        for (int element = 0; element < 16; ++element)
+        {
+            expectedModels[i * 16 + element] = glm::value_ptr(model)[element];
+            expectedNormals[i * 16 + element] = glm::value_ptr(normal)[element];
+        }
+    }
+
+    // either output may be left out
+    std::vector<float> modelsOnly(count * 16);
+    ComputeTransforms(batch, modelsOnly.data(), nullptr);
+
+    bool passed = Compare("kernel model vs scalar", count, models.data(), scalarModels.data()) &&
+                  Compare("kernel normal vs scalar", count, normals.data(), scalarNormals.data()) &&
+                  Compare("kernel model vs GetModelMat", count, models.data(), expectedModels.data()) &&
+                  Compare("kernel normal vs GetNormalMat", count, normals.data(), expectedNormals.data()) &&
+                  Compare("scalar model vs GetModelMat", count, scalarModels.data(), expectedModels.data()) &&
+                  Compare("scalar normal vs GetNormalMat", count, scalarNormals.data(), expectedNormals.data()) &&
+                  Compare("kernel model without normals", count, modelsOnly.data(), models.data());
+    if (!passed)
+        std::cout << "\tFailed with " << count << " objects" << std::endl;
+
+    return passed;
+}
+
+int main()
+{
+    std::cout << "\tTransform kernel: " << GetTransformKernelName() << std::endl;
+
+    // every tail length of 4 and 8 lanes, with and without full lanes ahead of it
+    bool passed = true;
+    for (size_t count = 0; count <= 41; ++count)
+        passed = TestCount(count) && passed;
+    passed = TestCount(1000) && passed;
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}
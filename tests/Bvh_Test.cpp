@@ -0,0 +1,250 @@
+#include "Bvh.hpp"
+#include "Thread_Pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace Divine;
+
+// objects of the test scene, removed ones keep their slot so the index stays the user data
+struct TestScene
+{
+    std::vector<Aabb> boxes;
+    std::vector<uint32_t> proxies;
+    std::vector<bool> alive;
+};
+
+static Aabb RandomBox(std::mt19937 &random, float spread)
+{
+    std::uniform_real_distribution<float> position(-spread, spread);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    glm::vec3 min{position(random), position(random), position(random)};
+    return {min, min + glm::vec3{size(random), size(random), size(random)}};
+}
+
+static glm::vec3 RandomDirection(std::mt19937 &random)
+{
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    glm::vec3 direction{normal(random), normal(random), normal(random)};
+    return direction / std::sqrt(glm::dot(direction, direction));
+}
+
+// slab test written independently of the tree, -1 on a miss
+static float RayDistance(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+    float entry = 0.0f;
+    float exit = maxDistance;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+        float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+        entry = std::max(entry, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return entry <= exit ? entry : -1.0f;
+}
+
+static float PointDistance(const Aabb &box, const glm::vec3 &point)
+{
+    float distanceSquared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float outside = std::max(std::max(box.min[axis] - point[axis], point[axis] - box.max[axis]), 0.0f);
+        distanceSquared += outside * outside;
+    }
+    return std::sqrt(distanceSquared);
+}
+
+static bool Near(float value, float expected)
+{
+    return std::fabs(value - expected) <= 1e-4f * (1.0f + std::fabs(expected));
+}
+
+// nearest hit of every object, of the exact boxes or the fat boxes the tree keeps
+static bool TestRayCast(const char *name, const Bvh &bvh, const TestScene &scene, std::mt19937 &random)
+{
+    const float maxDistance = 200.0f;
+    for (int ray = 0; ray < 200; ++ray)
+    {
+        glm::vec3 origin = RandomBox(random, 60.0f).min;
+        glm::vec3 direction = RandomDirection(random);
+
+        bool expectedFound = false;
+        float expected = maxDistance;
+        bool expectedFatFound = false;
+        float expectedFat = maxDistance;
+        for (size_t i = 0; i < scene.boxes.size(); ++i)
+        {
+            if (!scene.alive[i])
+                continue;
+
+            float distance = RayDistance(scene.boxes[i], origin, direction, maxDistance);
+            if (distance >= 0.0f && distance <= expected)
+            {
+                expected = distance;
+                expectedFound = true;
+            }
+            float fatDistance = RayDistance(bvh.GetFatBox(scene.proxies[i]), origin, direction, maxDistance);
+            if (fatDistance >= 0.0f && fatDistance <= expectedFat)
+            {
+                expectedFat = fatDistance;
+                expectedFatFound = true;
+            }
+        }
+
+        BvhHit hit{};
+        bool found = bvh.RayCast(
+            origin, direction, maxDistance, [&](uint32_t userData, float, float closest)
+            { return RayDistance(scene.boxes[userData], origin, direction, closest); },
+            hit);
+        if (found != expectedFound || (found && !Near(hit.distance, expected)))
+        {
+            std::cout << "\t" << name << ": ray " << ray << " hit " << (found ? hit.distance : -1.0f)
+                      << ", expected " << (expectedFound ? expected : -1.0f) << std::endl;
+            return false;
+        }
+
+        BvhHit fatHit{};
+        bool fatFound = bvh.RayCast(origin, direction, maxDistance, fatHit);
+        if (fatFound != expectedFatFound || (fatFound && !Near(fatHit.distance, expectedFat)))
+        {
+            std::cout << "\t" << name << ": ray " << ray << " hit fat box at " << (fatFound ? fatHit.distance : -1.0f)
+                      << ", expected " << (expectedFatFound ? expectedFat : -1.0f) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestFindNearest(const char *name, const Bvh &bvh, const TestScene &scene, std::mt19937 &random)
+{
+    const float maxDistance = 1000.0f;
+    for (int query = 0; query < 200; ++query)
+    {
+        glm::vec3 point = RandomBox(random, 60.0f).min;
+
+        bool expectedFound = false;
+        float expected = maxDistance;
+        for (size_t i = 0; i < scene.boxes.size(); ++i)
+        {
+            if (scene.alive[i] && PointDistance(scene.boxes[i], point) <= expected)
+            {
+                expected = PointDistance(scene.boxes[i], point);
+                expectedFound = true;
+            }
+        }
+
+        BvhHit hit{};
+        bool found = bvh.FindNearest(
+            point, maxDistance, [&](uint32_t userData, float)
+            { return PointDistance(scene.boxes[userData], point); },
+            hit);
+        if (found != expectedFound || (found && !Near(hit.distance, expected)))
+        {
+            std::cout << "\t" << name << ": point " << query << " nearest at " << (found ? hit.distance : -1.0f)
+                      << ", expected " << (expectedFound ? expected : -1.0f) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the tree reports every fat box overlapping the query, filtering by the exact boxes has to give the brute force set
+static bool TestQueryBox(const char *name, const Bvh &bvh, const TestScene &scene, std::mt19937 &random)
+{
+    for (int query = 0; query < 200; ++query)
+    {
+        Aabb box = RandomBox(random, 55.0f);
+        box.max = box.max + glm::vec3{static_cast<float>(query % 10)};
+
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < scene.boxes.size(); ++i)
+        {
+            if (scene.alive[i] && scene.boxes[i].Overlaps(box))
+                expected.push_back(static_cast<uint32_t>(i));
+        }
+
+        std::vector<uint32_t> found;
+        bvh.QueryBox(box, [&](uint32_t userData)
+                     {
+                         if (scene.boxes[userData].Overlaps(box))
+                             found.push_back(userData); });
+        std::sort(found.begin(), found.end());
+        if (found != expected)
+        {
+            std::cout << "\t" << name << ": box " << query << " found " << found.size() << " objects, expected "
+                      << expected.size() << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestQueries(const char *name, const Bvh &bvh, const TestScene &scene, std::mt19937 &random)
+{
+    uint32_t aliveCount = static_cast<uint32_t>(std::count(scene.alive.begin(), scene.alive.end(), true));
+    if (bvh.GetProxyCount() != aliveCount)
+    {
+        std::cout << "\t" << name << ": " << bvh.GetProxyCount() << " proxies, expected " << aliveCount << std::endl;
+        return false;
+    }
+
+    return TestRayCast(name, bvh, scene, random) &&
+           TestFindNearest(name, bvh, scene, random) &&
+           TestQueryBox(name, bvh, scene, random);
+}
+
+int main()
+{
+    std::mt19937 random{42};
+    ThreadPool threadPool{};
+
+    // enough objects for the rebuild to split its subtrees across the pool
+    TestScene scene;
+    Bvh bvh{};
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        scene.boxes.push_back(RandomBox(random, 50.0f));
+        scene.proxies.push_back(bvh.Insert(scene.boxes.back(), i));
+        scene.alive.push_back(true);
+    }
+
+    // small moves stay inside the fat boxes, large ones reinsert
+    std::uniform_real_distribution<float> smallMove(-0.04f, 0.04f);
+    std::uniform_real_distribution<float> largeMove(-20.0f, 20.0f);
+    for (uint32_t i = 0; i < scene.boxes.size(); i += 3)
+    {
+        std::uniform_real_distribution<float> &move = i % 2 == 0 ? smallMove : largeMove;
+        glm::vec3 offset{move(random), move(random), move(random)};
+        scene.boxes[i] = {scene.boxes[i].min + offset, scene.boxes[i].max + offset};
+        bvh.Move(scene.proxies[i], scene.boxes[i]);
+    }
+    for (uint32_t i = 1; i < scene.boxes.size(); i += 7)
+    {
+        bvh.Remove(scene.proxies[i]);
+        scene.alive[i] = false;
+    }
+
+    bool passed = TestQueries("incremental", bvh, scene, random);
+    bvh.Rebuild(&threadPool);
+    passed = TestQueries("parallel rebuild", bvh, scene, random) && passed;
+    bvh.Rebuild();
+    passed = TestQueries("serial rebuild", bvh, scene, random) && passed;
+
+    Bvh empty{};
+    BvhHit hit{};
+    if (empty.RayCast({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, 10.0f, hit) || empty.FindNearest({0.0f, 0.0f, 0.0f}, 10.0f, hit))
+    {
+        std::cout << "\tempty: a query hit" << std::endl;
+        passed = false;
+    }
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}
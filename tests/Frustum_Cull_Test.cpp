@@ -0,0 +1,140 @@
+#include "Frustum_Cull.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace Divine;
+
+struct TestSpheres
+{
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    void Add(float x, float y, float z, float r)
+    {
+        centerX.push_back(x);
+        centerY.push_back(y);
+        centerZ.push_back(z);
+        radius.push_back(r);
+    }
+
+    SphereBatch Get() const
+    {
+        return {centerX.data(), centerY.data(), centerZ.data(), radius.data(), radius.size()};
+    }
+};
+
+// 90 degree perspective frustum looking down -z, spheres inside, outside and straddling it
+static TestSpheres PerspectiveSpheres(size_t count, std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> side(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> depth(-110.0f, 10.0f);
+    std::uniform_real_distribution<float> radius(0.0f, 5.0f);
+
+    TestSpheres spheres;
+    for (size_t i = 0; i < count; ++i)
+        spheres.Add(side(random), side(random), depth(random), radius(random));
+    return spheres;
+}
+
+// integer spheres around the box frustum, many of them touch a plane exactly
+static TestSpheres BoxSpheres(size_t count, std::mt19937 &random)
+{
+    std::uniform_int_distribution<int> position(-14, 14);
+    std::uniform_int_distribution<int> radius(0, 4);
+
+    TestSpheres spheres;
+    for (size_t i = 0; i < count; ++i)
+    {
+        spheres.Add(static_cast<float>(position(random)), static_cast<float>(position(random)),
+                    static_cast<float>(position(random)), static_cast<float>(radius(random)));
+    }
+    return spheres;
+}
+
+// every fifth sphere gets a NaN or infinite component, in every lane position
+static TestSpheres SpecialSpheres(size_t count, std::mt19937 &random)
+{
+    TestSpheres spheres = PerspectiveSpheres(count, random);
+    for (size_t i = 0; i < count; i += 5)
+    {
+        switch ((i / 5) % 4)
+        {
+        case 0:
+            spheres.centerX[i] = NAN;
+            break;
+        case 1:
+            spheres.centerZ[i] = NAN;
+            break;
+        case 2:
+            spheres.radius[i] = NAN;
+            break;
+        default:
+            spheres.radius[i] = INFINITY;
+            break;
+        }
+    }
+    return spheres;
+}
+
+static bool Compare(const char *name, size_t count, const float *pPlanes, const TestSpheres &spheres)
+{
+    SphereBatch batch = spheres.Get();
+    std::vector<uint32_t> visible(count);
+    std::vector<uint32_t> expected(count);
+    uint32_t visibleCount = CullSpheres(pPlanes, batch, visible.data());
+    uint32_t expectedCount = CullSpheresScalar(pPlanes, batch, expected.data());
+
+    if (visibleCount != expectedCount)
+    {
+        std::cout << "\t" << name << ": kept " << visibleCount << " of " << count << " spheres, expected " << expectedCount << std::endl;
+        return false;
+    }
+    for (uint32_t i = 0; i < visibleCount; ++i)
+    {
+        if (visible[i] != expected[i])
+        {
+            std::cout << "\t" << name << ": visible index " << i << " is " << visible[i] << ", expected " << expected[i]
+                      << " (" << count << " spheres)" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    const float h = 1.0f / std::sqrt(2.0f);
+    const float perspectivePlanes[24] = {h, 0.0f, -h, 0.0f,
+                                         -h, 0.0f, -h, 0.0f,
+                                         0.0f, h, -h, 0.0f,
+                                         0.0f, -h, -h, 0.0f,
+                                         0.0f, 0.0f, -1.0f, -0.1f,
+                                         0.0f, 0.0f, 1.0f, 100.0f};
+    const float boxPlanes[24] = {1.0f, 0.0f, 0.0f, 10.0f,
+                                 -1.0f, 0.0f, 0.0f, 10.0f,
+                                 0.0f, 1.0f, 0.0f, 10.0f,
+                                 0.0f, -1.0f, 0.0f, 10.0f,
+                                 0.0f, 0.0f, 1.0f, 10.0f,
+                                 0.0f, 0.0f, -1.0f, 10.0f};
+
+    // every tail length of 4 and 8 lanes, with and without full lanes ahead of it
+    std::mt19937 random{7};
+    bool passed = true;
+    for (size_t count = 0; count <= 41; ++count)
+    {
+        passed = Compare("perspective", count, perspectivePlanes, PerspectiveSpheres(count, random)) && passed;
+        passed = Compare("box", count, boxPlanes, BoxSpheres(count, random)) && passed;
+        passed = Compare("special values", count, perspectivePlanes, SpecialSpheres(count, random)) && passed;
+    }
+    passed = Compare("perspective", 10000, perspectivePlanes, PerspectiveSpheres(10000, random)) && passed;
+    passed = Compare("box", 10000, boxPlanes, BoxSpheres(10000, random)) && passed;
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include "Radix_Sort.hpp"
+#include "Transparency_Queue.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace Divine;
+
+// items with their push index as value, so the expected order also checks stability
+static std::vector<SortItem> MakeItems(size_t count, const std::function<uint64_t()> &nextKey)
+{
+    std::vector<SortItem> items(count);
+    for (size_t i = 0; i < count; ++i)
+        items[i] = {nextKey(), static_cast<uint32_t>(i)};
+    return items;
+}
+
+static bool TestRadixSort(const char *name, std::vector<SortItem> items, std::vector<SortItem> &scratch)
+{
+    std::vector<SortItem> expected = items;
+    std::stable_sort(expected.begin(), expected.end(), [](const SortItem &a, const SortItem &b)
+                     { return a.key < b.key; });
+
+    RadixSort(items, scratch);
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (items[i].key != expected[i].key || items[i].value != expected[i].value)
+        {
+            std::cout << "\t" << name << ": item " << i << " of " << items.size() << " is " << items[i].key << " / " << items[i].value
+                      << ", expected " << expected[i].key << " / " << expected[i].value << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestTransparencyQueue(const char *name, TransparencyQueue &queue, const std::vector<float> &distances)
+{
+    queue.Clear();
+    std::vector<uint32_t> expected(distances.size());
+    for (size_t i = 0; i < distances.size(); ++i)
+    {
+        queue.Push(distances[i], static_cast<uint32_t>(i));
+        expected[i] = static_cast<uint32_t>(i);
+    }
+    // -0 and +0 compare equal here, so they tie like any other equal distances
+    std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b)
+                     { return distances[a] > distances[b]; });
+
+    queue.Sort();
+    if (queue.GetSize() != distances.size())
+    {
+        std::cout << "\t" << name << ": " << queue.GetSize() << " items, expected " << distances.size() << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < queue.GetSize(); ++i)
+    {
+        if (queue[i] != expected[i])
+        {
+            std::cout << "\t" << name << ": item " << i << " of " << distances.size() << " is " << queue[i] << " at " << distances[queue[i]]
+                      << ", expected " << expected[i] << " at " << distances[expected[i]] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestCount(size_t count, std::mt19937_64 &random, std::vector<SortItem> &scratch, TransparencyQueue &queue)
+{
+    std::uniform_int_distribution<uint64_t> anyKey;
+    std::uniform_int_distribution<uint64_t> fewKeys(0, 7);
+    std::uniform_int_distribution<uint64_t> byte(0, 255);
+
+    auto randomKey = [&]()
+    { return anyKey(random); };
+    auto tiedKey = [&]()
+    { return fewKeys(random) * 0x0101010101010101ull; };
+    auto upperBitsKey = [&]()
+    { return (anyKey(random) >> 40) << 40; };
+    auto straddlingKey = [&]()
+    { return 0xABCD000000001234ull | (byte(random) << 28); };
+    auto equalKey = []()
+    { return 42ull; };
+
+    // only some bytes vary in the last three, the others are skipped
+    bool passed = TestRadixSort("random keys", MakeItems(count, randomKey), scratch);
+    passed = TestRadixSort("many ties", MakeItems(count, tiedKey), scratch) && passed;
+    passed = TestRadixSort("upper bits", MakeItems(count, upperBitsKey), scratch) && passed;
+    passed = TestRadixSort("straddling bytes", MakeItems(count, straddlingKey), scratch) && passed;
+    passed = TestRadixSort("equal keys", MakeItems(count, equalKey), scratch) && passed;
+
+    std::uniform_real_distribution<float> distance(-100.0f, 100.0f);
+    std::uniform_int_distribution<int> special(0, 9);
+    const float specials[] = {0.0f, -0.0f, 1.0f, -1.0f, INFINITY, -INFINITY, 1e-40f, -1e-40f, 3.5f, 3.5f};
+
+    std::vector<float> distances(count);
+    for (float &value : distances)
+        value = distance(random);
+    passed = TestTransparencyQueue("random distances", queue, distances) && passed;
+
+    // signed zeros, infinities, denormals and repeated values mixed in with regular ones
+    for (float &value : distances)
+    {
+        int pick = special(random);
+        value = pick < 5 ? specials[special(random)] : std::round(distance(random) * 0.1f);
+    }
+    passed = TestTransparencyQueue("special distances", queue, distances) && passed;
+
+    if (!passed)
+        std::cout << "\tFailed with " << count << " items" << std::endl;
+
+    return passed;
+}
+
+int main()
+{
+    std::mt19937_64 random{5};
+    std::vector<SortItem> scratch;
+    TransparencyQueue queue{};
+
+    // both sides of the insertion sort threshold, the buffers are reused like from frame to frame
+    bool passed = true;
+    for (size_t count = 0; count <= 130; ++count)
+        passed = TestCount(count, random, scratch, queue) && passed;
+    passed = TestCount(100000, random, scratch, queue) && passed;
+    passed = TestCount(100, random, scratch, queue) && passed;
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}
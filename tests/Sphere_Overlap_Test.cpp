@@ -0,0 +1,150 @@
+#include "Sphere_Overlap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace Divine;
+
+struct TestSpheres
+{
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    void Add(float x, float y, float z, float r)
+    {
+        centerX.push_back(x);
+        centerY.push_back(y);
+        centerZ.push_back(z);
+        radius.push_back(r);
+    }
+
+    SphereBatch Get() const
+    {
+        return {centerX.data(), centerY.data(), centerZ.data(), radius.data(), radius.size()};
+    }
+};
+
+static TestSpheres RandomSpheres(size_t count, std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> radius(0.0f, 6.0f);
+
+    TestSpheres spheres;
+    for (size_t i = 0; i < count; ++i)
+        spheres.Add(position(random), position(random), position(random), radius(random));
+    return spheres;
+}
+
+// integer spheres around an integer box, many of them touch a face, edge or corner exactly
+static TestSpheres IntegerSpheres(size_t count, std::mt19937 &random)
+{
+    std::uniform_int_distribution<int> position(-8, 8);
+    std::uniform_int_distribution<int> radius(0, 5);
+
+    TestSpheres spheres;
+    for (size_t i = 0; i < count; ++i)
+    {
+        spheres.Add(static_cast<float>(position(random)), static_cast<float>(position(random)),
+                    static_cast<float>(position(random)), static_cast<float>(radius(random)));
+    }
+    return spheres;
+}
+
+// every fifth sphere gets a NaN or infinite component, in every lane position
+static TestSpheres SpecialSpheres(size_t count, std::mt19937 &random)
+{
+    TestSpheres spheres = RandomSpheres(count, random);
+    for (size_t i = 0; i < count; i += 5)
+    {
+        switch ((i / 5) % 4)
+        {
+        case 0:
+            spheres.centerY[i] = NAN;
+            break;
+        case 1:
+            spheres.centerX[i] = INFINITY;
+            break;
+        case 2:
+            spheres.radius[i] = NAN;
+            break;
+        default:
+            spheres.radius[i] = INFINITY;
+            break;
+        }
+    }
+    return spheres;
+}
+
+// below maxCount both paths return the same indices. Past it the count only has to report the overflow,
+// the kernel finishes its group of lanes before it stops, and the stored indices still have to agree
+static bool Compare(const char *name, const TestSpheres &spheres, const float *pBoxMin, const float *pBoxMax, uint32_t maxCount)
+{
+    SphereBatch batch = spheres.Get();
+    std::vector<uint32_t> indices(maxCount);
+    std::vector<uint32_t> expected(maxCount);
+    uint32_t count = OverlapSpheresBox(batch, pBoxMin, pBoxMax, indices.data(), maxCount);
+    uint32_t expectedCount = OverlapSpheresBoxScalar(batch, pBoxMin, pBoxMax, expected.data(), maxCount);
+
+    bool overflowed = expectedCount > maxCount;
+    if (overflowed ? count <= maxCount : count != expectedCount)
+    {
+        std::cout << "\t" << name << ": found " << count << " of " << batch.count << " spheres, expected " << expectedCount
+                  << " (at most " << maxCount << " stored)" << std::endl;
+        return false;
+    }
+    for (uint32_t i = 0; i < std::min(count, maxCount); ++i)
+    {
+        if (indices[i] != expected[i])
+        {
+            std::cout << "\t" << name << ": index " << i << " is " << indices[i] << ", expected " << expected[i]
+                      << " (" << batch.count << " spheres)" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool TestCount(size_t count, std::mt19937 &random)
+{
+    const float boxMin[3] = {-10.0f, -4.0f, 0.5f};
+    const float boxMax[3] = {6.0f, 12.0f, 9.0f};
+    const float integerBoxMin[3] = {-2.0f, -3.0f, -1.0f};
+    const float integerBoxMax[3] = {2.0f, 1.0f, 3.0f};
+    const float pointMin[3] = {1.0f, 1.0f, 1.0f};
+
+    TestSpheres randomSpheres = RandomSpheres(count, random);
+    TestSpheres integerSpheres = IntegerSpheres(count, random);
+    uint32_t roomForAll = static_cast<uint32_t>(count);
+
+    bool passed = Compare("random", randomSpheres, boxMin, boxMax, roomForAll) &&
+                  Compare("integer", integerSpheres, integerBoxMin, integerBoxMax, roomForAll) &&
+                  Compare("point box", integerSpheres, pointMin, pointMin, roomForAll) &&
+                  Compare("special values", SpecialSpheres(count, random), boxMin, boxMax, roomForAll);
+    // overflow on the first sphere, inside the first group of lanes and later on
+    for (uint32_t maxCount : {0u, 1u, 3u, 5u, 9u, 17u})
+    {
+        passed = Compare("random overflow", randomSpheres, boxMin, boxMax, maxCount) && passed;
+        passed = Compare("integer overflow", integerSpheres, integerBoxMin, integerBoxMax, maxCount) && passed;
+    }
+
+    return passed;
+}
+
+int main()
+{
+    // every tail length of 4 and 8 lanes, with and without full lanes ahead of it
+    std::mt19937 random{11};
+    bool passed = true;
+    for (size_t count = 0; count <= 41; ++count)
+        passed = TestCount(count, random) && passed;
+    passed = TestCount(10000, random) && passed;
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}
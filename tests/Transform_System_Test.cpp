@@ -0,0 +1,147 @@
+#include "Transform_System.hpp"
+
+#include <cmath>
+#include <iostream>
+
+using namespace Divine;
+
+static bool Near(float value, float expected)
+{
+    return std::fabs(value - expected) <= 1e-4f * (1.0f + std::fabs(expected));
+}
+
+static Entity CreateTransform(Registry &registry, const glm::vec3 &translation, const glm::vec3 &rotation, const glm::vec3 &scale)
+{
+    Entity entity = registry.Create();
+    TransformComponent &transform = registry.Add<TransformComponent>(entity);
+    transform.translation = translation;
+    transform.rotation = rotation;
+    transform.scale = scale;
+    return entity;
+}
+
+// parent * local along the chain of valid ancestors, built without the system
+static void ComputeExpected(Registry &registry, Entity entity, glm::mat4 &modelMatrix, glm::mat3 &normalMatrix)
+{
+    modelMatrix = registry.Get<TransformComponent>(entity).GetModelMat();
+    normalMatrix = registry.Get<TransformComponent>(entity).GetNormalMat();
+    for (Entity ancestor = entity; registry.Has<HierarchyComponent>(ancestor);)
+    {
+        ancestor = registry.Get<HierarchyComponent>(ancestor).parent;
+        if (!registry.IsValid(ancestor))
+            break;
+        modelMatrix = registry.Get<TransformComponent>(ancestor).GetModelMat() * modelMatrix;
+        normalMatrix = registry.Get<TransformComponent>(ancestor).GetNormalMat() * normalMatrix;
+    }
+}
+
+// compares the cached world matrices of every entity and reports the first mismatch
+static bool TestWorld(const char *name, Registry &registry)
+{
+    for (Entity entity : registry.GetPool<TransformComponent>().GetEntities())
+    {
+        glm::mat4 expectedModel;
+        glm::mat3 expectedNormal;
+        ComputeExpected(registry, entity, expectedModel, expectedNormal);
+
+        const WorldTransformComponent &world = registry.Get<WorldTransformComponent>(entity);
+        for (int column = 0; column < 4; ++column)
+        {
+            for (int row = 0; row < 4; ++row)
+            {
+                float expectedNormalValue = column < 3 && row < 3 ? expectedNormal[column][row] : (column == row ? 1.0f : 0.0f);
+                if (!Near(world.modelMatrix[column][row], expectedModel[column][row]) ||
+                    !Near(world.normalMatrix[column][row], expectedNormalValue))
+                {
+                    std::cout << "\t" << name << ": entity " << GetEntityIndex(entity) << " element " << column * 4 + row
+                              << " is " << world.modelMatrix[column][row] << " / " << world.normalMatrix[column][row]
+                              << ", expected " << expectedModel[column][row] << " / " << expectedNormalValue << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool TestUpdatedCount(const char *name, const TransformSystem &transformSystem, uint32_t expected)
+{
+    if (transformSystem.GetUpdatedCount() != expected)
+    {
+        std::cout << "\t" << name << ": updated " << transformSystem.GetUpdatedCount() << " entities, expected " << expected << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    Registry registry;
+    TransformSystem transformSystem;
+
+    // a chain of four below the first root, a second root and flat entities
+    Entity root = CreateTransform(registry, {1.0f, 2.0f, 3.0f}, {0.3f, -1.2f, 0.7f}, {2.0f, 1.0f, 0.5f});
+    Entity otherRoot = CreateTransform(registry, {-4.0f, 0.5f, 1.0f}, {1.1f, 0.4f, -0.2f}, {1.0f, 3.0f, 1.0f});
+    Entity chain[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        float t = static_cast<float>(i + 1);
+        chain[i] = CreateTransform(registry, {t, -t * 0.5f, 0.25f}, {0.2f * t, 0.9f - t, 0.1f}, {1.0f + 0.1f * t, 0.8f, 1.2f});
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        float t = static_cast<float>(i);
+        CreateTransform(registry, {t, t, -t}, {t * 0.3f, 0.0f, t}, {1.0f, 1.0f, 1.0f});
+    }
+    // children are created before their parents are set, the order must not depend on creation
+    transformSystem.SetParent(registry, chain[3], chain[2]);
+    transformSystem.SetParent(registry, chain[2], chain[1]);
+    transformSystem.SetParent(registry, chain[1], chain[0]);
+    transformSystem.SetParent(registry, chain[0], root);
+
+    transformSystem.Update(registry);
+    bool passed = TestWorld("chain", registry);
+
+    // nothing changed, nothing is recomputed
+    transformSystem.Update(registry);
+    passed = TestUpdatedCount("static", transformSystem, 0) && passed;
+
+    // moving the root recomputes it and every descendant
+    registry.Get<TransformComponent>(root).SetTranslation({-2.0f, 5.0f, 0.0f});
+    transformSystem.Update(registry);
+    passed = TestWorld("moved root", registry) && passed;
+    passed = TestUpdatedCount("moved root", transformSystem, 5) && passed;
+
+    // the middle of the chain moves with its subtree
+    transformSystem.SetParent(registry, chain[2], otherRoot);
+    transformSystem.Update(registry);
+    passed = TestWorld("reparent", registry) && passed;
+
+    registry.Get<TransformComponent>(otherRoot).SetRotation({0.0f, 2.0f, 0.0f});
+    transformSystem.Update(registry);
+    passed = TestWorld("moved new parent", registry) && passed;
+    passed = TestUpdatedCount("moved new parent", transformSystem, 3) && passed;
+
+    transformSystem.SetParent(registry, chain[1], NullEntity);
+    transformSystem.Update(registry);
+    passed = TestWorld("detach", registry) && passed;
+
+    // the children of a destroyed parent fall back to their local transforms, even once its slot is reused
+    registry.Destroy(otherRoot);
+    transformSystem.Update(registry);
+    passed = TestWorld("destroyed parent", registry) && passed;
+
+    CreateTransform(registry, {9.0f, 9.0f, 9.0f}, {0.5f, 0.5f, 0.5f}, {3.0f, 3.0f, 3.0f});
+    transformSystem.Update(registry);
+    passed = TestWorld("reused slot", registry) && passed;
+
+    registry.Get<TransformComponent>(chain[2]).SetScale({0.5f, 0.5f, 2.0f});
+    transformSystem.Update(registry);
+    passed = TestWorld("moved orphan", registry) && passed;
+    passed = TestUpdatedCount("moved orphan", transformSystem, 2) && passed;
+
+    std::cout << (passed ? "\tPassed" : "\tFailed") << std::endl;
+    return passed ? 0 : 1;
+}